@@ -0,0 +1,38 @@
+# Tries to find zstd headers and libraries
+#
+# Usage of this module as follows:
+#
+#     find_package(Zstd)
+#
+# Variables used by this module, they can change the default behaviour and need
+# to be set before calling find_package:
+#
+#  Zstd_ROOT_DIR  Set this variable to the root installation of
+#                 zstd if the module has problems finding
+#                 the proper installation path.
+#
+# Variables defined by this module:
+#
+#  ZSTD_FOUND              System has zstd libs/headers
+#  ZSTD_LIBRARIES          The zstd libraries
+#  ZSTD_INCLUDE_DIR        The location of zstd headers
+
+find_path(ZSTD_INCLUDE_DIR
+  NAMES zstd.h zdict.h
+  HINTS ${Zstd_ROOT_DIR}/include)
+
+find_library(ZSTD_LIBRARIES
+  NAMES zstd
+  HINTS ${Zstd_ROOT_DIR}/lib)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+  Zstd
+  DEFAULT_MSG
+  ZSTD_LIBRARIES
+  ZSTD_INCLUDE_DIR)
+
+mark_as_advanced(
+  Zstd_ROOT_DIR
+  ZSTD_LIBRARIES
+  ZSTD_INCLUDE_DIR)
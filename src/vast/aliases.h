@@ -27,6 +27,13 @@ static constexpr event_id max_event_id =
 /// Uniquely identifies a VAST type.
 using type_id = uint64_t;
 
+/// Identifies the type of an event, i.e., its name, within one process.
+/// The ::event_type_registry maps between names and event types.
+using event_type = uint32_t;
+
+/// The event type of unnamed events.
+static constexpr event_type unnamed_event_type = 0;
+
 namespace util {
 
 template <typename T>
@@ -1,5 +1,7 @@
 #include "vast/archive.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cppa/cppa.hpp>
 #include "vast/aliases.h"
 #include "vast/bitstream.h"
@@ -11,8 +13,50 @@
 
 namespace vast {
 
+namespace {
+
+// The interval in which the archive actor checkpoints the catalog.
+auto const checkpoint_interval = std::chrono::seconds(30);
+
+// The interval in which the archive actor looks for segments to compact
+// while there are none.
+auto const compaction_interval = std::chrono::seconds(60);
+
+segment::header make_header(segment const& s)
+{
+  segment::header h;
+  h.id = s.id();
+  h.compression = s.compression();
+  h.first = s.first();
+  h.last = s.last();
+  h.base = s.base();
+  h.n = s.events();
+  h.max_bytes = s.max_bytes();
+  h.occupied_bytes = s.bytes();
+  return h;
+}
+
+// Reads the record of the last compaction.
+trial<nothing> read_intent(path const& filename, uuid& id,
+                           std::vector<uuid>& ids)
+{
+  try
+  {
+    return io::unarchive(filename, id, ids);
+  }
+  catch (std::exception const& e)
+  {
+    return error{"invalid compaction record " + to_string(filename) + ": " +
+                 e.what()};
+  }
+}
+
+} // namespace <anonymous>
+
 archive::archive(path directory)
-  : directory_{std::move(directory)}
+  : directory_{std::move(directory)},
+    catalog_{directory_ / "catalog"},
+    intent_{directory_ / "compaction"}
 {
 }
 
@@ -23,30 +67,385 @@ path const& archive::dir() const
 
 void archive::load()
 {
+  if (! exists(directory_))
+    return;
+
+  auto t = catalog_.load();
+  if (t)
+  {
+    for (auto& h : catalog_.segments())
+      if (! ranges_.insert(h.base, h.base + h.n, h.id))
+      {
+        t = error{"inconsistency in ID space for [" + std::to_string(h.base) +
+                  ", " + std::to_string(h.base + h.n) + ")"};
+        ranges_ = {};
+        break;
+      }
+
+    if (t)
+    {
+      VAST_LOG_VERBOSE("read " << catalog_.segments().size() <<
+                       " segments from catalog");
+      recover();
+      return;
+    }
+  }
+
+  VAST_LOG_WARN("rebuilds catalog from segments in " << directory_ << ": " <<
+                t.failure().msg());
+
+  t = scan();
+  if (! t)
+    VAST_LOG_ERROR("failed to rebuild catalog: " << t.failure().msg());
+}
+
+trial<nothing> archive::scan()
+{
+  // The merged segment of an interrupted compaction is complete only if
+  // mapping it succeeds. Otherwise the crash happened before the merged
+  // segment reached its file and the original segments remain valid.
+  uuid merged;
+  std::vector<uuid> replaced;
+  std::vector<path> obsolete;
+  if (exists(intent_))
+  {
+    auto t = read_intent(intent_, merged, replaced);
+    if (t)
+    {
+      segment s;
+      t = s.map(directory_ / path{to_string(merged)});
+      if (! t || s.id() != merged)
+        replaced = {merged};
+    }
+    else
+    {
+      VAST_LOG_WARN(t.failure().msg());
+    }
+  }
+
+  // The catalog, the compaction record, and their temporary checkpoints
+  // share the same names. Temporary segment files remain only if a crash
+  // interrupted their write.
+  auto const catalog = catalog_.filename().basename(true);
+  auto const intent = intent_.basename(true);
+  std::vector<segment::header> headers;
   traverse(
       directory_,
       [&](path const& p) -> bool
       {
+        auto const name = p.basename(true);
+        if (name == catalog || name == intent || p.extension() == ".tmp")
+          return true;
+
+        for (auto& id : replaced)
+          if (p.basename() == path{to_string(id)})
+          {
+            obsolete.push_back(p);
+            return true;
+          }
+
+        // A segment of an older format makes the header throw. We keep its
+        // file but leave it out of the catalog.
         segment::header header;
-        io::unarchive(p, header);
+        try
+        {
+          io::unarchive(p, header);
+        }
+        catch (std::exception const& e)
+        {
+          VAST_LOG_ERROR("skips unreadable segment " << p.basename() << ": " <<
+                         e.what());
+          return true;
+        }
+
         VAST_LOG_DEBUG("found segment " << p.basename() <<
                        " for ID range [" << header.base << ", " <<
                        header.base + header.n << ")");
 
-        if (! ranges_.insert(header.base, header.base + header.n, header.id))
-        {
-          VAST_LOG_ERROR("inconsistency in ID space for [" <<
-                         header.base << ", " << header.base + header.n << ")");
-          return false;
-        }
-
+        headers.push_back(header);
         return true;
       });
+
+  // Without a compaction record, a segment whose ID range lies within the
+  // range of another one can only be a leftover of a compaction, because
+  // only a merged segment covers the events of several segments. Sorting
+  // by base, and by size for equal bases, puts a merged segment before the
+  // segments it covers.
+  std::sort(headers.begin(), headers.end(),
+            [](segment::header const& x, segment::header const& y)
+            {
+              return x.base < y.base || (x.base == y.base && x.n > y.n);
+            });
+
+  util::range_map<event_id, uuid> ranges;
+  std::vector<segment::header> kept;
+  for (auto& h : headers)
+  {
+    if (! kept.empty())
+    {
+      auto& last = kept.back();
+      auto const end = last.base + last.n;
+      if (h.base < end && h.base + h.n <= end)
+      {
+        VAST_LOG_WARN("segment " << h.id << " lies within merged segment " <<
+                      last.id);
+        obsolete.push_back(directory_ / path{to_string(h.id)});
+        continue;
+      }
+    }
+
+    if (! ranges.insert(h.base, h.base + h.n, h.id))
+    {
+      // A checkpoint would drop the segments we could not place in the
+      // catalog.
+      consistent_ = false;
+      return error{"inconsistency in ID space for [" +
+                   std::to_string(h.base) + ", " +
+                   std::to_string(h.base + h.n) + ")"};
+    }
+
+    kept.push_back(h);
+  }
+
+  consistent_ = true;
+  ranges_ = std::move(ranges);
+  catalog_.reset(std::move(kept));
+  auto t = catalog_.checkpoint();
+  if (! t)
+    return t;
+
+  // We delete the leftovers only once the catalog no longer refers to them.
+  for (auto& p : obsolete)
+  {
+    VAST_LOG_VERBOSE("deletes obsolete segment " << p.basename());
+    if (! rm(p))
+      VAST_LOG_WARN("failed to delete obsolete segment " << p);
+  }
+
+  if (exists(intent_) && ! rm(intent_))
+    VAST_LOG_WARN("failed to delete " << intent_);
+
+  return nil;
 }
 
 bool archive::store(segment const& s)
 {
-  return ranges_.insert(s.base(), s.base() + s.events(), s.id());
+  if (! ranges_.insert(s.base(), s.base() + s.events(), s.id()))
+    return false;
+
+  pending_.emplace(s.id(), make_header(s));
+  return true;
+}
+
+trial<nothing> archive::commit(uuid const& id)
+{
+  auto i = pending_.find(id);
+  if (i == pending_.end())
+    return error{"no pending segment " + to_string(id)};
+
+  auto t = catalog_.add(i->second);
+  if (! t)
+    return error{"failed to add segment " + to_string(id) + " to catalog: " +
+                 t.failure().msg()};
+
+  pending_.erase(i);
+  return nil;
+}
+
+void archive::discard(uuid const& id)
+{
+  auto i = pending_.find(id);
+  if (i == pending_.end())
+    return;
+
+  ranges_.erase(i->second.base);
+  pending_.erase(i);
+}
+
+trial<nothing> archive::sync()
+{
+  return catalog_.sync();
+}
+
+trial<nothing> archive::checkpoint()
+{
+  if (! consistent_)
+    return error{"refuses to checkpoint catalog after failed scan"};
+
+  if (! catalog_.dirty())
+    return nil;
+
+  return catalog_.checkpoint();
+}
+
+std::vector<std::vector<uuid>>
+archive::compaction_candidates(uint64_t target) const
+{
+  // Replacing segments requires a checkpoint.
+  if (! consistent_)
+    return {};
+
+  auto headers = catalog_.segments();
+  std::sort(headers.begin(), headers.end(),
+            [](segment::header const& x, segment::header const& y)
+            {
+              return x.base < y.base;
+            });
+
+  std::vector<std::vector<uuid>> runs;
+  std::vector<uuid> run;
+  uint64_t bytes = 0;
+  event_id next = 0;
+  for (auto& h : headers)
+  {
+    auto small = h.occupied_bytes < target;
+    if (! (small && h.base == next && bytes + h.occupied_bytes <= target))
+    {
+      if (run.size() > 1)
+        runs.push_back(std::move(run));
+
+      run.clear();
+      bytes = 0;
+    }
+
+    if (small)
+    {
+      run.push_back(h.id);
+      bytes += h.occupied_bytes;
+    }
+
+    next = h.base + h.n;
+  }
+
+  if (run.size() > 1)
+    runs.push_back(std::move(run));
+
+  return runs;
+}
+
+trial<nothing> archive::prepare(uuid const& id,
+                                std::vector<uuid> const& ids)
+{
+  std::vector<uint8_t> buf;
+  io::archive(buf, id, ids);
+
+  // Opening an existing file does not truncate it.
+  auto tmp = intent_;
+  tmp += ".tmp";
+  if (exists(tmp) && ! rm(tmp))
+    return error{"failed to remove stale " + to_string(tmp)};
+
+  file f{tmp};
+  auto t = f.open(file::write_only);
+  if (! t)
+    return error{"failed to open " + to_string(tmp) + ": " +
+                 t.failure().msg()};
+
+  if (! f.write(buf.data(), buf.size()) || ! f.sync())
+    return error{"failed to write " + to_string(tmp)};
+
+  f.close();
+  t = mv(tmp, intent_);
+  if (! t)
+    return t;
+
+  return sync_directory(directory_);
+}
+
+trial<nothing> archive::replace(std::vector<uuid> const& ids,
+                                segment const& s)
+{
+  if (! consistent_)
+    return error{"refuses to replace segments after failed scan"};
+
+  auto const& previous = catalog_.segments();
+  std::vector<segment::header> replaced;
+  std::vector<segment::header> headers;
+  for (auto& h : previous)
+    if (std::find(ids.begin(), ids.end(), h.id) == ids.end())
+      headers.push_back(h);
+    else
+      replaced.push_back(h);
+
+  if (replaced.size() != ids.size())
+    return error{"cannot replace segments missing in the catalog"};
+
+  uint64_t n = 0;
+  for (auto& h : replaced)
+  {
+    if (h.base < s.base() || h.base + h.n > s.base() + s.events())
+      return error{"segment " + to_string(h.id) + " lies outside of " +
+                   to_string(s.id())};
+
+    n += h.n;
+  }
+
+  if (n != s.events())
+    return error{"segments do not cover all events of " + to_string(s.id())};
+
+  auto backup = previous;
+  headers.push_back(make_header(s));
+  catalog_.reset(std::move(headers));
+  auto t = catalog_.checkpoint();
+  if (! t)
+  {
+    catalog_.reset(std::move(backup));
+    return t;
+  }
+
+  for (auto& h : replaced)
+    ranges_.erase(h.base);
+
+  auto inserted = ranges_.insert(s.base(), s.base() + s.events(), s.id());
+  assert(inserted);
+
+  return nil;
+}
+
+void archive::recover()
+{
+  if (! exists(intent_))
+    return;
+
+  uuid merged;
+  std::vector<uuid> replaced;
+  auto t = read_intent(intent_, merged, replaced);
+  if (! t)
+  {
+    // Without the record we cannot tell leftovers apart, but they do not
+    // harm: the catalog refers to either the merged or the original segments.
+    VAST_LOG_WARN(t.failure().msg());
+    return;
+  }
+
+  // Once the catalog refers to the merged segment, the original ones are
+  // obsolete. Otherwise the merged segment never made it into the archive.
+  auto const& headers = catalog_.segments();
+  auto done = std::any_of(headers.begin(), headers.end(),
+                          [&](segment::header const& h)
+                          {
+                            return h.id == merged;
+                          });
+  if (! done)
+    replaced = {merged};
+
+  for (auto& id : replaced)
+  {
+    auto p = directory_ / path{to_string(id)};
+    if (exists(p))
+    {
+      VAST_LOG_VERBOSE("deletes obsolete segment " << id);
+      if (! rm(p))
+        VAST_LOG_WARN("failed to delete obsolete segment " << p);
+    }
+
+    p += ".tmp";
+    if (exists(p) && ! rm(p))
+      VAST_LOG_WARN("failed to delete " << p);
+  }
+
+  if (! rm(intent_))
+    VAST_LOG_WARN("failed to delete " << intent_);
 }
 
 std::tuple<uuid const*, event_id, event_id> archive::lookup(event_id eid) const
@@ -56,17 +455,98 @@ std::tuple<uuid const*, event_id, event_id> archive::lookup(event_id eid) const
 
 using namespace cppa;
 
-archive_actor::archive_actor(path directory, size_t max_segments)
-  : archive_{std::move(directory)}
+archive_actor::archive_actor(path directory, size_t cache_size,
+                             util::cache_policy policy, size_t io_threads,
+                             durability d, std::chrono::milliseconds window,
+                             uint64_t compaction_target,
+                             size_t max_events_per_chunk)
+  : archive_{std::move(directory)},
+    compaction_target_{compaction_target},
+    max_events_per_chunk_{max_events_per_chunk}
 {
-  segment_manager_ =
-    spawn<segment_manager_actor, linked>(max_segments, archive_.dir());
+  segment_manager_ = spawn<segment_manager_actor, linked>(
+      cache_size, archive_.dir(), policy, io_threads, d, window);
 }
 
 void archive_actor::act()
 {
   archive_.load();
+  delayed_send(self, checkpoint_interval, atom("checkpoint"));
+  if (compaction_target_ > 0)
+    delayed_send(self, compaction_interval, atom("compact"));
+
   become(
+      on(atom("checkpoint")) >> [=]
+      {
+        auto t = archive_.checkpoint();
+        if (! t)
+          VAST_LOG_ACTOR_ERROR("failed to checkpoint catalog: " <<
+                               t.failure().msg());
+
+        delayed_send(self, checkpoint_interval, atom("checkpoint"));
+      },
+      on(atom("compact")) >> [=]
+      {
+        // We compact one run at a time, so that compaction competes with
+        // queries only for a single segment manager I/O thread.
+        auto runs = archive_.compaction_candidates(compaction_target_);
+        if (runs.empty())
+        {
+          delayed_send(self, compaction_interval, atom("compact"));
+          return;
+        }
+
+        VAST_LOG_ACTOR_DEBUG("compacts " << runs.front().size() <<
+                             " segments, " << runs.size() - 1 <<
+                             " more runs pending");
+
+        auto id = uuid::random();
+        auto t = archive_.prepare(id, runs.front());
+        if (! t)
+        {
+          VAST_LOG_ACTOR_ERROR("failed to record compaction: " <<
+                               t.failure().msg());
+          delayed_send(self, compaction_interval, atom("compact"));
+          return;
+        }
+
+        send(segment_manager_, atom("compact"), id, runs.front(),
+             uint64_t{max_events_per_chunk_});
+      },
+      on(atom("compact"), atom("ack"), arg_match)
+        >> [=](std::vector<uuid> const& ids, segment const& s)
+      {
+        auto t = archive_.replace(ids, s);
+        if (t)
+        {
+          VAST_LOG_ACTOR_VERBOSE("merged " << ids.size() <<
+                                 " segments into " << s.id());
+
+          // The segment manager still serves the lookups we forwarded before
+          // it deletes the original segments.
+          send(segment_manager_, atom("retire"), ids);
+          send(self, atom("compact"));
+        }
+        else
+        {
+          VAST_LOG_ACTOR_ERROR("failed to replace merged segments: " <<
+                               t.failure().msg());
+
+          send(segment_manager_, atom("retire"), std::vector<uuid>{s.id()});
+          delayed_send(self, compaction_interval, atom("compact"));
+        }
+      },
+      on(atom("compact"), atom("nack"), arg_match)
+        >> [=](std::vector<uuid> const&)
+      {
+        delayed_send(self, compaction_interval, atom("compact"));
+      },
+      on(atom("statistics")) >> [=]
+      {
+        // The segment manager replies with the hits, misses, evictions,
+        // rejections, resident bytes, and number of segments of its cache.
+        forward_to(segment_manager_);
+      },
       on_arg_match >> [=](uuid const& id)
       {
         send(segment_manager_, id, last_sender());
@@ -101,10 +581,59 @@ void archive_actor::act()
         {
           VAST_LOG_ACTOR_ERROR("failed to register segment " << s.id());
           quit(exit::error);
+          return;
         }
 
-        forward_to(segment_manager_);
-        return make_any_tuple(atom("segment"), atom("ack"), s.id());
+        // We acknowledge the segment only once both the segment and its
+        // catalog record are on disk.
+        senders_[s.id()] = last_sender();
+        segment_manager_ << last_dequeued();
+      },
+      on(atom("segment"), atom("ack"), arg_match) >> [=](uuid const& id)
+      {
+        auto t = archive_.commit(id);
+        if (! t)
+        {
+          VAST_LOG_ACTOR_ERROR(t.failure().msg());
+          quit(exit::error);
+          return;
+        }
+
+        // The segment manager acknowledges the segments of a group commit
+        // back to back, so that a single sync usually covers their records.
+        unsynced_.push_back(id);
+        if (unsynced_.size() == 1)
+          send(self, atom("sync"));
+      },
+      on(atom("sync")) >> [=]
+      {
+        auto t = archive_.sync();
+        if (! t)
+        {
+          VAST_LOG_ACTOR_ERROR("failed to sync catalog: " << t.failure().msg());
+          quit(exit::error);
+          return;
+        }
+
+        for (auto& id : unsynced_)
+        {
+          auto i = senders_.find(id);
+          if (i != senders_.end() && i->second)
+            send(i->second, atom("segment"), atom("ack"), id);
+
+          senders_.erase(id);
+        }
+
+        unsynced_.clear();
+      },
+      on(atom("segment"), atom("nack"), arg_match) >> [=](uuid const& id)
+      {
+        archive_.discard(id);
+        auto i = senders_.find(id);
+        if (i != senders_.end() && i->second)
+          send(i->second, atom("segment"), atom("nack"), id);
+
+        senders_.erase(id);
       });
 }
 
@@ -2,16 +2,18 @@
 #define VAST_ARCHIVE_H
 
 #include <unordered_map>
+#include <vector>
 #include "vast/actor.h"
 #include "vast/aliases.h"
+#include "vast/catalog.h"
 #include "vast/file_system.h"
+#include "vast/segment_manager.h"
 #include "vast/uuid.h"
+#include "vast/util/cache_policy.h"
 #include "vast/util/range_map.h"
 
 namespace vast {
 
-class segment;
-
 /// The event archive. It stores events in the form of segments.
 class archive
 {
@@ -23,16 +25,83 @@ public:
   /// Retrieves the directory of the archive.
   path const& dir() const;
 
-  /// Initializes the archive. This involves parsing the meta data of existing
-  /// segments from disk an reconstructing the internal data structures to map
-  /// event IDs to segments.
+  /// Initializes the archive. This involves reading the meta data of existing
+  /// segments from the catalog and reconstructing the internal data
+  /// structures to map event IDs to segments. If the catalog is missing or
+  /// damaged, the archive falls back to ::scan. Afterwards, the archive
+  /// deletes the leftovers of a compaction which a crash interrupted.
   void load();
 
-  /// Stores segment meta data.
+  /// Rebuilds the catalog by reading the header of every segment file in the
+  /// archive directory. Files whose header cannot be read, e.g., segments of
+  /// an older format, remain in place but do not enter the catalog. If the
+  /// ID range of a segment lies within the range
+  /// of another one, the archive keeps the merged segment and deletes the
+  /// segment it covers. If the scan fails, the archive no longer
+  /// checkpoints the catalog, because the checkpoint would drop the
+  /// segments the scan could not place.
+  /// @returns `nothing` on success.
+  trial<nothing> scan();
+
+  /// Registers the ID range of a new segment. The segment enters the catalog
+  /// only once it is on disk, see ::commit.
   /// @param s The segment to record meta data from.
   /// @returns `true` on success.
   bool store(segment const& s);
 
+  /// Appends the record of a stored segment to the catalog after the segment
+  /// manager has written the segment. The record becomes durable with the
+  /// next ::sync.
+  /// @param id The ID of the written segment.
+  /// @returns `nothing` on success.
+  trial<nothing> commit(uuid const& id);
+
+  /// Forgets a stored segment which the segment manager failed to write.
+  /// @param id The ID of the segment.
+  void discard(uuid const& id);
+
+  /// Flushes the catalog records appended since the last sync to disk.
+  /// @returns `nothing` on success.
+  trial<nothing> sync();
+
+  /// Flushes the catalog to disk if it has changed since the last checkpoint.
+  /// @returns `nothing` on success.
+  trial<nothing> checkpoint();
+
+  /// Finds runs of segments which are smaller than a target size and have
+  /// adjacent event ID ranges, such that merging a run yields a segment of at
+  /// most the target size.
+  ///
+  /// @param target The maximum size in bytes of a merged segment.
+  ///
+  /// @returns The runs with at least two segments, each ordered by event ID.
+  std::vector<std::vector<uuid>> compaction_candidates(uint64_t target) const;
+
+  /// Records on disk that a merged segment is about to replace other
+  /// segments. The record must be durable before the merged segment gets
+  /// written, so that ::load can tell which segments a crash during the
+  /// compaction left behind. The record remains until the next compaction
+  /// replaces it or ::load resolves it.
+  ///
+  /// @param id The ID of the merged segment.
+  ///
+  /// @param ids The IDs of the segments to merge.
+  ///
+  /// @returns `nothing` on success.
+  trial<nothing> prepare(uuid const& id, std::vector<uuid> const& ids);
+
+  /// Replaces segments with the segment they have been merged into. The
+  /// archive first checkpoints the catalog with the merged segment in place
+  /// of the original ones and only then updates the ID ranges, so that it
+  /// keeps referring to the original segments if the checkpoint fails.
+  ///
+  /// @param ids The IDs of the merged segments.
+  ///
+  /// @param s The merged segment.
+  ///
+  /// @returns `nothing` on success.
+  trial<nothing> replace(std::vector<uuid> const& ids, segment const& s);
+
   /// Retrieves the segment UUID for a given event id.
   ///
   /// @param eid The event ID.
@@ -45,19 +114,62 @@ public:
   std::tuple<uuid const*, event_id, event_id> lookup(event_id eid) const;
 
 private:
+  // Deletes either the merged segment of the last compaction, if the catalog
+  // does not refer to it, or the segments it replaced.
+  void recover();
+
   path directory_;
+  catalog catalog_;
+  path intent_;
+  bool consistent_ = true;
   util::range_map<event_id, uuid> ranges_;
+  std::unordered_map<uuid, segment::header> pending_;
 };
 
 struct archive_actor : actor<archive_actor>
 {
-  archive_actor(path directory, size_t max_segments);
+  /// Spawns the archive actor.
+  ///
+  /// @param directory The root directory of the archive.
+  ///
+  /// @param cache_size The number of bytes of segments to keep in memory.
+  ///
+  /// @param policy The replacement policy of the segment cache.
+  ///
+  /// @param io_threads The number of threads performing segment I/O.
+  ///
+  /// @param d The durability of new segments.
+  ///
+  /// @param window The time span of a group commit.
+  ///
+  /// @param compaction_target The size in bytes up to which the archive
+  /// merges adjacent small segments in the background. 0 disables
+  /// compaction.
+  ///
+  /// @param max_events_per_chunk The maximum number of events per chunk of a
+  /// merged segment.
+  archive_actor(
+      path directory, size_t cache_size,
+      util::cache_policy policy = util::cache_policy::lru,
+      size_t io_threads = 4,
+      durability d = durability::segment,
+      std::chrono::milliseconds window = std::chrono::milliseconds{50},
+      uint64_t compaction_target = 0,
+      size_t max_events_per_chunk = 0);
 
   void act();
   char const* description() const;
 
   archive archive_;
   cppa::actor_ptr segment_manager_;
+  uint64_t compaction_target_;
+  size_t max_events_per_chunk_;
+
+  // The senders of the segments not yet acknowledged.
+  std::unordered_map<uuid, cppa::actor_ptr> senders_;
+
+  // The written segments whose catalog records await the next sync.
+  std::vector<uuid> unsynced_;
 };
 
 } // namespace vast
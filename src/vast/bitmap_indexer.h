@@ -23,9 +23,15 @@ class bitmap_indexer : public actor<bitmap_indexer<Derived, BitmapIndex>>
 {
 public:
   /// Spawns a bitmap indexer.
+  ///
   /// @param path The absolute file path on the file system.
-  bitmap_indexer(path path)
+  ///
+  /// @param predecessor An indexer of the same file which is about to
+  /// terminate. If valid, the new indexer reads the file only after the
+  /// predecessor has written it for the last time.
+  bitmap_indexer(path path, cppa::actor_ptr predecessor = {})
     : path_{std::move(path)},
+      predecessor_{std::move(predecessor)},
       stats_{std::chrono::seconds{1}}
   {
     bmi_.append(1, false); // Event ID 0 is not a valid event.
@@ -39,6 +45,37 @@ public:
     this->trap_exit(true);
     this->chaining(false);
 
+    // Wait until the predecessor has terminated. Messages arriving in the
+    // meantime remain in the mailbox.
+    if (predecessor_)
+    {
+      this->monitor(predecessor_);
+      this->become(
+          on(atom("EXIT"), arg_match) >> [=](uint32_t reason)
+          {
+            this->quit(reason);
+          },
+          on(atom("DOWN"), arg_match) >> [=](uint32_t /* reason */)
+          {
+            run();
+          });
+    }
+    else
+    {
+      run();
+    }
+  }
+
+  char const* description()
+  {
+    return "bitmap-indexer";
+  }
+
+private:
+  void run()
+  {
+    using namespace cppa;
+
     if (exists(path_))
     {
       io::unarchive(path_, last_flush_, bmi_);
@@ -115,15 +152,10 @@ public:
         });
   }
 
-  char const* description()
-  {
-    return "bitmap-indexer";
-  }
-
-private:
   uint64_t last_flush_ = 0;
   BitmapIndex bmi_;
   path const path_;
+  cppa::actor_ptr predecessor_;
   util::rate_accumulator<uint64_t> stats_;
 };
 
@@ -172,19 +204,20 @@ struct event_data_indexer
 {
   using super = bitmap_indexer<event_data_indexer<BitmapIndex>, BitmapIndex>;
 
-  event_data_indexer(path p, string e, offset o)
-    : super{std::move(p)},
-      event_{std::move(e)},
+  event_data_indexer(path p, event_type e, offset o,
+                     cppa::actor_ptr predecessor = {})
+    : super{std::move(p), std::move(predecessor)},
+      event_{e},
       offset_{std::move(o)}
   {
   }
 
   value const* extract(event const& e) const
   {
-    return e.name() == event_ ? e.at(offset_) : nullptr;
+    return e.type() == event_ ? e.at(offset_) : nullptr;
   }
 
-  string event_;
+  event_type event_;
   offset offset_;
 };
 
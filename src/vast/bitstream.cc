@@ -503,9 +503,10 @@ void ewah_bitstream::iterator::increment()
   if (pos_ == npos)
     return;
 
-  // First check whether we're processing the last (dirty) block.
-  // special one.
-  if (idx_ == ewah_->bits_.blocks() - 1)
+  // First check whether we're processing the last (dirty) block. The index
+  // already points to it while we process the clean 1-blocks of the last
+  // marker.
+  if (idx_ == ewah_->bits_.blocks() - 1 && num_clean_ == 0)
   {
     auto i = bitvector::bit_index(pos_);
     auto next = bitvector::next_bit(ewah_->bits_.block(idx_), i);
@@ -520,6 +521,16 @@ void ewah_bitstream::iterator::increment()
       --num_clean_;
     if (num_clean_ > 0)
       return;
+
+    // We're at the beginning of the first dirty block after the clean
+    // 1-blocks, whose first bit we have not yet looked at.
+    if (num_dirty_ > 0)
+    {
+      auto next = bitvector::lowest_bit(ewah_->bits_.block(idx_));
+      assert(next != npos);
+      pos_ += next;
+      return;
+    }
   }
 
   // Time for the dirty stuff.
@@ -0,0 +1,216 @@
+#include "vast/catalog.h"
+
+#include <cstring>
+#include "vast/serialization.h"
+#include "vast/io/serialization.h"
+#include "vast/util/crc.h"
+
+namespace vast {
+
+namespace {
+
+// The size of the record prefix: the size of the serialized header and its
+// checksum.
+size_t const prefix_size = 2 * sizeof(uint32_t);
+
+// Appends the record for a header to a buffer.
+void append_record(segment::header const& h, std::vector<uint8_t>& buf)
+{
+  std::vector<uint8_t> payload;
+  io::archive(payload, h);
+
+  util::crc32 crc;
+  crc.process_bytes(payload.data(), payload.size());
+  uint32_t const size = payload.size();
+  uint32_t const checksum = crc.checksum();
+
+  auto const n = buf.size();
+  buf.resize(n + prefix_size + payload.size());
+  std::memcpy(buf.data() + n, &size, sizeof(size));
+  std::memcpy(buf.data() + n + sizeof(size), &checksum, sizeof(checksum));
+  std::memcpy(buf.data() + n + prefix_size, payload.data(), payload.size());
+}
+
+trial<nothing> make_parent(path const& p)
+{
+  if (exists(p.parent()))
+    return nil;
+
+  return mkdir(p.parent());
+}
+
+} // namespace <anonymous>
+
+catalog::catalog(path filename)
+  : filename_{std::move(filename)},
+    log_{filename_}
+{
+}
+
+path const& catalog::filename() const
+{
+  return filename_;
+}
+
+trial<nothing> catalog::load()
+{
+  if (! exists(filename_))
+    return error{"no catalog at " + to_string(filename_)};
+
+  auto m = mapped_file::map(filename_);
+  if (! m)
+    return m.failure();
+
+  std::vector<segment::header> headers;
+  auto const begin = (*m)->data();
+  auto const end = begin + (*m)->size();
+  auto first = begin;
+  while (first != end)
+  {
+    auto const offset = std::to_string(first - begin);
+    if (static_cast<size_t>(end - first) < prefix_size)
+      return error{"truncated catalog record at byte " + offset};
+
+    uint32_t size;
+    uint32_t checksum;
+    std::memcpy(&size, first, sizeof(size));
+    std::memcpy(&checksum, first + sizeof(size), sizeof(checksum));
+    first += prefix_size;
+    if (static_cast<size_t>(end - first) < size)
+      return error{"truncated catalog record at byte " + offset};
+
+    util::crc32 crc;
+    crc.process_bytes(first, size);
+    if (crc.checksum() != checksum)
+      return error{"corrupt catalog record at byte " + offset};
+
+    segment::header h;
+    try
+    {
+      io::array_input_stream source{first, size};
+      binary_deserializer d{source};
+      d >> h;
+    }
+    catch (std::exception const& e)
+    {
+      return error{"invalid catalog record at byte " + offset + ": " +
+                   e.what()};
+    }
+
+    headers.push_back(std::move(h));
+    first += size;
+  }
+
+  segments_ = std::move(headers);
+  dirty_ = false;
+
+  return nil;
+}
+
+void catalog::reset(std::vector<segment::header> headers)
+{
+  segments_ = std::move(headers);
+  dirty_ = true;
+}
+
+trial<nothing> catalog::add(segment::header const& h)
+{
+  if (! log_.is_open())
+  {
+    auto t = make_parent(filename_);
+    if (! t)
+      return t;
+
+    // A new file only survives a crash along with its directory entry.
+    created_ = ! exists(filename_);
+    t = log_.open(file::write_only, true);
+    if (! t)
+      return error{"failed to open " + to_string(filename_) + ": " +
+                   t.failure().msg()};
+  }
+
+  std::vector<uint8_t> buf;
+  append_record(h, buf);
+  if (! log_.write(buf.data(), buf.size()))
+    return error{"failed to append to " + to_string(filename_)};
+
+  segments_.push_back(h);
+  dirty_ = true;
+
+  return nil;
+}
+
+trial<nothing> catalog::sync()
+{
+  if (! log_.is_open())
+    return nil;
+
+  if (! log_.sync(false))
+    return error{"failed to sync " + to_string(filename_)};
+
+  if (created_)
+  {
+    auto t = sync_directory(filename_.parent());
+    if (! t)
+      return t;
+
+    created_ = false;
+  }
+
+  return nil;
+}
+
+trial<nothing> catalog::checkpoint()
+{
+  auto t = make_parent(filename_);
+  if (! t)
+    return t;
+
+  std::vector<uint8_t> buf;
+  for (auto& h : segments_)
+    append_record(h, buf);
+
+  // Opening an existing file does not truncate it.
+  auto tmp = filename_;
+  tmp += ".tmp";
+  if (exists(tmp) && ! rm(tmp))
+    return error{"failed to remove stale " + to_string(tmp)};
+
+  file f{tmp};
+  t = f.open(file::write_only);
+  if (! t)
+    return error{"failed to open " + to_string(tmp) + ": " +
+                 t.failure().msg()};
+
+  if (! f.write(buf.data(), buf.size()) || ! f.sync())
+    return error{"failed to write " + to_string(tmp)};
+
+  f.close();
+
+  // The append handle would otherwise refer to the replaced file.
+  log_.close();
+  created_ = false;
+  t = mv(tmp, filename_);
+  if (! t)
+    return t;
+
+  t = sync_directory(filename_.parent());
+  if (! t)
+    return t;
+
+  dirty_ = false;
+
+  return nil;
+}
+
+bool catalog::dirty() const
+{
+  return dirty_;
+}
+
+std::vector<segment::header> const& catalog::segments() const
+{
+  return segments_;
+}
+
+} // namespace vast
@@ -0,0 +1,72 @@
+#ifndef VAST_CATALOG_H
+#define VAST_CATALOG_H
+
+#include <vector>
+#include "vast/file_system.h"
+#include "vast/segment.h"
+#include "vast/util/trial.h"
+
+namespace vast {
+
+/// An append-only file with the header of every segment in the archive, so
+/// that starting up requires a single sequential read instead of opening each
+/// segment file. Each record consists of its size, a CRC32 checksum, and the
+/// serialized ::segment::header, which includes the ID range, the time range,
+/// the size, and the compression method of the segment.
+///
+/// Adding a segment appends its record right away, and a sync flushes the
+/// appended records to disk. A checkpoint rewrites the catalog into a
+/// temporary file, flushes it to disk, and then atomically replaces the old
+/// catalog.
+class catalog
+{
+public:
+  /// Constructs a catalog.
+  /// @param filename The path of the catalog file.
+  explicit catalog(path filename);
+
+  /// Retrieves the path of the catalog file.
+  /// @returns The path of the catalog.
+  path const& filename() const;
+
+  /// Reads all records from the catalog file.
+  /// @returns `nothing` if the file exists and all records are intact.
+  trial<nothing> load();
+
+  /// Replaces the records in memory, e.g., after scanning the segments. The
+  /// catalog file changes only with the next checkpoint.
+  /// @param headers The new records.
+  void reset(std::vector<segment::header> headers);
+
+  /// Adds a record and appends it to the catalog file.
+  /// @param h The header of the segment to add.
+  /// @returns `nothing` on success.
+  trial<nothing> add(segment::header const& h);
+
+  /// Flushes the records appended since the last sync to disk.
+  /// @returns `nothing` on success.
+  trial<nothing> sync();
+
+  /// Rewrites the catalog file with all records and flushes it to disk.
+  /// @returns `nothing` on success.
+  trial<nothing> checkpoint();
+
+  /// Checks whether the catalog file has changed since the last checkpoint.
+  /// @returns `true` if a checkpoint would write new records to disk.
+  bool dirty() const;
+
+  /// Retrieves all records.
+  /// @returns The headers of all segments in the catalog.
+  std::vector<segment::header> const& segments() const;
+
+private:
+  path filename_;
+  file log_;
+  bool created_ = false;
+  bool dirty_ = false;
+  std::vector<segment::header> segments_;
+};
+
+} // namespace vast
+
+#endif
@@ -1,35 +1,121 @@
 #include "vast/chunk.h"
 
+#include <algorithm>
+
 namespace vast {
 
-chunk::writer::writer(chunk& chk)
+chunk::writer::writer(chunk& chk, uint32_t mark_interval,
+                      uint32_t dictionary, bool defer)
   : chunk_(chk),
-    base_stream_(chunk_.buffer_),
-    compressed_stream_(make_compressed_output_stream(chunk_.compression_,
-                                                     base_stream_)),
-    serializer_(*compressed_stream_)
+    mark_interval_(mark_interval),
+    next_mark_(chunk_.elements_ + mark_interval),
+    dictionary_(dictionary),
+    defer_(defer),
+    base_stream_(chunk_.buffer_)
 {
+  // We can only compress uncompressed data for the chunk as a whole.
+  assert(! uncompressed() || chunk_.buffer_.empty());
+  assert(! chunk_.deferred_);
+  assert(! chunk_.mapping_);
+  open();
 }
 
 chunk::writer::~writer()
 {
-  chunk_.bytes_ = serializer_.bytes();
+  chunk_.bytes_ = bytes();
+  close();
+  if (uncompressed())
+  {
+    chunk_.deferred_ = true;
+    chunk_.dictionary_ = dictionary_;
+    if (! defer_)
+      chunk_.compress();
+  }
 }
 
 size_t chunk::writer::bytes() const
 {
-  return serializer_.bytes();
+  return bytes_ + serializer_->bytes();
+}
+
+bool chunk::writer::uncompressed() const
+{
+  return defer_ || chunk_.compression_ == io::automatic;
 }
 
+void chunk::writer::open()
+{
+  if (uncompressed())
+  {
+    serializer_ = make_unique<binary_serializer>(base_stream_);
+  }
+  else
+  {
+    compressed_stream_.reset(
+        make_compressed_output_stream(chunk_.compression_, base_stream_,
+                                      dictionary_));
+    serializer_ = make_unique<binary_serializer>(*compressed_stream_);
+  }
+}
+
+void chunk::writer::close()
+{
+  // Destroying the serializer hands its unused buffer back to the compressed
+  // stream, and destroying the compressed stream flushes the last block and
+  // trims the chunk buffer to the compressed bytes.
+  serializer_.reset();
+  compressed_stream_.reset();
+}
+
+void chunk::writer::mark()
+{
+  bytes_ += serializer_->bytes();
+  close();
+
+  chunk_.marks_.emplace_back(chunk_.elements_, chunk_.buffer_.size());
+  while (next_mark_ <= chunk_.elements_)
+    next_mark_ += mark_interval_;
+
+  open();
+}
 
 chunk::reader::reader(chunk const& chk)
   : chunk_(chk),
-    available_(chunk_.elements_),
-    base_stream_(chunk_.buffer_.data(), chunk_.buffer_.size()),
-    compressed_stream_(make_compressed_input_stream(chunk_.compression_,
-                                                    base_stream_)),
-    deserializer_(*compressed_stream_)
+    available_(chunk_.elements_)
+{
+  assert(! chunk_.deferred_);
+  open(0);
+}
+
+uint32_t chunk::reader::seek(uint32_t i)
 {
+  assert(i <= chunk_.elements_);
+  auto current = chunk_.elements_ - available_;
+
+  // Find the last entry at or before i, where the beginning of the chunk
+  // acts as implicit first entry.
+  uint32_t element = 0;
+  size_t offset = 0;
+  auto m = std::upper_bound(
+      chunk_.marks_.begin(), chunk_.marks_.end(), i,
+      [](uint32_t x, std::pair<uint32_t, uint32_t> const& p)
+      {
+        return x < p.first;
+      });
+
+  if (m != chunk_.marks_.begin())
+  {
+    --m;
+    element = m->first;
+    offset = m->second;
+  }
+
+  if (current >= element && current <= i)
+    return current;
+
+  open(offset);
+  available_ = chunk_.elements_ - element;
+  return element;
 }
 
 uint32_t chunk::reader::available() const
@@ -39,15 +125,129 @@ uint32_t chunk::reader::available() const
 
 size_t chunk::reader::bytes() const
 {
-  return deserializer_.bytes();
+  return deserializer_->bytes();
 }
 
+void chunk::reader::open(size_t offset)
+{
+  assert(offset <= chunk_.size());
+
+  // The deserializer references the compressed stream, which in turn
+  // references the base stream, so we tear them down in this order.
+  deserializer_.reset();
+  compressed_stream_.reset();
+  base_stream_ = make_unique<io::array_input_stream>(
+      chunk_.data() + offset, chunk_.size() - offset);
+  compressed_stream_.reset(
+      make_compressed_input_stream(chunk_.compression_, *base_stream_));
+  deserializer_ = make_unique<binary_deserializer>(*compressed_stream_);
+}
 
-chunk::chunk(io::compression method)
-  : compression_(method)
+
+chunk::chunk(io::compression method, io::compression_policy policy)
+  : compression_(method),
+    policy_(policy)
 {
 }
 
+io::compression chunk::compression() const
+{
+  return compression_;
+}
+
+void chunk::compress()
+{
+  for (auto& c : columns_)
+    c.compress();
+
+  if (! deferred_)
+    return;
+
+  deferred_ = false;
+  std::vector<uint8_t> raw;
+  raw.swap(buffer_);
+  if (compression_ == io::automatic)
+    compression_ = io::select(raw.data(), raw.size(), policy_);
+
+  // The offset table holds uncompressed positions until now. We compress the
+  // data between two entries separately, so that each entry points to the
+  // beginning of a compression block.
+  io::container_output_stream<std::vector<uint8_t>> base{buffer_};
+  size_t begin = 0;
+  for (size_t i = 0; i <= marks_.size(); ++i)
+  {
+    auto end = i < marks_.size() ? marks_[i].second : raw.size();
+    {
+      std::unique_ptr<io::compressed_output_stream> out{
+        make_compressed_output_stream(compression_, base, dictionary_)};
+      io::coded_output_stream sink{*out};
+      sink.write_raw(raw.data() + begin, end - begin);
+    }
+
+    if (i < marks_.size())
+      marks_[i].second = buffer_.size();
+
+    begin = end;
+  }
+}
+
+chunk chunk::decompress() const
+{
+  assert(! deferred_);
+  chunk c{io::null, policy_};
+  c.elements_ = elements_;
+  c.bytes_ = bytes_;
+  c.marks_ = marks_;
+  for (auto& col : columns_)
+    c.columns_.push_back(col.decompress());
+
+  if (compression_ == io::null)
+  {
+    c.buffer_.assign(data(), data() + size());
+    return c;
+  }
+
+  // Each entry of the offset table begins a new compression block, so we
+  // decompress the blocks one by one and adjust the offsets.
+  io::container_output_stream<std::vector<uint8_t>> base{c.buffer_};
+  size_t begin = 0;
+  for (size_t i = 0; i <= marks_.size(); ++i)
+  {
+    auto end = i < marks_.size() ? marks_[i].second : size();
+    {
+      io::array_input_stream source{data() + begin, end - begin};
+      std::unique_ptr<io::compressed_input_stream> in{
+        make_compressed_input_stream(compression_, source)};
+      std::unique_ptr<io::compressed_output_stream> out{
+        make_compressed_output_stream(io::null, base)};
+      io::coded_output_stream sink{*out};
+      void const* data;
+      size_t size;
+      while (in->next(&data, &size))
+        sink.write_raw(data, size);
+    }
+
+    if (i < marks_.size())
+      c.marks_[i].second = c.buffer_.size();
+
+    begin = end;
+  }
+
+  return c;
+}
+
+bool chunk::deferred() const
+{
+  if (deferred_)
+    return true;
+
+  for (auto& c : columns_)
+    if (c.deferred())
+      return true;
+
+  return false;
+}
+
 bool chunk::empty() const
 {
   return elements_ == 0;
@@ -60,20 +260,107 @@ uint32_t chunk::elements() const
 
 size_t chunk::compressed_bytes() const
 {
-  return buffer_.size();
+  size_t n = size();
+  for (auto& c : columns_)
+    n += c.compressed_bytes();
+
+  return n;
 }
 
 size_t chunk::uncompressed_bytes() const
 {
-  return bytes_;
+  size_t n = bytes_;
+  for (auto& c : columns_)
+    n += c.uncompressed_bytes();
+
+  return n;
+}
+
+chunk& chunk::add_column()
+{
+  columns_.emplace_back(compression_, policy_);
+  return columns_.back();
+}
+
+std::vector<chunk> const& chunk::columns() const
+{
+  return columns_;
+}
+
+uint8_t const* chunk::data() const
+{
+  return mapping_ ? mapped_data_ : buffer_.data();
+}
+
+size_t chunk::size() const
+{
+  return mapping_ ? mapped_size_ : buffer_.size();
+}
+
+void chunk::serialize_outline(serializer& sink) const
+{
+  assert(! deferred_);
+  sink << compression_;
+  sink << elements_;
+  sink << bytes_;
+  sink << uint64_t{size()};
+  sink << marks_;
+  sink.begin_sequence(columns_.size());
+  for (auto& c : columns_)
+    c.serialize_outline(sink);
+  sink.end_sequence();
+}
+
+void chunk::serialize_bytes(serializer& sink) const
+{
+  if (size() > 0)
+    sink.write_raw(data(), size());
+
+  for (auto& c : columns_)
+    c.serialize_bytes(sink);
+}
+
+void chunk::deserialize_outline(deserializer& source,
+                                std::shared_ptr<void const> const& mapping)
+{
+  source >> compression_;
+  source >> elements_;
+  source >> bytes_;
+  source >> mapped_size_;
+  source >> marks_;
+  uint64_t n;
+  source.begin_sequence(n);
+  columns_.resize(n);
+  for (auto& c : columns_)
+    c.deserialize_outline(source, mapping);
+  source.end_sequence();
+
+  buffer_.clear();
+  mapping_ = mapping;
+  mapped_data_ = nullptr;
+}
+
+void chunk::attach(uint8_t const*& data)
+{
+  assert(mapping_);
+  mapped_data_ = data;
+  data += mapped_size_;
+  for (auto& c : columns_)
+    c.attach(data);
 }
 
 void chunk::serialize(serializer& sink) const
 {
+  assert(! deferred_);
   sink << compression_;
   sink << elements_;
   sink << bytes_;
-  sink << buffer_;
+  sink.begin_sequence(size());
+  if (size() > 0)
+    sink.write_raw(data(), size());
+  sink.end_sequence();
+  sink << marks_;
+  sink << columns_;
 }
 
 void chunk::deserialize(deserializer& source)
@@ -82,6 +369,11 @@ void chunk::deserialize(deserializer& source)
   source >> elements_;
   source >> bytes_;
   source >> buffer_;
+  source >> marks_;
+  source >> columns_;
+  mapping_.reset();
+  mapped_data_ = nullptr;
+  mapped_size_ = 0;
 }
 
 bool operator==(chunk const& x, chunk const& y)
@@ -89,7 +381,10 @@ bool operator==(chunk const& x, chunk const& y)
   return x.compression_ == y.compression_
       && x.elements_ == y.elements_
       && x.bytes_ == y.bytes_
-      && x.buffer_ == y.buffer_;
+      && x.size() == y.size()
+      && std::equal(x.data(), x.data() + x.size(), y.data())
+      && x.marks_ == y.marks_
+      && x.columns_ == y.columns_;
 }
 
 } // namespace vast
@@ -1,6 +1,7 @@
 #ifndef VAST_CHUNK_H
 #define VAST_CHUNK_H
 
+#include <memory>
 #include "vast/serialization.h"
 #include "vast/io/array_stream.h"
 #include "vast/io/container_stream.h"
@@ -10,7 +11,26 @@
 
 namespace vast {
 
-/// A compressed buffer of serialized objects.
+/// A compressed buffer of serialized objects. A chunk may additionally contain
+/// *columns*, i.e., nested chunks that compress independently of each other,
+/// so that readers only decompress those columns they need.
+///
+/// A chunk can also record an *offset table*, which maps every *k*-th element
+/// to its position in the compressed buffer. The writer aligns compression
+/// blocks at these elements, so that a reader can begin decompressing in the
+/// middle of the chunk.
+///
+/// With io::automatic compression, the writer serializes into an
+/// uncompressed buffer and, upon destruction, selects a compression method
+/// for the data and compresses it. Thereafter the chunk has the selected
+/// method.
+///
+/// A writer can also *defer* compression: it then serializes into an
+/// uncompressed buffer as well and leaves it to a later call of ::compress,
+/// e.g., on another thread, to compress the chunk.
+///
+/// A chunk read from a segment file may reference its compressed bytes in a
+/// memory mapping of the file instead of owning them.
 class chunk : util::equality_comparable<chunk>
 {
 public:
@@ -19,8 +39,19 @@ public:
   {
   public:
     /// Constructs a writer from a chunk.
+    ///
     /// @param chk The chunk to serialize into.
-    writer(chunk& chk);
+    ///
+    /// @param mark_interval If non-zero, records an entry in the offset table
+    /// every *mark_interval* elements.
+    ///
+    /// @param dictionary The ID of a zstd dictionary to compress with, or 0
+    /// for none.
+    ///
+    /// @param defer If `true`, the writer leaves the chunk uncompressed until
+    /// someone calls chunk::compress.
+    writer(chunk& chk, uint32_t mark_interval = 0, uint32_t dictionary = 0,
+           bool defer = false);
 
     /// Destructs a chunks.
     ~writer();
@@ -39,7 +70,10 @@ public:
     template <typename T>
     bool write(T const& x, size_t count = 1)
     {
-      serializer_ << x;
+      if (mark_interval_ > 0 && chunk_.elements_ >= next_mark_)
+        mark();
+
+      *serializer_ << x;
       chunk_.elements_ += count;
       return true;
     }
@@ -56,10 +90,28 @@ public:
     size_t bytes() const;
 
   private:
+    // Checks whether the writer serializes into an uncompressed buffer.
+    bool uncompressed() const;
+
+    // Creates the streams to serialize into.
+    void open();
+
+    // Flushes and destroys the streams.
+    void close();
+
+    // Ends the current compression block and records the position of the
+    // next element in the offset table.
+    void mark();
+
     chunk& chunk_;
+    uint32_t mark_interval_;
+    uint32_t next_mark_;
+    uint32_t dictionary_;
+    bool defer_;
+    size_t bytes_ = 0;
     io::container_output_stream<std::vector<uint8_t>> base_stream_;
     std::unique_ptr<io::compressed_output_stream> compressed_stream_;
-    binary_serializer serializer_;
+    std::unique_ptr<binary_serializer> serializer_;
   };
 
   /// A proxy class to deserialize from the chunk.
@@ -79,11 +131,23 @@ public:
       if (available_ == 0)
         return false;
 
-      deserializer_ >> x;
+      *deserializer_ >> x;
       available_ -= count > available_ ? available_ : count;
       return true;
     }
 
+    /// Moves the reader close to an element by means of the offset table.
+    /// The reader goes to the last table entry at or before *i*, unless its
+    /// current position lies already between that entry and *i*. Callers
+    /// must then read the remaining elements up to *i* themselves.
+    ///
+    /// @param i The element to move close to.
+    ///
+    /// @returns The element at which the reader now stands.
+    ///
+    /// @pre `i <= chk.elements()`
+    uint32_t seek(uint32_t i);
+
     /// Retrieves the number of objects available for deserialization.
     /// @returns The number of times one can call ::read on this chunk.
     uint32_t available() const;
@@ -93,16 +157,49 @@ public:
     size_t bytes() const;
 
   private:
+    // Begins decompressing at a given offset of the compressed buffer.
+    void open(size_t offset);
+
     chunk const& chunk_;
     uint32_t available_ = 0;
-    io::array_input_stream base_stream_;
+    std::unique_ptr<io::array_input_stream> base_stream_;
     std::unique_ptr<io::compressed_input_stream> compressed_stream_;
-    binary_deserializer deserializer_;
+    std::unique_ptr<binary_deserializer> deserializer_;
   };
 
   /// Constructs a chunk.
+  ///
   /// @param method The compression method to use.
-  explicit chunk(io::compression method = io::lz4);
+  ///
+  /// @param policy The objective by which to select a compression method if
+  /// *method* is io::automatic. Columns inherit it.
+  explicit chunk(io::compression method = io::lz4,
+                 io::compression_policy policy = io::balanced);
+
+  /// Retrieves the compression method of the chunk.
+  /// @returns The compression method, which is io::automatic only until the
+  /// first writer of the chunk has selected a method.
+  io::compression compression() const;
+
+  /// Compresses the data of a writer that deferred compression, including
+  /// that of all columns. If *method* is io::automatic, this is the point
+  /// where the chunk selects its compression method.
+  ///
+  /// @pre No writer or reader of the chunk exists.
+  void compress();
+
+  /// Decompresses the chunk, including all columns.
+  ///
+  /// @returns A copy of this chunk with io::null compression, from which
+  /// readers deserialize without decompressing.
+  ///
+  /// @pre `! deferred()`
+  chunk decompress() const;
+
+  /// Checks whether the chunk still awaits compression.
+  /// @returns `true` if a writer deferred compression and nobody has called
+  /// ::compress since.
+  bool deferred() const;
 
   /// Checks whether the chunk is empty.
   /// @returns `true` if the chunk has no elements.
@@ -113,24 +210,68 @@ public:
   uint32_t elements() const;
 
   /// Retrieves the size in bytes of the compressed/serialized buffer.
-  /// @returns The number of bytes of the serialized/compressed buffer.
+  /// @returns The number of bytes of the serialized/compressed buffer,
+  /// including all columns.
   size_t compressed_bytes() const;
 
   /// Retrieves the size in bytes of the compressed/serialized buffer.
-  /// @returns The number of bytes of the serialized/compressed buffer.
+  /// @returns The number of bytes of the serialized/compressed buffer,
+  /// including all columns.
   size_t uncompressed_bytes() const;
 
+  /// Appends a new column which uses the same compression method and policy
+  /// as this chunk.
+  /// @returns A reference to the new column.
+  /// @note References to existing columns become invalid.
+  chunk& add_column();
+
+  /// Retrieves the columns of the chunk.
+  /// @returns The columns in the order of ::add_column.
+  std::vector<chunk> const& columns() const;
+
   friend bool operator==(chunk const& x, chunk const& y);
 
 private:
   friend access;
+  friend class segment;
+
+  // Retrieves the compressed bytes, which the chunk either owns or
+  // references in a memory mapping.
+  uint8_t const* data() const;
+  size_t size() const;
+
+  // Serializes the chunk, including its columns, without the compressed
+  // bytes.
+  void serialize_outline(serializer& sink) const;
+
+  // Serializes the compressed bytes of the chunk followed by those of its
+  // columns, depth-first.
+  void serialize_bytes(serializer& sink) const;
+
+  // Deserializes the outline of a chunk whose compressed bytes reside in
+  // *mapping*. The chunk keeps the mapping alive.
+  void deserialize_outline(deserializer& source,
+                           std::shared_ptr<void const> const& mapping);
+
+  // Points the chunk and its columns to their compressed bytes, which begin
+  // at *data* in the order of ::serialize_bytes. Advances *data* past them.
+  void attach(uint8_t const*& data);
+
   void serialize(serializer& sink) const;
   void deserialize(deserializer& source);
 
   io::compression compression_;
+  io::compression_policy policy_;
+  bool deferred_ = false;
+  uint32_t dictionary_ = 0;
   uint32_t elements_ = 0;
   uint32_t bytes_ = 0;
   std::vector<uint8_t> buffer_;
+  std::shared_ptr<void const> mapping_;
+  uint8_t const* mapped_data_ = nullptr;
+  uint64_t mapped_size_ = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> marks_;
+  std::vector<chunk> columns_;
 };
 
 } // namespace vast
@@ -0,0 +1,784 @@
+#include "vast/columnar.h"
+
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include "vast/address.h"
+#include "vast/port.h"
+#include "vast/util/coding.h"
+
+namespace vast {
+
+namespace {
+
+// The encoding of a column.
+enum column_encoding : uint8_t
+{
+  generic_column    = 0x00, // Each value serialized on its own.
+  record_column     = 0x01, // Each event serialized as a whole.
+  bool_column       = 0x02,
+  int_column        = 0x03, // Zig-zag variable-byte integers.
+  uint_column       = 0x04, // Variable-byte integers.
+  double_column     = 0x05,
+  time_range_column = 0x06, // Zig-zag variable-byte nanoseconds.
+  time_point_column = 0x07, // Zig-zag variable-byte deltas in nanoseconds.
+  dictionary_column = 0x08, // Distinct strings plus one index per value.
+  string_column     = 0x09, // Length-prefixed strings.
+  address_column    = 0x0a, // 16 bytes in network byte order.
+  port_column       = 0x0b  // 2 bytes number plus 1 byte type.
+};
+
+// Strings go into a dictionary if there are at most half as many distinct
+// strings as values.
+size_t const max_dictionary_ratio = 2;
+
+uint64_t zigzag(int64_t x)
+{
+  return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+}
+
+int64_t unzigzag(uint64_t x)
+{
+  return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+}
+
+// Appends encoded values to a byte buffer.
+struct encoder
+{
+  void put_byte(uint8_t x)
+  {
+    bytes.push_back(x);
+  }
+
+  void put_raw(void const* data, size_t size)
+  {
+    auto p = reinterpret_cast<uint8_t const*>(data);
+    bytes.insert(bytes.end(), p, p + size);
+  }
+
+  void put_varbyte(uint64_t x)
+  {
+    uint8_t buf[util::varbyte::max_size<uint64_t>()];
+    put_raw(buf, util::varbyte::encode(x, buf));
+  }
+
+  void put_string(string const& str)
+  {
+    put_varbyte(str.size());
+    put_raw(str.data(), str.size());
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+// Extracts encoded values from a byte buffer. Once the buffer turns out to be
+// too short, all further extractions fail.
+struct decoder
+{
+  decoder(std::vector<uint8_t> const& bytes)
+    : p{bytes.data()},
+      end{bytes.data() + bytes.size()}
+  {
+  }
+
+  bool get_byte(uint8_t& x)
+  {
+    if (p == end)
+      return false;
+
+    x = *p++;
+    return true;
+  }
+
+  bool get_raw(void* data, size_t size)
+  {
+    if (static_cast<size_t>(end - p) < size)
+      return false;
+
+    std::memcpy(data, p, size);
+    p += size;
+    return true;
+  }
+
+  bool get_varbyte(uint64_t& x)
+  {
+    x = 0;
+    for (size_t i = 0; i < util::varbyte::max_size<uint64_t>(); ++i)
+    {
+      if (p == end)
+        return false;
+
+      auto low7 = *p++;
+      x |= static_cast<uint64_t>(low7 & 0x7f) << (7 * i);
+      if (! (low7 & 0x80))
+        return true;
+    }
+
+    return false;
+  }
+
+  bool get_string(string& str)
+  {
+    uint64_t size;
+    if (! get_varbyte(size) || static_cast<uint64_t>(end - p) < size)
+      return false;
+
+    str = string{reinterpret_cast<char const*>(p),
+                 static_cast<string::size_type>(size)};
+    p += size;
+    return true;
+  }
+
+  uint8_t const* p;
+  uint8_t const* end;
+};
+
+// Determines the value type shared by all values, or returns `invalid_value`
+// if there exists no such type.
+value_type common_type(std::vector<value const*> const& values)
+{
+  auto t = values.empty() ? invalid_value : values[0]->which();
+  for (auto v : values)
+    if (v->which() != t)
+      return invalid_value;
+
+  return t;
+}
+
+// Writes the values of a single column and returns the chosen encoding.
+uint8_t write_column(std::vector<value const*> const& values, chunk& column)
+{
+  auto t = common_type(values);
+  switch (t)
+  {
+    default:
+      {
+        chunk::writer w{column};
+        for (auto v : values)
+          w.write(*v);
+      }
+      return generic_column;
+    case bool_value:
+    case int_value:
+    case uint_value:
+    case double_value:
+    case time_range_value:
+    case time_point_value:
+    case string_value:
+    case address_value:
+    case port_value:
+      break;
+  }
+
+  encoder e;
+
+  // A presence bitmap precedes the values if at least one of them is nil.
+  auto nils = false;
+  for (auto v : values)
+    if (v->nil())
+      nils = true;
+
+  e.put_byte(nils ? 1 : 0);
+  if (nils)
+  {
+    std::vector<uint8_t> bitmap((values.size() + 7) / 8);
+    for (size_t i = 0; i < values.size(); ++i)
+      if (! values[i]->nil())
+        bitmap[i / 8] |= 1 << (i % 8);
+
+    e.put_raw(bitmap.data(), bitmap.size());
+  }
+
+  uint8_t encoding = generic_column;
+  switch (t)
+  {
+    default:
+      assert(! "unhandled value type");
+      break;
+    case bool_value:
+      encoding = bool_column;
+      for (auto v : values)
+        if (! v->nil())
+          e.put_byte(v->get<bool>() ? 1 : 0);
+      break;
+    case int_value:
+      encoding = int_column;
+      for (auto v : values)
+        if (! v->nil())
+          e.put_varbyte(zigzag(v->get<int64_t>()));
+      break;
+    case uint_value:
+      encoding = uint_column;
+      for (auto v : values)
+        if (! v->nil())
+          e.put_varbyte(v->get<uint64_t>());
+      break;
+    case double_value:
+      encoding = double_column;
+      for (auto v : values)
+        if (! v->nil())
+        {
+          auto d = v->get<double>();
+          e.put_raw(&d, sizeof(d));
+        }
+      break;
+    case time_range_value:
+      encoding = time_range_column;
+      for (auto v : values)
+        if (! v->nil())
+          e.put_varbyte(zigzag(v->get<time_range>().count()));
+      break;
+    case time_point_value:
+      {
+        encoding = time_point_column;
+        time_range::rep prev = 0;
+        for (auto v : values)
+          if (! v->nil())
+          {
+            auto ns = v->get<time_point>().since_epoch().count();
+            e.put_varbyte(zigzag(ns - prev));
+            prev = ns;
+          }
+      }
+      break;
+    case string_value:
+      {
+        size_t present = 0;
+        std::unordered_map<string, uint64_t> dictionary;
+        for (auto v : values)
+          if (! v->nil())
+          {
+            ++present;
+            dictionary.emplace(v->get<string>(), dictionary.size());
+          }
+
+        if (dictionary.size() * max_dictionary_ratio <= present)
+        {
+          encoding = dictionary_column;
+          std::vector<string const*> entries(dictionary.size());
+          for (auto& p : dictionary)
+            entries[p.second] = &p.first;
+
+          e.put_varbyte(entries.size());
+          for (auto str : entries)
+            e.put_string(*str);
+
+          for (auto v : values)
+            if (! v->nil())
+              e.put_varbyte(dictionary[v->get<string>()]);
+        }
+        else
+        {
+          encoding = string_column;
+          for (auto v : values)
+            if (! v->nil())
+              e.put_string(v->get<string>());
+        }
+      }
+      break;
+    case address_value:
+      encoding = address_column;
+      for (auto v : values)
+        if (! v->nil())
+        {
+          auto& bytes = v->get<address>().data();
+          e.put_raw(bytes.data(), bytes.size());
+        }
+      break;
+    case port_value:
+      encoding = port_column;
+      for (auto v : values)
+        if (! v->nil())
+        {
+          auto& p = v->get<port>();
+          auto n = p.number();
+          e.put_byte(n & 0xff);
+          e.put_byte(n >> 8);
+          e.put_byte(static_cast<uint8_t>(p.type()));
+        }
+      break;
+  }
+
+  chunk::writer w{column};
+  w.write(e.bytes, values.size());
+  return encoding;
+}
+
+// Maps a typed column encoding to the type of its values.
+value_type column_type(uint8_t encoding)
+{
+  switch (encoding)
+  {
+    default:
+      return invalid_value;
+    case bool_column:
+      return bool_value;
+    case int_column:
+      return int_value;
+    case uint_column:
+      return uint_value;
+    case double_column:
+      return double_value;
+    case time_range_column:
+      return time_range_value;
+    case time_point_column:
+      return time_point_value;
+    case dictionary_column:
+    case string_column:
+      return string_value;
+    case address_column:
+      return address_value;
+    case port_column:
+      return port_value;
+  }
+}
+
+// Reads the values of a typed column.
+trial<nothing> read_column(chunk const& column, uint8_t encoding, size_t n,
+                           std::vector<value>& values)
+{
+  auto t = column_type(encoding);
+  if (t == invalid_value)
+    return error{"invalid column encoding: " +
+                 std::to_string(static_cast<int>(encoding))};
+
+  std::vector<uint8_t> bytes;
+  chunk::reader r{column};
+  if (! r.read(bytes))
+    return error{"failed to read column"};
+
+  decoder d{bytes};
+  uint8_t nils;
+  if (! d.get_byte(nils))
+    return error{"truncated column"};
+
+  std::vector<uint8_t> bitmap;
+  if (nils)
+  {
+    bitmap.resize((n + 7) / 8);
+    if (! d.get_raw(bitmap.data(), bitmap.size()))
+      return error{"truncated column bitmap"};
+  }
+
+  std::vector<string> dictionary;
+  if (encoding == dictionary_column)
+  {
+    uint64_t size;
+    if (! d.get_varbyte(size) || size > n)
+      return error{"invalid string dictionary"};
+
+    dictionary.resize(size);
+    for (auto& str : dictionary)
+      if (! d.get_string(str))
+        return error{"truncated string dictionary"};
+  }
+
+  values.clear();
+  values.reserve(n);
+  time_range::rep prev = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (nils && ! (bitmap[i / 8] & (1 << (i % 8))))
+    {
+      values.emplace_back(t);
+      continue;
+    }
+
+    auto ok = true;
+    uint64_t x = 0;
+    switch (encoding)
+    {
+      case bool_column:
+        {
+          uint8_t b;
+          ok = d.get_byte(b);
+          if (ok)
+            values.emplace_back(b != 0);
+        }
+        break;
+      case int_column:
+        ok = d.get_varbyte(x);
+        if (ok)
+          values.emplace_back(unzigzag(x));
+        break;
+      case uint_column:
+        ok = d.get_varbyte(x);
+        if (ok)
+          values.emplace_back(x);
+        break;
+      case double_column:
+        {
+          double f;
+          ok = d.get_raw(&f, sizeof(f));
+          if (ok)
+            values.emplace_back(f);
+        }
+        break;
+      case time_range_column:
+        ok = d.get_varbyte(x);
+        if (ok)
+          values.emplace_back(time_range::nanoseconds(unzigzag(x)));
+        break;
+      case time_point_column:
+        ok = d.get_varbyte(x);
+        if (ok)
+        {
+          prev += unzigzag(x);
+          values.emplace_back(time_point{time_range::nanoseconds(prev)});
+        }
+        break;
+      case dictionary_column:
+        ok = d.get_varbyte(x) && x < dictionary.size();
+        if (ok)
+          values.emplace_back(dictionary[x]);
+        break;
+      case string_column:
+        {
+          string str;
+          ok = d.get_string(str);
+          if (ok)
+            values.emplace_back(std::move(str));
+        }
+        break;
+      case address_column:
+        {
+          uint32_t bytes[4];
+          ok = d.get_raw(bytes, sizeof(bytes));
+          if (ok)
+            values.emplace_back(
+                address{bytes, address::ipv6, address::network});
+        }
+        break;
+      case port_column:
+        {
+          uint8_t p[3];
+          ok = d.get_raw(p, sizeof(p));
+          if (ok)
+          {
+            auto n = static_cast<port::number_type>(p[0] | (p[1] << 8));
+            values.emplace_back(port{n, static_cast<port::port_type>(p[2])});
+          }
+        }
+        break;
+    }
+
+    if (! ok)
+      return error{"truncated column"};
+  }
+
+  return nil;
+}
+
+} // namespace <anonymous>
+
+trial<nothing> write_columns(std::vector<event> const& events, chunk& chk)
+{
+  if (events.empty())
+    return error{"no events to write"};
+
+  assert(chk.empty() && chk.columns().empty());
+
+  // Group the events by type, keeping the order of first appearance.
+  struct group
+  {
+    event_type type;
+    size_t arity;
+    bool uniform;
+    std::vector<event const*> events;
+  };
+
+  std::vector<group> groups;
+  std::unordered_map<event_type, uint32_t> index;
+  encoder types;
+  encoder timestamps;
+  time_range::rep prev = 0;
+  for (auto& e : events)
+  {
+    auto i = index.find(e.type());
+    if (i == index.end())
+    {
+      i = index.emplace(e.type(), groups.size()).first;
+      groups.push_back({e.type(), e.size(), true, {}});
+    }
+
+    auto& g = groups[i->second];
+    g.uniform = g.uniform && e.size() == g.arity;
+    g.events.push_back(&e);
+    types.put_varbyte(i->second);
+
+    auto ns = e.timestamp().since_epoch().count();
+    timestamps.put_varbyte(zigzag(ns - prev));
+    prev = ns;
+  }
+
+  {
+    chunk::writer w{chk.add_column()};
+    w.write(types.bytes, events.size());
+  }
+
+  {
+    chunk::writer w{chk.add_column()};
+    w.write(timestamps.bytes, events.size());
+  }
+
+  // Within each group, we encode each top-level field as a column. Groups of
+  // events with a varying number of fields go as a whole into one column.
+  struct column
+  {
+    uint8_t encoding;
+    uint32_t index;
+  };
+
+  std::vector<std::vector<column>> directory;
+  for (auto& g : groups)
+  {
+    directory.emplace_back();
+    if (! g.uniform)
+    {
+      uint32_t idx = chk.columns().size();
+      chunk::writer w{chk.add_column()};
+      for (auto e : g.events)
+        w.write(static_cast<std::vector<value> const&>(*e));
+
+      directory.back().push_back({record_column, idx});
+      continue;
+    }
+
+    std::vector<value const*> values(g.events.size());
+    for (size_t f = 0; f < g.arity; ++f)
+    {
+      for (size_t i = 0; i < g.events.size(); ++i)
+        values[i] = &(*g.events[i])[f];
+
+      uint32_t idx = chk.columns().size();
+      auto encoding = write_column(values, chk.add_column());
+      directory.back().push_back({encoding, idx});
+    }
+  }
+
+  chunk::writer w{chk};
+  w.write(static_cast<uint32_t>(groups.size()), events.size());
+  for (size_t i = 0; i < groups.size(); ++i)
+  {
+    w.write(groups[i].type, 0);
+    w.write(static_cast<uint32_t>(groups[i].events.size()), 0);
+    w.write(static_cast<uint32_t>(directory[i].size()), 0);
+    for (auto& c : directory[i])
+    {
+      w.write(c.encoding, 0);
+      w.write(c.index, 0);
+    }
+  }
+
+  return nil;
+}
+
+
+column_reader::column_reader(
+    chunk const& chk,
+    std::unordered_map<event_type, event_type> const* types)
+  : chunk_{chk},
+    types_{types}
+{
+  assert(! chunk_.columns().empty());
+}
+
+size_t column_reader::size() const
+{
+  return chunk_.elements();
+}
+
+trial<event> column_reader::read(size_t i, std::vector<size_t> const* fields)
+{
+  if (! loaded_)
+  {
+    auto t = load();
+    if (! t)
+      return t.failure();
+
+    loaded_ = true;
+  }
+
+  if (i >= group_of_.size())
+    return error{"column index out of bounds"};
+
+  auto& g = groups_[group_of_[i]];
+  auto r = rank_[i];
+
+  event e;
+  e.type(g.type);
+  e.timestamp(timestamps_[i]);
+
+  if (g.columns.size() == 1 && g.columns[0].encoding == record_column)
+  {
+    auto& c = g.columns[0];
+    if (! c.decoded)
+    {
+      auto t = decode(g, c);
+      if (! t)
+        return t.failure();
+    }
+
+    static_cast<record&>(e) = c.values[r].get<record>();
+    return {std::move(e)};
+  }
+
+  e.resize(g.columns.size());
+  auto materialize = [&](size_t f) -> trial<nothing>
+  {
+    if (f >= g.columns.size())
+      return nil;
+
+    auto& c = g.columns[f];
+    if (! c.decoded)
+    {
+      auto t = decode(g, c);
+      if (! t)
+        return t;
+    }
+
+    e[f] = c.values[r];
+    return nil;
+  };
+
+  if (fields)
+  {
+    for (auto f : *fields)
+    {
+      auto t = materialize(f);
+      if (! t)
+        return t.failure();
+    }
+  }
+  else
+  {
+    for (size_t f = 0; f < g.columns.size(); ++f)
+    {
+      auto t = materialize(f);
+      if (! t)
+        return t.failure();
+    }
+  }
+
+  return {std::move(e)};
+}
+
+trial<nothing> column_reader::load()
+{
+  auto& columns = chunk_.columns();
+  if (columns.size() < 2)
+    return error{"columnar chunk lacks type and timestamp columns"};
+
+  chunk::reader r{chunk_};
+  uint32_t n;
+  if (! r.read(n, 0))
+    return error{"failed to read column directory"};
+
+  groups_.resize(n);
+  for (auto& g : groups_)
+  {
+    uint32_t size, cols;
+    if (! (r.read(g.type, 0) && r.read(size, 0) && r.read(cols, 0)))
+      return error{"failed to read column directory"};
+
+    if (types_)
+    {
+      auto i = types_->find(g.type);
+      if (i != types_->end())
+        g.type = i->second;
+    }
+
+    g.size = size;
+    g.columns.resize(cols);
+    for (auto& c : g.columns)
+    {
+      if (! (r.read(c.encoding, 0) && r.read(c.index, 0)))
+        return error{"failed to read column directory"};
+
+      if (c.index >= columns.size())
+        return error{"invalid column index"};
+    }
+  }
+
+  std::vector<uint8_t> bytes;
+  chunk::reader types{columns[0]};
+  if (! types.read(bytes))
+    return error{"failed to read type column"};
+
+  decoder d{bytes};
+  std::vector<uint32_t> ranks(groups_.size(), 0);
+  group_of_.resize(size());
+  rank_.resize(size());
+  for (size_t i = 0; i < size(); ++i)
+  {
+    uint64_t g;
+    if (! d.get_varbyte(g) || g >= groups_.size())
+      return error{"invalid type column"};
+
+    group_of_[i] = g;
+    rank_[i] = ranks[g]++;
+    if (rank_[i] >= groups_[g].size)
+      return error{"inconsistent type column"};
+  }
+
+  bytes.clear();
+  chunk::reader ts{columns[1]};
+  if (! ts.read(bytes))
+    return error{"failed to read timestamp column"};
+
+  d = decoder{bytes};
+  timestamps_.resize(size());
+  time_range::rep prev = 0;
+  for (auto& t : timestamps_)
+  {
+    uint64_t x;
+    if (! d.get_varbyte(x))
+      return error{"truncated timestamp column"};
+
+    prev += unzigzag(x);
+    t = time_point{time_range::nanoseconds(prev)};
+  }
+
+  return nil;
+}
+
+trial<nothing> column_reader::decode(group& g, column& c)
+{
+  auto& col = chunk_.columns()[c.index];
+  if (c.encoding == generic_column || c.encoding == record_column)
+  {
+    c.values.clear();
+    c.values.reserve(g.size);
+    chunk::reader r{col};
+    for (size_t i = 0; i < g.size; ++i)
+    {
+      if (c.encoding == generic_column)
+      {
+        value v;
+        if (! r.read(v))
+          return error{"failed to read generic column"};
+
+        c.values.push_back(std::move(v));
+      }
+      else
+      {
+        std::vector<value> v;
+        if (! r.read(v))
+          return error{"failed to read record column"};
+
+        c.values.emplace_back(record(std::move(v)));
+      }
+    }
+  }
+  else
+  {
+    auto t = read_column(col, c.encoding, g.size, c.values);
+    if (! t)
+      return t;
+  }
+
+  c.decoded = true;
+  return nil;
+}
+
+} // namespace vast
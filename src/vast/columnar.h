@@ -0,0 +1,93 @@
+#ifndef VAST_COLUMNAR_H
+#define VAST_COLUMNAR_H
+
+#include <unordered_map>
+#include <vector>
+#include "vast/aliases.h"
+#include "vast/chunk.h"
+#include "vast/event.h"
+#include "vast/util/result.h"
+
+namespace vast {
+
+/// Writes events column by column into a chunk. The chunk contains one column
+/// for the event types, one for the timestamps, and then, for each event
+/// type, one column per top-level field. Each column picks an encoding based
+/// on the values it holds: deltas for time points, a dictionary for
+/// strings with few distinct values, fixed-width bytes for addresses and
+/// ports, and variable-byte integers. Columns with values of different types
+/// fall back to serializing each value.
+///
+/// @param events The events to write.
+///
+/// @param chk The empty chunk to write into.
+///
+/// @returns `nothing` on success.
+trial<nothing> write_columns(std::vector<event> const& events, chunk& chk);
+
+/// Reads events from a chunk written by ::write_columns. The reader decodes
+/// a column when it first needs a value from it and then provides random
+/// access to all events of the chunk.
+class column_reader
+{
+public:
+  /// Constructs a column reader.
+  ///
+  /// @param chk The chunk to read from.
+  ///
+  /// @param types If not `nullptr`, maps the event types in *chk* to those
+  /// of this process where they differ.
+  ///
+  /// @pre `! chk.columns().empty()`
+  explicit column_reader(
+      chunk const& chk,
+      std::unordered_map<event_type, event_type> const* types = nullptr);
+
+  /// Retrieves the number of events in the chunk.
+  /// @returns The number of events.
+  size_t size() const;
+
+  /// Materializes an event.
+  ///
+  /// @param i The position of the event within the chunk.
+  ///
+  /// @param fields The indexes of the top-level fields to materialize. If
+  /// `nullptr`, the reader materializes all fields. The remaining fields
+  /// have an invalid value.
+  ///
+  /// @returns The event at position *i*.
+  ///
+  /// @pre `i < size()`
+  trial<event> read(size_t i, std::vector<size_t> const* fields = nullptr);
+
+private:
+  struct column
+  {
+    uint8_t encoding;
+    uint32_t index;
+    bool decoded = false;
+    std::vector<value> values;
+  };
+
+  struct group
+  {
+    event_type type;
+    size_t size = 0;
+    std::vector<column> columns;
+  };
+
+  trial<nothing> load();
+  trial<nothing> decode(group& g, column& c);
+
+  chunk const& chunk_;
+  std::unordered_map<event_type, event_type> const* types_;
+  bool loaded_ = false;
+  std::vector<group> groups_;
+  std::vector<uint32_t> group_of_;
+  std::vector<uint32_t> rank_;
+  std::vector<time_point> timestamps_;
+};
+
+} // namespace vast
+
+#endif
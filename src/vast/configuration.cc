@@ -90,10 +90,39 @@ void configuration::initialize()
   ingest.add("max-events-per-chunk", "maximum number of events per chunk")
         .init(5000);
   ingest.add("max-segment-size", "maximum segment size in MB").init(128);
+  ingest.add("chunk-layout", "layout of events in a chunk (row|columnar); "
+             "queries decode only the columns of a columnar chunk which "
+             "they reference").init("row");
+  ingest.add("compression", "compression method of chunks "
+             "(null|lz4|snappy|zstd|automatic)").init("lz4");
+  ingest.add("compression-policy", "objective of automatic compression "
+             "(fastest|smallest|balanced)").init("balanced");
+  ingest.add("compression-threads", "number of threads compressing chunks "
+             "for all segmentizers (0 = segmentizers compress)").init(2);
+#ifdef VAST_HAVE_ZSTD
+  ingest.add("zstd-level", "compression level of zstd").init(3);
+#endif
   ingest.add("batch-size", "number of events to ingest in one run").init(4000);
-  ingest.add('r', "file-name", "path to file to ingest").single();
+  ingest.add("credit", "number of events a source may send ahead of the "
+             "segmentizer (0 = unlimited)").init(40000);
+  ingest.add("max-inflight-segments", "number of un-acked segments before "
+             "sources wait (0 = unlimited)").init(4);
+  ingest.add('r', "file-name", "path to file, directory, or glob pattern to "
+             "ingest").single();
+  ingest.add("listen", "host:port or Unix socket path to accept streamed "
+             "logs on").single();
+  ingest.add("max-sources", "number of files to ingest concurrently").init(4);
+  ingest.add("segmentizers", "number of segmentizers to feed").init(1);
+  ingest.add("parse-stage", "scheduling of sources (detached|pooled)")
+        .init("detached");
+  ingest.add("segmentize-stage", "scheduling of segmentizers "
+             "(detached|pooled)").init("pooled");
+  ingest.add("ship-stage", "scheduling of the ingestor (detached|pooled)")
+        .init("pooled");
   ingest.add("file-type", "file type of the file to ingest").init("bro2");
   ingest.add("time-field", "field to extract event timestamp from").init(-1);
+  ingest.add("parse-threads", "number of threads to parse a file with")
+        .init(1);
   ingest.add("submit", "send orphaned segments on startup");
 #ifdef VAST_HAVE_BROCCOLI
   ingest.add("broccoli-host", "hostname/address of the broccoli source")
@@ -112,8 +141,18 @@ void configuration::initialize()
   auto& archive = create_block("archive options", "archive");
   archive.add("host", "hostname/address of the archive").init("127.0.0.1");
   archive.add("port", "TCP port of the archive").init(42003);
-  archive.add("max-segments", "maximum number of segments to keep in memory")
-         .init(500);
+  archive.add("cache-size", "maximum size of segments in memory in MB")
+         .init(1024);
+  archive.add("cache-policy", "segment cache replacement policy "
+              "(lru|2q|arc|clock)").init("2q");
+  archive.add("io-threads", "number of threads reading and writing segments")
+         .init(4);
+  archive.add("durability", "when to flush new segments to disk "
+              "(none|segment|group)").init("group");
+  archive.add("group-commit-window", "milliseconds to collect segments "
+              "before flushing them together").init(50);
+  archive.add("compaction-target", "size in MB up to which to merge small "
+              "adjacent segments (0 = off)").init(128);
   archive.visible(false);
 
   auto& index = create_block("index options", "index");
@@ -121,6 +160,12 @@ void configuration::initialize()
   index.add("port", "TCP port of the index").init(42004);
   index.add("partition", "name of the partition to append to").single();
   index.add("batch-size", "number of events to index in one run").init(5000);
+  index.add("read-ahead-threads", "number of threads decompressing segments "
+            "ahead of indexing (0 = off)").init(0);
+  index.add("max-indexers", "maximum number of loaded indexers per "
+            "partition (0 = unlimited)").init(0);
+  index.add("indexer-policy", "replacement policy for loaded indexers "
+            "(lru|2q|arc|clock)").init("2q");
   index.add("rebuild", "rebuild indexes from archive");
   index.visible(false);
 
@@ -148,6 +193,8 @@ void configuration::initialize()
   add_dependency("ingest.time-field", "ingestor-actor");
   add_dependency("ingest.submit", "ingestor-actor");
   add_dependency("ingest.file-name", "ingestor-actor");
+  add_dependency("ingest.listen", "ingestor-actor");
+  add_conflict("ingest.listen", "ingest.file-name");
   add_dependency("ingest.file-type", "ingest.file-name");
   add_dependencies("index.partition", {"index-actor", "all-server"});
   add_conflict("index.rebuild", "index.partition");
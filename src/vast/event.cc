@@ -1,5 +1,6 @@
 #include "vast/event.h"
 
+#include "vast/event_type_registry.h"
 #include "vast/logger.h"
 #include "vast/serialization.h"
 
@@ -27,12 +28,25 @@ void event::id(event_id i)
 
 string const& event::name() const
 {
-  return name_;
+  auto name = event_type_registry::instance()->name(type_);
+  assert(name != nullptr);
+  return *name;
 }
 
-void event::name(string str)
+void event::name(string const& str)
 {
-  name_ = std::move(str);
+  type_ = event_type_registry::instance()->intern(str);
+}
+
+event_type event::type() const
+{
+  return type_;
+}
+
+void event::type(event_type t)
+{
+  assert(event_type_registry::instance()->name(t) != nullptr);
+  type_ = t;
 }
 
 time_point event::timestamp() const
@@ -49,7 +63,8 @@ void event::serialize(serializer& sink) const
 {
   VAST_ENTER(VAST_THIS);
   sink << id_;
-  sink << name_;
+  // Event types only have a meaning within the process that assigned them.
+  sink << name();
   sink << timestamp_;
   sink << static_cast<record const&>(*this);
 }
@@ -58,7 +73,9 @@ void event::deserialize(deserializer& source)
 {
   VAST_ENTER();
   source >> id_;
-  source >> name_;
+  string name;
+  source >> name;
+  type_ = event_type_registry::instance()->intern(name);
   source >> timestamp_;
   source >> static_cast<record&>(*this);
   VAST_LEAVE(VAST_THIS);
@@ -68,7 +85,7 @@ bool operator==(event const& x, event const& y)
 {
   return
     x.id() == y.id() &&
-    x.name_ == y.name_ &&
+    x.type_ == y.type_ &&
     x.timestamp_ == y.timestamp_ &&
     x.size() == y.size() &&
     std::equal(x.begin(), x.end(), y.begin());
@@ -77,8 +94,8 @@ bool operator==(event const& x, event const& y)
 bool operator<(event const& x, event const& y)
 {
   return
-    std::tie(x.id_, x.timestamp_, x.name_, static_cast<record const&>(x)) <
-    std::tie(y.id_, y.timestamp_, y.name_, static_cast<record const&>(y));
+    std::tie(x.id_, x.timestamp_, x.type_, static_cast<record const&>(x)) <
+    std::tie(y.id_, y.timestamp_, y.type_, static_cast<record const&>(y));
 }
 
 void swap(event& x, event& y)
@@ -87,7 +104,7 @@ void swap(event& x, event& y)
   swap(static_cast<record&>(x), static_cast<record&>(y));
   swap(x.id_, y.id_);
   swap(x.timestamp_, y.timestamp_);
-  swap(x.name_, y.name_);
+  swap(x.type_, y.type_);
 }
 
 } // namespace vast
@@ -40,7 +40,16 @@ public:
 
   /// Sets the event name.
   /// @param str The new name of event.
-  void name(string str);
+  void name(string const& str);
+
+  /// Retrieves the event type, the process-local integral representation of
+  /// the event name.
+  /// @returns The type of the event.
+  event_type type() const;
+
+  /// Sets the event type.
+  /// @param t The new type of the event, as given by ::event_type_registry.
+  void type(event_type t);
 
   /// Retrieves the event timestamp.
   /// @returns The event timestamp.
@@ -53,7 +62,7 @@ public:
 private:
   event_id id_ = 0;
   time_point timestamp_;
-  string name_;
+  event_type type_ = unnamed_event_type;
 
 private:
   friend access;
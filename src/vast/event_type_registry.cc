@@ -0,0 +1,83 @@
+#include "vast/event_type_registry.h"
+
+#include <cassert>
+#include "vast/util/monotonic_arena.h"
+
+namespace vast {
+
+event_type event_type_registry::intern(string const& name)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = types_.find(name);
+  if (i != types_.end())
+    return i->second;
+
+  auto t = static_cast<event_type>(size_.load(std::memory_order_relaxed));
+
+  // The registry lives forever, so its copy of the name must not come from
+  // the arena of a batch.
+  util::arena_scope heap{nullptr};
+
+  // The keys of a hash table remain in place during rehashing.
+  auto p = types_.emplace(name, t);
+  append(&p.first->first);
+  return t;
+}
+
+optional<event_type> event_type_registry::lookup(string const& name) const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = types_.find(name);
+  if (i == types_.end())
+    return {};
+
+  return i->second;
+}
+
+string const* event_type_registry::name(event_type t) const
+{
+  if (t >= size_.load(std::memory_order_acquire))
+    return nullptr;
+
+  return names_[t / block_size][t % block_size];
+}
+
+size_t event_type_registry::size() const
+{
+  return size_.load(std::memory_order_acquire);
+}
+
+void event_type_registry::append(string const* name)
+{
+  auto n = size_.load(std::memory_order_relaxed);
+  assert(n < block_size * max_blocks);
+  auto& block = names_[n / block_size];
+  if (! block)
+    block.reset(new string const*[block_size]);
+
+  block[n % block_size] = name;
+  size_.store(n + 1, std::memory_order_release);
+}
+
+event_type_registry* event_type_registry::create()
+{
+  return new event_type_registry;
+}
+
+void event_type_registry::initialize()
+{
+  auto p = types_.emplace(string{}, unnamed_event_type);
+  append(&p.first->first);
+}
+
+void event_type_registry::destroy()
+{
+  delete this;
+}
+
+void event_type_registry::dispose()
+{
+  delete this;
+}
+
+} // namespace vast
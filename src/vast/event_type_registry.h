@@ -0,0 +1,69 @@
+#ifndef VAST_EVENT_TYPE_REGISTRY_H
+#define VAST_EVENT_TYPE_REGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "vast/aliases.h"
+#include "vast/optional.h"
+#include "vast/singleton.h"
+#include "vast/string.h"
+
+namespace vast {
+
+/// Interns event names into compact numeric event types, so that events need
+/// not carry their name as a string. Event types are only meaningful within
+/// the process that assigned them: whenever events leave a process, they
+/// travel with their name, and the receiving side interns it again.
+class event_type_registry : public singleton<event_type_registry>
+{
+  friend singleton<event_type_registry>;
+
+public:
+  /// Retrieves the event type of a name and registers it if necessary.
+  /// @param name The event name.
+  /// @returns The event type of *name*.
+  event_type intern(string const& name);
+
+  /// Retrieves the event type of a name without registering it.
+  /// @param name The event name to lookup.
+  /// @returns The event type of *name* if it has been registered.
+  optional<event_type> lookup(string const& name) const;
+
+  /// Retrieves the name of an event type. Since the registry never removes a
+  /// name, this lookup does not lock.
+  /// @param t The event type to lookup.
+  /// @returns The name of *t* or `nullptr` if *t* does not exist.
+  string const* name(event_type t) const;
+
+  /// Retrieves the number of registered event types.
+  /// @returns The number of event types, including ::unnamed_event_type.
+  size_t size() const;
+
+private:
+  // Singleton implementation.
+  static event_type_registry* create();
+  void initialize();
+  void destroy();
+  void dispose();
+
+  // Appends the name of the next event type.
+  void append(string const* name);
+
+  // The names live in blocks which never move once allocated, so that readers
+  // can access a name while ::intern appends another one. Publishing the new
+  // size orders the write of a name before any read of it.
+  static size_t const block_size = 1024;
+  static size_t const max_blocks = 4096;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<string, event_type> types_;
+  std::array<std::unique_ptr<string const*[]>, max_blocks> names_;
+  std::atomic<size_t> size_{0};
+};
+
+} // namespace vast
+
+#endif
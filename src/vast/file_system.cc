@@ -11,7 +11,9 @@
 #  include <cstdio>
 #  include <dirent.h>
 #  include <fcntl.h>
+#  include <glob.h>
 #  include <unistd.h>
+#  include <sys/mman.h>
 #  include <sys/stat.h>
 #  include <sys/types.h>
 #  define VAST_ERRNO errno
@@ -365,6 +367,7 @@ bool file::close()
     result = ::close(handle_);
   }
   while (result < 0 && errno == EINTR);
+  is_open_ = false;
   return ! result;
 #else
   return false;
@@ -376,6 +379,11 @@ bool file::is_open() const
   return is_open_;
 }
 
+file::native_type file::handle() const
+{
+  return handle_;
+}
+
 bool file::read(void* sink, size_t bytes, size_t* got)
 {
   if (got)
@@ -452,6 +460,81 @@ bool file::seek(size_t bytes, size_t *skipped)
   return true;
 }
 
+bool file::sync(bool metadata)
+{
+  if (! is_open_)
+    return false;
+#ifdef VAST_LINUX
+  if (! metadata)
+    return ::fdatasync(handle_) == 0;
+#endif
+#ifdef VAST_POSIX
+  return ::fsync(handle_) == 0;
+#else
+  return false;
+#endif // VAST_POSIX
+}
+
+trial<std::shared_ptr<mapped_file>> mapped_file::map(path const& p)
+{
+#ifdef VAST_POSIX
+  std::shared_ptr<mapped_file> m{new mapped_file};
+  auto fd = ::open(p.str().data(), O_RDONLY);
+  if (fd == -1)
+    return error{"failed to open " + to_string(p) + ": " +
+                 std::strerror(errno)};
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    auto e = error{"failed to stat " + to_string(p) + ": " +
+                   std::strerror(errno)};
+    ::close(fd);
+    return e;
+  }
+
+  // An empty file has no mapping.
+  m->size_ = static_cast<size_t>(st.st_size);
+  if (m->size_ > 0)
+  {
+    auto data = ::mmap(nullptr, m->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      auto e = error{"failed to map " + to_string(p) + ": " +
+                     std::strerror(errno)};
+      ::close(fd);
+      return e;
+    }
+
+    m->data_ = data;
+  }
+
+  // The mapping outlives the descriptor.
+  ::close(fd);
+  return m;
+#else
+  return error{"not implemented"};
+#endif // VAST_POSIX
+}
+
+mapped_file::~mapped_file()
+{
+#ifdef VAST_POSIX
+  if (data_)
+    ::munmap(data_, size_);
+#endif // VAST_POSIX
+}
+
+uint8_t const* mapped_file::data() const
+{
+  return static_cast<uint8_t const*>(data_);
+}
+
+size_t mapped_file::size() const
+{
+  return size_;
+}
+
 
 bool exists(path const& p)
 {
@@ -478,6 +561,39 @@ bool rm(const path& p)
   return false;
 }
 
+trial<nothing> mv(path const& from, path const& to)
+{
+#ifdef VAST_POSIX
+  if (! VAST_MOVE_FILE(from.str().data(), to.str().data()))
+    return error{"failed to move " + to_string(from) + " to " +
+                 to_string(to) + ": " + std::strerror(errno)};
+
+  return nil;
+#else
+  return error{"not implemented"};
+#endif // VAST_POSIX
+}
+
+trial<nothing> sync_directory(path const& p)
+{
+#ifdef VAST_POSIX
+  auto fd = ::open(p.str().data(), O_RDONLY);
+  if (fd == -1)
+    return error{"failed to open " + to_string(p) + ": " +
+                 std::strerror(errno)};
+
+  auto synced = ::fsync(fd) == 0;
+  auto e = errno;
+  ::close(fd);
+  if (! synced)
+    return error{"failed to sync " + to_string(p) + ": " + std::strerror(e)};
+
+  return nil;
+#else
+  return error{"not implemented"};
+#endif // VAST_POSIX
+}
+
 trial<nothing> mkdir(path const& p)
 {
   auto components = p.split();
@@ -531,6 +647,34 @@ void traverse(path const& p, std::function<bool(path const&)> f)
 #endif // VAST_POSIX
 }
 
+trial<uint64_t> file_size(path const& p)
+{
+#ifdef VAST_POSIX
+  struct stat st;
+  if (::stat(p.str().data(), &st) != 0)
+    return error{"failed to stat " + to_string(p) + ": " +
+                 std::strerror(errno)};
+
+  return static_cast<uint64_t>(st.st_size);
+#else
+  return error{"not implemented"};
+#endif // VAST_POSIX
+}
+
+std::vector<path> glob(std::string const& pattern)
+{
+  std::vector<path> paths;
+#ifdef VAST_POSIX
+  glob_t g;
+  if (::glob(pattern.data(), 0, nullptr, &g) == 0)
+    for (size_t i = 0; i < g.gl_pathc; ++i)
+      paths.emplace_back(g.gl_pathv[i]);
+
+  ::globfree(&g);
+#endif // VAST_POSIX
+  return paths;
+}
+
 // Loads file contents into a string.
 trial<std::string> load(path const& p, bool skip_whitespace)
 {
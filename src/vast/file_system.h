@@ -2,7 +2,9 @@
 #define VAST_FILE_SYSTEM_H
 
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 #include "vast/config.h"
 #include "vast/fwd.h"
 #include "vast/string.h"
@@ -206,6 +208,11 @@ public:
   /// @returns `true` iff the file is open
   bool is_open() const;
 
+  /// Retrieves the native handle of the file.
+  /// @returns The OS' native file handle.
+  /// @pre `is_open()`
+  native_type handle() const;
+
   /// Reads a given number of bytes in to a buffer.
   /// @param sink The destination of the read.
   /// @param size The number of bytes to read.
@@ -230,6 +237,14 @@ public:
   /// @returns `true` on success.
   bool seek(size_t bytes, size_t* skipped = nullptr);
 
+  /// Flushes all written data of the file to the storage device.
+  ///
+  /// @param metadata If `false`, flushes only the metadata needed to read
+  /// the data back, e.g., the file size but not the modification time.
+  ///
+  /// @returns `true` on success.
+  bool sync(bool metadata = true);
+
 private:
   native_type handle_;
   bool is_open_ = false;
@@ -237,6 +252,37 @@ private:
   path path_;
 };
 
+/// A read-only memory mapping of a file. The operating system reads the
+/// pages of the file only when they are first accessed.
+class mapped_file
+{
+  mapped_file(mapped_file const&) = delete;
+  mapped_file& operator=(mapped_file const&) = delete;
+
+public:
+  /// Maps a file into memory.
+  /// @param p The path of the file to map.
+  /// @returns The mapping of *p*.
+  static trial<std::shared_ptr<mapped_file>> map(path const& p);
+
+  /// Unmaps the file.
+  ~mapped_file();
+
+  /// Retrieves the mapped bytes.
+  /// @returns A pointer to the beginning of the file.
+  uint8_t const* data() const;
+
+  /// Retrieves the size of the mapping.
+  /// @returns The size of the file in bytes.
+  size_t size() const;
+
+private:
+  mapped_file() = default;
+
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
 /// Checks whether the path exists on the filesystem.
 /// @param p The path to check for existance.
 /// @returns `true` if *p* exists.
@@ -247,6 +293,18 @@ bool exists(path const& p);
 /// @returns `true` if *p* has been successfully deleted.
 bool rm(path const& p);
 
+/// Renames a path on the filesystem, replacing the destination if it exists.
+/// @param from The path to rename.
+/// @param to The new path.
+/// @returns `nothing` on success.
+trial<nothing> mv(path const& from, path const& to);
+
+/// Flushes the entries of a directory to the storage device, so that
+/// creating or renaming a file in it survives a crash.
+/// @param p The directory to flush.
+/// @returns `nothing` on success.
+trial<nothing> sync_directory(path const& p);
+
 /// If the path does not exist, create it as directory.
 /// @param p The path to a directory to create.
 /// @returns `true` on success or if *p* exists already.
@@ -261,6 +319,16 @@ trial<nothing> mkdir(path const& p);
 /// iterating.
 void traverse(path const& p, std::function<bool(path const&)> f);
 
+/// Retrieves the size of a file.
+/// @param p The path to a file.
+/// @returns The size of *p* in bytes.
+trial<uint64_t> file_size(path const& p);
+
+/// Expands a shell wildcard pattern into the paths it matches.
+/// @param pattern The pattern, e.g., `/var/log/bro/conn.*.log.gz`.
+/// @returns The paths matching *pattern* in lexicographical order.
+std::vector<path> glob(std::string const& pattern);
+
 // Loads file contents into a string.
 // @param p The path of the file to load.
 // @param skip_whitespace Whether to ignore whitespace.
@@ -59,6 +59,10 @@ template <typename Container> class container_output_stream;
 enum compression : uint8_t;
 } // namespace io
 
+namespace util {
+class monotonic_arena;
+} // namespace util
+
 } // namespace vast
 
 #endif
@@ -6,6 +6,7 @@
 #include "vast/expression.h"
 #include "vast/partition.h"
 #include "vast/io/serialization.h"
+#include "vast/util/thread_pool.h"
 
 namespace vast {
 
@@ -448,10 +449,16 @@ std::vector<expr::ast> index::walk(
 
 using namespace cppa;
 
-index_actor::index_actor(path dir, size_t batch_size)
+index_actor::index_actor(path dir, size_t batch_size,
+                         size_t read_ahead_threads, size_t max_indexers,
+                         util::cache_policy indexer_policy)
   : dir_{std::move(dir)},
-    batch_size_{batch_size}
+    batch_size_{batch_size},
+    max_indexers_{max_indexers},
+    indexer_policy_{indexer_policy}
 {
+  if (read_ahead_threads > 0)
+    read_ahead_ = std::make_shared<util::thread_pool>(read_ahead_threads);
 }
 
 char const* index_actor::description() const
@@ -494,7 +501,8 @@ trial<nothing> index_actor::make_partition(path const& dir)
 
   auto& a = part_actors_[id];
   if (! a)
-    a = spawn<partition_actor, monitored>(dir, batch_size_, id);
+    a = spawn<partition_actor, monitored>(dir, batch_size_, id, read_ahead_,
+                                          max_indexers_, indexer_policy_);
 
   return nil;
 }
@@ -1,16 +1,20 @@
 #ifndef VAST_INDEX_H
 #define VAST_INDEX_H
 
+#include <memory>
 #include "vast/actor.h"
 #include "vast/bitstream.h"
 #include "vast/file_system.h"
 #include "vast/optional.h"
 #include "vast/uuid.h"
 #include "vast/time.h"
+#include "vast/util/cache_policy.h"
 #include "vast/util/flat_set.h"
 
 namespace vast {
 
+namespace util { class thread_pool; }
+
 /// An inter-query predicate cache.
 class index
 {
@@ -112,7 +116,16 @@ struct index_actor : actor<index_actor>
   /// Spawns the index.
   /// @param dir The root directory of the index.
   /// @param batch_size The number of events to index at once.
-  index_actor(path dir, size_t batch_size);
+  /// @param read_ahead_threads The number of threads which decompress
+  /// segments ahead of the partitions indexing them. If 0, the partitions
+  /// decompress segments themselves.
+  /// @param max_indexers The maximum number of event data indexers each
+  /// partition keeps running, or 0 for no limit.
+  /// @param indexer_policy The replacement policy for the indexers of a
+  /// partition.
+  index_actor(path dir, size_t batch_size, size_t read_ahead_threads = 0,
+              size_t max_indexers = 0,
+              util::cache_policy indexer_policy = util::cache_policy::lru);
 
   trial<nothing> make_partition(path const& dir);
 
@@ -121,6 +134,9 @@ struct index_actor : actor<index_actor>
 
   path dir_;
   size_t batch_size_;
+  std::shared_ptr<util::thread_pool> read_ahead_;
+  size_t max_indexers_;
+  util::cache_policy indexer_policy_;
   std::map<expr::ast, query_state> queries_;
   std::unordered_map<uuid, cppa::actor_ptr> part_actors_;
   std::map<string, uuid> parts_;
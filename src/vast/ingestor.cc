@@ -1,8 +1,11 @@
 #include "vast/ingestor.h"
 
+#include <algorithm>
 #include "vast/segment.h"
 #include "vast/source/file.h"
+#include "vast/source/stream.h"
 #include "vast/io/serialization.h"
+#include "vast/util/thread_pool.h"
 
 #ifdef VAST_HAVE_BROCCOLI
 #include "vast/source/broccoli.h"
@@ -16,12 +19,34 @@ ingestor_actor::ingestor_actor(path dir,
                                actor_ptr receiver,
                                size_t max_events_per_chunk,
                                size_t max_segment_size,
-                               uint64_t batch_size)
+                               uint64_t batch_size,
+                               size_t parse_threads,
+                               uint64_t credit,
+                               size_t max_inflight_segments,
+                               size_t max_sources,
+                               size_t segmentizers,
+                               bool detach_sources,
+                               bool detach_segmentizers,
+                               segment::layout chunk_layout,
+                               io::compression method,
+                               io::compression_policy policy,
+                               size_t compression_threads)
   : dir_{std::move(dir)},
     receiver_{receiver},
     max_events_per_chunk_{max_events_per_chunk},
     max_segment_size_{max_segment_size},
-    batch_size_{batch_size}
+    batch_size_{batch_size},
+    parse_threads_{parse_threads},
+    credit_{credit},
+    max_inflight_segments_{max_inflight_segments},
+    max_sources_{max_sources > 0 ? max_sources : 1},
+    segmentizers_{segmentizers > 0 ? segmentizers : 1},
+    detach_sources_{detach_sources},
+    detach_segmentizers_{detach_segmentizers},
+    chunk_layout_{chunk_layout},
+    compression_{method},
+    compression_policy_{policy},
+    compression_threads_{compression_threads}
 {
 }
 
@@ -29,10 +54,28 @@ void ingestor_actor::act()
 {
   trap_exit(true);
 
-  // FIXME: figure out why detaching the segmentizer yields a two-fold
-  // performance increase in the ingestion rate.
-  sink_ = spawn<segmentizer, monitored>(
-      self, max_events_per_chunk_, max_segment_size_);
+  // Detaching the segmentizer can yield a two-fold increase in the ingestion
+  // rate, because compression then no longer competes with other actors for
+  // the cooperative scheduler. The segmentizers share one pool of threads
+  // for compression, so that the number of compressing threads does not grow
+  // with the number of segmentizers.
+  std::shared_ptr<util::thread_pool> pool;
+  if (compression_threads_ > 0)
+    pool = std::make_shared<util::thread_pool>(compression_threads_);
+
+  for (size_t i = 0; i < segmentizers_; ++i)
+    if (detach_segmentizers_)
+      sinks_.push_back(
+          spawn<segmentizer, detached + monitored>(
+              self, max_events_per_chunk_, max_segment_size_,
+              credit_, max_inflight_segments_, chunk_layout_,
+              compression_, compression_policy_, pool));
+    else
+      sinks_.push_back(
+          spawn<segmentizer, monitored>(
+              self, max_events_per_chunk_, max_segment_size_,
+              credit_, max_inflight_segments_, chunk_layout_,
+              compression_, compression_policy_, pool));
 
   auto segment_dir = dir_ / "ingest" / "segments";
   traverse(
@@ -90,23 +133,66 @@ void ingestor_actor::act()
       },
       on(atom("EXIT"), arg_match) >> [=](uint32_t reason)
       {
-        if (! source_)
+        files_.clear();
+        if (sources_.empty())
         {
           send(self, atom("shutdown"), reason);
-          send_exit(sink_, reason);
+          for (auto& sink : sinks_)
+            send_exit(sink, reason);
         }
         else
         {
-          // Tell the source to exit, it will in turn propagate the exit
-          // message to the sink.
-          send_exit(source_, exit::stop);
+          // Tell the sources to exit. Once all of them have terminated, we
+          // shut down the sinks.
+          for (auto& source : sources_)
+            send_exit(source, exit::stop);
         }
       },
       on(atom("DOWN"), arg_match) >> [=](uint32_t /* reason */)
       {
-        // Once we have received DOWN from the sink, the ingestor has nothing
+        if (sources_.erase(last_sender()) > 0)
+        {
+          ++ingested_files_;
+          if (! files_.empty())
+          {
+            spawn_source();
+          }
+          else if (sources_.empty())
+          {
+            VAST_LOG_ACTOR_INFO("finished ingesting " << ingested_files_ <<
+                                " file(s)");
+            for (auto& sink : sinks_)
+              send_exit(sink, exit::done);
+          }
+
+          return;
+        }
+
+        sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), last_sender()),
+                     sinks_.end());
+
+        // Once we have received DOWN from all sinks, the ingestor has nothing
         // else left todo and can shutdown.
-        delayed_send(self, std::chrono::seconds(5), atom("shutdown"), exit::done);
+        if (sinks_.empty())
+          delayed_send(self, std::chrono::seconds(5),
+                       atom("shutdown"), exit::done);
+      },
+      on(atom("statistics"), atom("parse"), arg_match) >> [=](uint64_t n)
+      {
+        parsed_[last_sender()] = n;
+      },
+      on(atom("statistics"), atom("segmentize"), arg_match)
+        >> [=](uint64_t events, uint64_t segments)
+      {
+        segmentized_[last_sender()] = {events, segments};
+      },
+      on(atom("report")) >> [=]
+      {
+        report();
+        if (sources_.empty() && sinks_.empty())
+          reporting_ = false;
+        else
+          delayed_send(self, std::chrono::seconds(1), atom("report"));
       },
       on(atom("submit")) >> [=]
       {
@@ -132,14 +218,64 @@ void ingestor_actor::act()
       },
 #endif
       on(atom("ingest"), "bro2", arg_match)
-        >> [=](std::string const& file, int32_t ts_field)
+        >> [=](std::string const& name, int32_t ts_field)
       {
-        VAST_LOG_ACTOR_INFO("ingests " << file);
+        timestamp_field_ = ts_field;
+
+        std::vector<path> files;
+        path p{name};
+        if (name != "-" && p.is_directory())
+          traverse(p, [&](path const& file) -> bool
+                   {
+                     if (file.is_regular_file())
+                       files.push_back(file);
+                     return true;
+                   });
+        else if (name.find_first_of("*?[") != std::string::npos)
+          files = glob(name);
+        else
+          files.push_back(std::move(p));
+
+        if (files.empty())
+        {
+          VAST_LOG_ACTOR_ERROR("found no files to ingest in " << name);
+          return;
+        }
+
+        // We keep the pending files sorted by size and hand out the largest
+        // first, so that the small ones fill the gaps at the end.
+        for (auto& file : files)
+        {
+          auto size = file_size(file);
+          files_.emplace_back(std::move(file), size ? *size : 0);
+        }
+
+        std::sort(files_.begin(), files_.end(),
+                  [](std::pair<path, uint64_t> const& x,
+                     std::pair<path, uint64_t> const& y)
+                  {
+                    return x.second < y.second;
+                  });
+
+        VAST_LOG_ACTOR_INFO("ingests " << files.size() << " file(s) with " <<
+                            std::min(max_sources_, files_.size()) <<
+                            " concurrent source(s)");
 
-        source_ = spawn<source::bro2, detached>(sink_, file, ts_field);
-        source_->link_to(sink_);
-        send(source_, atom("batch size"), batch_size_);
-        send(source_, atom("run"));
+        while (sources_.size() < max_sources_ && ! files_.empty())
+          spawn_source();
+
+        start_reporting();
+      },
+      on(atom("ingest"), atom("listen"), arg_match)
+        >> [=](std::string const& endpoint, int32_t ts_field)
+      {
+        // The source blocks in poll(), so it always gets its own thread.
+        auto& sink = sinks_[next_sink_++ % sinks_.size()];
+        auto source = spawn<source::bro2_stream, detached>(
+            sink, endpoint, ts_field);
+
+        attach_source(source, sink);
+        start_reporting();
       },
       on(atom("ingest"), val<std::string>, arg_match) >> [=](std::string const&)
       {
@@ -150,6 +286,8 @@ void ingestor_actor::act()
         VAST_LOG_ACTOR_DEBUG(
             "relays segment " << s.id() << " to " << VAST_ACTOR_ID(receiver_));
 
+        ++relayed_segments_;
+        relayed_events_ += s.events();
         auto cs = cow<segment>{std::move(s)};
         segments_[cs->id()] = cs;
         receiver_ << cs;
@@ -160,6 +298,8 @@ void ingestor_actor::act()
         auto i = segments_.find(id);
         assert(i != segments_.end());
         segments_.erase(i);
+        for (auto& sink : sinks_)
+          send(sink, atom("ack"), id);
 
         auto j = orphaned_.find(path{to<string>(id)});
         if (j != orphaned_.end())
@@ -176,6 +316,90 @@ void ingestor_actor::act()
       });
 }
 
+void ingestor_actor::spawn_source()
+{
+  assert(! files_.empty());
+  auto file = std::move(files_.back().first);
+  files_.pop_back();
+
+  VAST_LOG_ACTOR_INFO("ingests " << file);
+
+  auto& sink = sinks_[next_sink_++ % sinks_.size()];
+  auto source = detach_sources_
+    ? spawn<source::bro2, detached>(
+          sink, to_string(file), timestamp_field_, parse_threads_)
+    : spawn<source::bro2>(
+          sink, to_string(file), timestamp_field_, parse_threads_);
+
+  attach_source(source, sink);
+}
+
+void ingestor_actor::attach_source(actor_ptr const& source,
+                                   actor_ptr const& sink)
+{
+  monitor(source);
+  sources_.insert(source);
+  send(sink, atom("source"), source);
+  send(source, atom("statistics"), self);
+  send(source, atom("batch size"), batch_size_);
+  send(source, atom("run"));
+}
+
+void ingestor_actor::start_reporting()
+{
+  if (reporting_)
+    return;
+
+  reporting_ = true;
+  last_report_ = std::chrono::steady_clock::now();
+  delayed_send(self, std::chrono::seconds(1), atom("report"));
+}
+
+void ingestor_actor::report()
+{
+  auto now = std::chrono::steady_clock::now();
+  auto secs = std::chrono::duration<double>(now - last_report_).count();
+  if (secs <= 0)
+    return;
+
+  uint64_t parsed = 0;
+  for (auto& p : parsed_)
+    parsed += p.second;
+
+  uint64_t segmentized = 0;
+  uint64_t segments = 0;
+  for (auto& p : segmentized_)
+  {
+    segmentized += p.second.first;
+    segments += p.second.second;
+  }
+
+  // The queue depth of a stage is the number of items the previous stage has
+  // sent to it but which it has not yet processed.
+  VAST_LOG_ACTOR_VERBOSE(
+      "parse stage: " <<
+      static_cast<uint64_t>((parsed - last_parsed_) / secs) <<
+      " events/sec with " << sources_.size() << " source(s)");
+
+  VAST_LOG_ACTOR_VERBOSE(
+      "segmentize stage: " <<
+      static_cast<uint64_t>((segmentized - last_segmentized_) / secs) <<
+      " events/sec, queue depth " <<
+      (parsed > segmentized ? parsed - segmentized : 0) << " events");
+
+  VAST_LOG_ACTOR_VERBOSE(
+      "ship stage: " <<
+      static_cast<uint64_t>((relayed_events_ - last_relayed_) / secs) <<
+      " events/sec, queue depth " <<
+      (segments > relayed_segments_ ? segments - relayed_segments_ : 0) <<
+      " segments, " << segments_.size() << " segments awaiting ACK");
+
+  last_report_ = now;
+  last_parsed_ = parsed;
+  last_segmentized_ = segmentized;
+  last_relayed_ = relayed_events_;
+}
+
 char const* ingestor_actor::description() const
 {
   return "ingestor";
@@ -1,7 +1,11 @@
 #ifndef VAST_INGESTOR_H
 #define VAST_INGESTOR_H
 
+#include <chrono>
+#include <map>
+#include <set>
 #include <unordered_map>
+#include <vector>
 #include <cppa/cppa.hpp>
 #include "vast/actor.h"
 #include "vast/file_system.h"
@@ -12,6 +16,18 @@ namespace vast {
 
 /// The ingestor. This component manages different types of event sources, each
 /// of which generate events in a different manner.
+///
+/// Besides files, the ingestor can accept Bro logs streamed over TCP or Unix
+/// domain socket connections with a source::bro2_stream.
+///
+/// When ingesting a directory or a glob pattern, the ingestor runs a pool of
+/// concurrent sources over the matching files, starting with the largest
+/// ones, and distributes the sources round-robin over its segmentizers.
+///
+/// The ingest pipeline consists of three stages: parsing (the sources),
+/// segmentizing (the segmentizers), and shipping segments to the receiver
+/// (the ingestor itself). While ingesting, the ingestor logs the throughput
+/// and queue depth of each stage once per second.
 class ingestor_actor : public actor<ingestor_actor>
 {
 public:
@@ -27,23 +43,102 @@ public:
   ///
   /// @param batch_size The number of events a synchronous source buffers until
   /// relaying them to the segmentizer
+  ///
+  /// @param parse_threads The number of threads a file source parses with.
+  ///
+  /// @param credit The number of events a source may send ahead of the
+  /// segmentizer.
+  ///
+  /// @param max_inflight_segments The maximum number of un-acked segments
+  /// before sources have to wait.
+  ///
+  /// @param max_sources The maximum number of files to ingest concurrently.
+  ///
+  /// @param segmentizers The number of segmentizers the sources feed.
+  ///
+  /// @param detach_sources Whether to run each source in its own thread as
+  /// opposed to the cooperative scheduler.
+  ///
+  /// @param detach_segmentizers Whether to run each segmentizer in its own
+  /// thread as opposed to the cooperative scheduler.
+  ///
+  /// @param chunk_layout The layout of the chunks the segmentizers write.
+  ///
+  /// @param method The compression method of the chunks.
+  ///
+  /// @param policy The objective by which to select the compression method
+  /// of each chunk if *method* is io::automatic.
+  ///
+  /// @param compression_threads The number of threads which compress the
+  /// chunks of all segmentizers. If 0, each segmentizer compresses its
+  /// chunks itself.
   ingestor_actor(path dir,
                  cppa::actor_ptr receiver,
                  size_t max_events_per_chunk,
                  size_t max_segment_size,
-                 uint64_t batch_size);
+                 uint64_t batch_size,
+                 size_t parse_threads = 1,
+                 uint64_t credit = 0,
+                 size_t max_inflight_segments = 0,
+                 size_t max_sources = 1,
+                 size_t segmentizers = 1,
+                 bool detach_sources = true,
+                 bool detach_segmentizers = false,
+                 segment::layout chunk_layout = segment::row,
+                 io::compression method = io::lz4,
+                 io::compression_policy policy = io::balanced,
+                 size_t compression_threads = 0);
 
   void act();
   char const* description() const;
 
 private:
+  // Spawns a source for the largest pending file.
+  void spawn_source();
+
+  // Connects a freshly spawned source to its sink and starts it.
+  void attach_source(cppa::actor_ptr const& source,
+                     cppa::actor_ptr const& sink);
+
+  // Starts logging the pipeline statistics once per second.
+  void start_reporting();
+
+  // Logs throughput and queue depth of each pipeline stage.
+  void report();
+
   path dir_;
   cppa::actor_ptr receiver_;
-  cppa::actor_ptr source_;
-  cppa::actor_ptr sink_;
+  std::set<cppa::actor_ptr> sources_;
+  std::vector<cppa::actor_ptr> sinks_;
+  std::vector<std::pair<path, uint64_t>> files_;
+  int32_t timestamp_field_ = -1;
+  size_t next_sink_ = 0;
+  size_t ingested_files_ = 0;
   size_t max_events_per_chunk_;
   size_t max_segment_size_;
   uint64_t batch_size_;
+  size_t parse_threads_;
+  uint64_t credit_;
+  size_t max_inflight_segments_;
+  size_t max_sources_;
+  size_t segmentizers_;
+  bool detach_sources_;
+  bool detach_segmentizers_;
+  segment::layout chunk_layout_;
+  io::compression compression_;
+  io::compression_policy compression_policy_;
+  size_t compression_threads_;
+
+  // Cumulative counters of the pipeline stages.
+  std::map<cppa::actor_ptr, uint64_t> parsed_;
+  std::map<cppa::actor_ptr, std::pair<uint64_t, uint64_t>> segmentized_;
+  uint64_t relayed_events_ = 0;
+  uint64_t relayed_segments_ = 0;
+  bool reporting_ = false;
+  std::chrono::steady_clock::time_point last_report_;
+  uint64_t last_parsed_ = 0;
+  uint64_t last_segmentized_ = 0;
+  uint64_t last_relayed_ = 0;
   std::map<uuid, cow<segment>> segments_;
   std::set<path> orphaned_;
 };
@@ -7,6 +7,10 @@
 #ifdef VAST_HAVE_SNAPPY
 #include <snappy.h>
 #endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif // VAST_HAVE_ZSTD
 
 namespace vast {
 namespace io {
@@ -112,6 +116,10 @@ compressed_input_stream* make_compressed_input_stream(
     case snappy:
       return new snappy_input_stream(source);
 #endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+    case zstd:
+      return new zstd_input_stream(source);
+#endif // VAST_HAVE_ZSTD
   }
 }
 
@@ -192,8 +200,13 @@ compressed_output_stream::compressed_output_stream(
 }
 
 compressed_output_stream* make_compressed_output_stream(
-    compression method, output_stream& sink)
+    compression method, output_stream& sink, uint32_t dictionary)
 {
+#ifndef VAST_HAVE_ZSTD
+  // Only zstd streams use a dictionary.
+  static_cast<void>(dictionary);
+#endif
+
   switch (method)
   {
     default:
@@ -206,6 +219,10 @@ compressed_output_stream* make_compressed_output_stream(
     case snappy:
       return new snappy_output_stream(sink);
 #endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+    case zstd:
+      return new zstd_output_stream(sink, 0, dictionary);
+#endif // VAST_HAVE_ZSTD
   }
 }
 
@@ -354,5 +371,221 @@ size_t compress(void* sink, size_t sink_size)
 }
 #endif // VAST_HAVE_SNAPPY
 
+#ifdef VAST_HAVE_ZSTD
+trial<std::vector<uint8_t>> zstd_registry::train(
+    std::vector<std::vector<uint8_t>> const& samples, size_t max_size)
+{
+  // ZDICT expects all samples in one contiguous buffer.
+  std::vector<uint8_t> buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (auto& sample : samples)
+  {
+    buffer.insert(buffer.end(), sample.begin(), sample.end());
+    sizes.push_back(sample.size());
+  }
+
+  std::vector<uint8_t> dict(max_size);
+  auto n = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(),
+                                 sizes.data(), sizes.size());
+  if (ZDICT_isError(n))
+    return error{std::string{"failed to train zstd dictionary: "} +
+                 ZDICT_getErrorName(n)};
+
+  dict.resize(n);
+  return std::move(dict);
+}
+
+void zstd_registry::level(int level)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  level_ = level;
+}
+
+int zstd_registry::level() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return level_;
+}
+
+trial<uint32_t> zstd_registry::add(std::vector<uint8_t> dict)
+{
+  auto id = ZDICT_getDictID(dict.data(), dict.size());
+  if (id == 0)
+    return error{"invalid zstd dictionary"};
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& e = dictionaries_[id];
+  if (e.bytes.empty())
+    e.bytes = std::move(dict);
+
+  return id;
+}
+
+std::vector<uint8_t> const* zstd_registry::find(uint32_t id) const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = dictionaries_.find(id);
+  return i == dictionaries_.end() ? nullptr : &i->second.bytes;
+}
+
+void zstd_registry::assign(std::string const& key, uint32_t id)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  assert(dictionaries_.count(id) > 0);
+  keys_[key] = id;
+}
+
+uint32_t zstd_registry::lookup(std::string const& key) const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = keys_.find(key);
+  return i == keys_.end() ? 0 : i->second;
+}
+
+zstd_registry* zstd_registry::create()
+{
+  return new zstd_registry;
+}
+
+void zstd_registry::initialize()
+{
+  level_ = ZSTD_CLEVEL_DEFAULT;
+}
+
+void zstd_registry::destroy()
+{
+  for (auto& p : dictionaries_)
+  {
+    for (auto& c : p.second.compression)
+      ZSTD_freeCDict(c.second);
+
+    ZSTD_freeDDict(p.second.decompression);
+  }
+
+  delete this;
+}
+
+void zstd_registry::dispose()
+{
+  delete this;
+}
+
+ZSTD_CDict const* zstd_registry::compression_dictionary(uint32_t id,
+                                                        int level)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = dictionaries_.find(id);
+  if (i == dictionaries_.end())
+    return nullptr;
+
+  auto& cdict = i->second.compression[level];
+  if (cdict == nullptr)
+    cdict = ZSTD_createCDict(i->second.bytes.data(), i->second.bytes.size(),
+                             level);
+
+  return cdict;
+}
+
+ZSTD_DDict const* zstd_registry::decompression_dictionary(uint32_t id)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto i = dictionaries_.find(id);
+  if (i == dictionaries_.end())
+    return nullptr;
+
+  auto& ddict = i->second.decompression;
+  if (ddict == nullptr)
+    ddict = ZSTD_createDDict(i->second.bytes.data(), i->second.bytes.size());
+
+  return ddict;
+}
+
+zstd_input_stream::zstd_input_stream(input_stream& source)
+  : compressed_input_stream(source),
+    context_(ZSTD_createDCtx())
+{
+}
+
+zstd_input_stream::~zstd_input_stream()
+{
+  ZSTD_freeDCtx(context_);
+}
+
+size_t zstd_input_stream::uncompress(void const* source, size_t size)
+{
+  VAST_ENTER(VAST_ARG(source, size));
+  size_t n;
+  auto id = ZSTD_getDictID_fromFrame(source, size);
+  if (id == 0)
+  {
+    n = ZSTD_decompressDCtx(context_, uncompressed_.data(),
+                            uncompressed_.size(), source, size);
+  }
+  else
+  {
+    auto ddict = zstd_registry::instance()->decompression_dictionary(id);
+    if (ddict == nullptr)
+    {
+      VAST_LOG_ERROR("missing zstd dictionary " << id);
+      VAST_RETURN(0);
+    }
+
+    n = ZSTD_decompress_usingDDict(context_, uncompressed_.data(),
+                                   uncompressed_.size(), source, size, ddict);
+  }
+
+  if (ZSTD_isError(n))
+  {
+    VAST_LOG_ERROR("failed to decompress zstd block: " <<
+                   ZSTD_getErrorName(n));
+    VAST_RETURN(0);
+  }
+
+  VAST_RETURN(n);
+}
+
+zstd_output_stream::zstd_output_stream(output_stream& sink, int level,
+                                       uint32_t dictionary)
+  : compressed_output_stream(sink),
+    context_(ZSTD_createCCtx()),
+    level_(level != 0 ? level : zstd_registry::instance()->level())
+{
+  if (dictionary != 0)
+  {
+    dictionary_ = zstd_registry::instance()->compression_dictionary(
+        dictionary, level_);
+    if (dictionary_ == nullptr)
+      VAST_LOG_WARN("ignores unknown zstd dictionary " << dictionary);
+  }
+
+  ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level_);
+  if (dictionary_ != nullptr)
+    ZSTD_CCtx_refCDict(context_, dictionary_);
+}
+
+zstd_output_stream::~zstd_output_stream()
+{
+  flush();
+  ZSTD_freeCCtx(context_);
+}
+
+size_t zstd_output_stream::compressed_size(size_t output) const
+{
+  VAST_ENTER(VAST_ARG(output));
+  auto result = ZSTD_compressBound(output);
+  VAST_RETURN(result);
+}
+
+size_t zstd_output_stream::compress(void* sink, size_t sink_size)
+{
+  VAST_ENTER(VAST_ARG(sink, sink_size));
+  auto n = ZSTD_compress2(context_, sink, sink_size,
+                          uncompressed_.data(), valid_bytes_);
+  assert(! ZSTD_isError(n));
+  VAST_RETURN(n);
+}
+#endif // VAST_HAVE_ZSTD
+
 } // namespace io
 } // namespace vast
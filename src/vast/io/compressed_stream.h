@@ -6,6 +6,20 @@
 #include "vast/io/coded_stream.h"
 #include "vast/io/compression.h"
 
+#ifdef VAST_HAVE_ZSTD
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "vast/singleton.h"
+#include "vast/util/trial.h"
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+#endif // VAST_HAVE_ZSTD
+
 namespace vast {
 namespace io {
 
@@ -95,10 +109,15 @@ private:
 
 /// Factory function to create a ::compressed_output_stream for a given
 /// compression method.
+///
 /// @param method The compression method to use.
+///
 /// @param sink The underlying stream to write into.
+///
+/// @param dictionary The ID of a registered zstd dictionary, or 0 for none.
+/// Methods other than zstd ignore it.
 compressed_output_stream* make_compressed_output_stream(
-    compression method, output_stream& sink);
+    compression method, output_stream& sink, uint32_t dictionary = 0);
 
 
 /// A compressed input stream that uses null compression.
@@ -159,6 +178,123 @@ public:
 };
 #endif // VAST_HAVE_SNAPPY
 
+#ifdef VAST_HAVE_ZSTD
+/// Holds the compression level and the dictionaries of all zstd streams in
+/// this process. A zstd frame records the ID of the dictionary it was
+/// compressed with, so that input streams find the dictionary here. Since
+/// chunks are small, dictionaries trained on samples of similar data, e.g.,
+/// events of the same type, improve the compression ratio considerably.
+class zstd_registry : public singleton<zstd_registry>
+{
+  friend singleton<zstd_registry>;
+
+public:
+  /// Trains a dictionary.
+  ///
+  /// @param samples The samples to train on. They should amount to about 100
+  /// times the size of the dictionary.
+  ///
+  /// @param max_size The maximum size of the dictionary in bytes.
+  ///
+  /// @returns The dictionary.
+  static trial<std::vector<uint8_t>> train(
+      std::vector<std::vector<uint8_t>> const& samples,
+      size_t max_size = 16 << 10);
+
+  /// Sets the compression level of new output streams.
+  /// @param level The zstd compression level.
+  void level(int level);
+
+  /// Retrieves the compression level of new output streams.
+  /// @returns The zstd compression level.
+  int level() const;
+
+  /// Registers a dictionary.
+  /// @param dict The dictionary as returned from ::train.
+  /// @returns The ID of *dict*.
+  trial<uint32_t> add(std::vector<uint8_t> dict);
+
+  /// Retrieves a dictionary.
+  /// @param id The ID of the dictionary.
+  /// @returns The dictionary with ID *id* or `nullptr` if it does not exist.
+  std::vector<uint8_t> const* find(uint32_t id) const;
+
+  /// Associates a dictionary with a key, e.g., the name of an event type.
+  /// @param key The key.
+  /// @param id The ID of a registered dictionary.
+  void assign(std::string const& key, uint32_t id);
+
+  /// Retrieves the dictionary associated with a key.
+  /// @param key The key.
+  /// @returns The ID of the dictionary for *key* or 0 if none exists.
+  uint32_t lookup(std::string const& key) const;
+
+private:
+  friend class zstd_input_stream;
+  friend class zstd_output_stream;
+
+  struct entry
+  {
+    std::vector<uint8_t> bytes;
+    std::map<int, ZSTD_CDict_s*> compression;
+    ZSTD_DDict_s* decompression = nullptr;
+  };
+
+  // Singleton implementation.
+  static zstd_registry* create();
+  void initialize();
+  void destroy();
+  void dispose();
+
+  // Retrieves the digested form of a dictionary, which we create once per
+  // level and reuse for all streams.
+  ZSTD_CDict_s const* compression_dictionary(uint32_t id, int level);
+  ZSTD_DDict_s const* decompression_dictionary(uint32_t id);
+
+  mutable std::mutex mutex_;
+  int level_;
+  std::unordered_map<uint32_t, entry> dictionaries_;
+  std::unordered_map<std::string, uint32_t> keys_;
+};
+
+/// A compressed input stream using zstd.
+class zstd_input_stream : public compressed_input_stream
+{
+public:
+  zstd_input_stream(input_stream& source);
+  virtual ~zstd_input_stream();
+  virtual size_t uncompress(void const* source, size_t size) override;
+
+private:
+  ZSTD_DCtx_s* context_;
+};
+
+/// A compressed output stream using zstd.
+class zstd_output_stream : public compressed_output_stream
+{
+public:
+  /// Constructs a zstd output stream.
+  ///
+  /// @param sink The output stream to write to.
+  ///
+  /// @param level The compression level, or 0 for the level of the
+  /// ::zstd_registry.
+  ///
+  /// @param dictionary The ID of a registered dictionary, or 0 for none.
+  zstd_output_stream(output_stream& sink, int level = 0,
+                     uint32_t dictionary = 0);
+
+  virtual ~zstd_output_stream();
+  virtual size_t compressed_size(size_t output) const override;
+  virtual size_t compress(void* sink, size_t sink_size) override;
+
+private:
+  ZSTD_CCtx_s* context_;
+  int level_;
+  ZSTD_CDict_s const* dictionary_ = nullptr;
+};
+#endif // VAST_HAVE_ZSTD
+
 } // namespace io
 } // namespace vast
 
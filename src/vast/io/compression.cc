@@ -1,10 +1,119 @@
 #include "vast/io/compression.h"
 
+#include <algorithm>
+#include <chrono>
 #include "vast/serialization.h"
+#include "vast/io/compressed_stream.h"
+#include "vast/io/container_stream.h"
 
 namespace vast {
 namespace io {
 
+namespace {
+
+// The size of a sample and the maximum number of samples to estimate the
+// compression ratio and speed from. Together they fit into a single block.
+size_t const sample_size = 16 << 10;
+size_t const max_samples = 4;
+
+// The fraction of bytes a method must save to be worth its cost.
+double const min_savings = 0.1;
+
+struct estimate
+{
+  compression method;
+  size_t bytes;
+  double seconds;
+};
+
+} // namespace <anonymous>
+
+compression select(void const* data, size_t size, compression_policy policy)
+{
+  if (size == 0)
+    return null;
+
+  // We take evenly spaced samples to see the beginning as well as the end of
+  // the data.
+  auto bytes = reinterpret_cast<uint8_t const*>(data);
+  std::vector<std::pair<size_t, size_t>> samples;
+  if (size <= sample_size * max_samples)
+    samples.emplace_back(0, size);
+  else
+    for (size_t i = 0; i < max_samples; ++i)
+      samples.emplace_back(i * (size - sample_size) / (max_samples - 1),
+                           sample_size);
+
+  size_t sampled = 0;
+  for (auto& s : samples)
+    sampled += s.second;
+
+  std::vector<compression> methods{lz4};
+#ifdef VAST_HAVE_SNAPPY
+  methods.push_back(snappy);
+#endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+  methods.push_back(zstd);
+#endif // VAST_HAVE_ZSTD
+
+  std::vector<estimate> estimates;
+  std::vector<uint8_t> buf;
+  buf.reserve(sampled);
+  for (auto method : methods)
+  {
+    buf.clear();
+    auto start = std::chrono::steady_clock::now();
+    {
+      container_output_stream<std::vector<uint8_t>> sink{buf};
+      std::unique_ptr<compressed_output_stream> out{
+        make_compressed_output_stream(method, sink)};
+      coded_output_stream coded{*out};
+      for (auto& s : samples)
+        coded.write_raw(bytes + s.first, s.second);
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    if (buf.size() <= sampled * (1.0 - min_savings))
+      estimates.push_back(
+          {method, buf.size(),
+           std::chrono::duration<double>(stop - start).count()});
+  }
+
+  if (estimates.empty())
+    return null;
+
+  auto faster = [](estimate const& x, estimate const& y)
+  {
+    return x.seconds < y.seconds;
+  };
+
+  auto smaller = [](estimate const& x, estimate const& y)
+  {
+    return x.bytes < y.bytes;
+  };
+
+  auto quickest = std::min_element(estimates.begin(), estimates.end(), faster);
+  switch (policy)
+  {
+    default:
+    case fastest:
+      return quickest->method;
+    case smallest:
+      return std::min_element(estimates.begin(), estimates.end(),
+                              smaller)->method;
+    case balanced:
+      {
+        auto limit = 2 * quickest->seconds;
+        auto best = *quickest;
+        for (auto& e : estimates)
+          if (e.seconds <= limit && e.bytes < best.bytes)
+            best = e;
+
+        return best.method;
+      }
+  }
+}
+
 void serialize(serializer& sink, compression method)
 {
   sink << static_cast<std::underlying_type<compression>::type>(method);
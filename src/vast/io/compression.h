@@ -7,16 +7,44 @@
 namespace vast {
 namespace io {
 
+/// A compression method. With `automatic`, writers select one of the other
+/// methods per block of data according to a ::compression_policy, and
+/// record the selected method.
 enum compression : uint8_t
 {
   null      = 0,
-  automatic = 1,  // TODO: implement automatic detection of the compression format.
+  automatic = 1,
   lz4       = 2,
 #ifdef VAST_HAVE_SNAPPY
   snappy    = 3,
 #endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+  zstd      = 4,
+#endif // VAST_HAVE_ZSTD
 };
 
+/// The objective by which ::automatic selects a compression method.
+enum compression_policy : uint8_t
+{
+  fastest,    ///< The method with the highest compression throughput.
+  smallest,   ///< The method with the smallest output.
+  balanced    ///< The smallest output among the methods at least half as
+              ///< fast as the fastest.
+};
+
+/// Selects a compression method for a block of data by compressing samples
+/// of it with each available method. If no method saves at least 10%, the
+/// selection falls back to ::null.
+///
+/// @param data The data to compress.
+///
+/// @param size The number of bytes of *data*.
+///
+/// @param policy The objective of the selection.
+///
+/// @returns The compression method for *data*, never ::automatic.
+compression select(void const* data, size_t size, compression_policy policy);
+
 void serialize(serializer& sink, compression method);
 void deserialize(deserializer& source, compression& method);
 
@@ -0,0 +1,686 @@
+#include "vast/io/decompressor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "vast/file_system.h"
+#include "vast/util/make_unique.h"
+#include "lz4/lz4.h"
+
+#ifdef VAST_HAVE_ZLIB
+#  include <zlib.h>
+#endif // VAST_HAVE_ZLIB
+
+#ifdef VAST_HAVE_BZIP2
+#  include <bzlib.h>
+#endif // VAST_HAVE_BZIP2
+
+namespace vast {
+namespace io {
+
+namespace {
+
+uint32_t const lz4_magic = 0x184d2204;
+uint32_t const lz4_legacy_magic = 0x184c2102;
+uint32_t const lz4_skippable_magic = 0x184d2a50;
+
+// The number of compressed bytes a decoder reads at once.
+size_t const input_block_size = 256 << 10;
+
+uint32_t load_le32(char const* p)
+{
+  auto b = reinterpret_cast<uint8_t const*>(p);
+  return b[0] | (b[1] << 8) | (b[2] << 16) | (uint32_t(b[3]) << 24);
+}
+
+} // namespace <anonymous>
+
+file_compression detect_compression(void const* data, size_t size)
+{
+  auto p = static_cast<char const*>(data);
+  auto b = static_cast<uint8_t const*>(data);
+  if (size >= 2 && b[0] == 0x1f && b[1] == 0x8b)
+    return file_compression::gzip;
+
+  if (size >= 4 && std::memcmp(p, "BZh", 3) == 0 && p[3] >= '1' && p[3] <= '9')
+    return file_compression::bzip2;
+
+  if (size >= 4)
+  {
+    auto magic = load_le32(p);
+    if (magic == lz4_magic || magic == lz4_legacy_magic)
+      return file_compression::lz4;
+  }
+
+  return file_compression::none;
+}
+
+bool supports(file_compression format)
+{
+  switch (format)
+  {
+    default:
+      return true;
+    case file_compression::gzip:
+#ifdef VAST_HAVE_ZLIB
+      return true;
+#else
+      return false;
+#endif // VAST_HAVE_ZLIB
+    case file_compression::bzip2:
+#ifdef VAST_HAVE_BZIP2
+      return true;
+#else
+      return false;
+#endif // VAST_HAVE_BZIP2
+  }
+}
+
+class decompressor::decoder
+{
+public:
+  decoder(file& f, std::vector<char> prefix)
+    : file_{f},
+      in_{std::move(prefix)},
+      in_last_{in_.size()}
+  {
+  }
+
+  virtual ~decoder() = default;
+
+  /// Decompresses the next chunk of data.
+  ///
+  /// @param sink The buffer to decompress into.
+  ///
+  /// @param size The number of bytes *sink* can hold.
+  ///
+  /// @param got A result parameter that contains the number of bytes written
+  /// into *sink*, which is 0 at the end of the compressed stream.
+  ///
+  /// @returns `false` on failure, in which case ::failure describes the
+  /// error.
+  virtual bool decode(char* sink, size_t size, size_t* got) = 0;
+
+  error failure;
+
+protected:
+  size_t available() const
+  {
+    return in_last_ - in_first_;
+  }
+
+  char* input()
+  {
+    return in_.data() + in_first_;
+  }
+
+  void consume(size_t n)
+  {
+    assert(n <= available());
+    in_first_ += n;
+  }
+
+  // Makes at least *n* bytes of compressed input available.
+  bool ensure(size_t n)
+  {
+    if (available() >= n)
+      return true;
+
+    if (eof_)
+      return false;
+
+    auto remaining = available();
+    if (remaining > 0 && in_first_ > 0)
+      std::memmove(in_.data(), input(), remaining);
+
+    in_first_ = 0;
+    in_last_ = remaining;
+    if (in_.size() < std::max(n, input_block_size))
+      in_.resize(std::max(n, input_block_size));
+
+    while (in_last_ < n)
+    {
+      size_t got = 0;
+      if (! file_.read(in_.data() + in_last_, in_.size() - in_last_, &got)
+          || got == 0)
+      {
+        eof_ = true;
+        return false;
+      }
+
+      in_last_ += got;
+    }
+
+    return true;
+  }
+
+private:
+  file& file_;
+  std::vector<char> in_;
+  size_t in_first_ = 0;
+  size_t in_last_ = 0;
+  bool eof_ = false;
+};
+
+namespace {
+
+#ifdef VAST_HAVE_ZLIB
+class gzip_decoder : public decompressor::decoder
+{
+public:
+  gzip_decoder(file& f, std::vector<char> prefix)
+    : decoder{f, std::move(prefix)}
+  {
+    std::memset(&zs_, 0, sizeof(zs_));
+    // Let zlib parse the gzip header.
+    if (inflateInit2(&zs_, 15 + 32) != Z_OK)
+      failure = error{"failed to initialize zlib"};
+  }
+
+  ~gzip_decoder()
+  {
+    inflateEnd(&zs_);
+  }
+
+  virtual bool decode(char* sink, size_t size, size_t* got) override
+  {
+    *got = 0;
+    if (! failure.msg().empty())
+      return false;
+
+    zs_.next_out = reinterpret_cast<Bytef*>(sink);
+    zs_.avail_out = static_cast<uInt>(size);
+    while (zs_.avail_out > 0)
+    {
+      if (available() == 0 && ! ensure(1))
+      {
+        if (! member_end_)
+          failure = error{"truncated gzip stream"};
+        break;
+      }
+
+      // A file may consist of several concatenated gzip members.
+      if (member_end_)
+      {
+        inflateReset(&zs_);
+        member_end_ = false;
+      }
+
+      zs_.next_in = reinterpret_cast<Bytef*>(input());
+      zs_.avail_in = static_cast<uInt>(available());
+      auto r = inflate(&zs_, Z_NO_FLUSH);
+      consume(available() - zs_.avail_in);
+      if (r == Z_STREAM_END)
+      {
+        member_end_ = true;
+      }
+      else if (r != Z_OK && r != Z_BUF_ERROR)
+      {
+        failure = error{std::string{"gzip: "} +
+                        (zs_.msg ? zs_.msg : "corrupt stream")};
+        break;
+      }
+    }
+
+    *got = size - zs_.avail_out;
+    return failure.msg().empty();
+  }
+
+private:
+  z_stream zs_;
+  bool member_end_ = false;
+};
+#endif // VAST_HAVE_ZLIB
+
+#ifdef VAST_HAVE_BZIP2
+class bzip2_decoder : public decompressor::decoder
+{
+public:
+  bzip2_decoder(file& f, std::vector<char> prefix)
+    : decoder{f, std::move(prefix)}
+  {
+    std::memset(&bz_, 0, sizeof(bz_));
+    if (BZ2_bzDecompressInit(&bz_, 0, 0) != BZ_OK)
+      failure = error{"failed to initialize bzip2"};
+  }
+
+  ~bzip2_decoder()
+  {
+    BZ2_bzDecompressEnd(&bz_);
+  }
+
+  virtual bool decode(char* sink, size_t size, size_t* got) override
+  {
+    *got = 0;
+    if (! failure.msg().empty())
+      return false;
+
+    bz_.next_out = sink;
+    bz_.avail_out = static_cast<unsigned>(size);
+    while (bz_.avail_out > 0)
+    {
+      if (available() == 0 && ! ensure(1))
+      {
+        if (! stream_end_)
+          failure = error{"truncated bzip2 stream"};
+        break;
+      }
+
+      // Like pbzip2 output, a file may consist of several bzip2 streams.
+      if (stream_end_)
+      {
+        BZ2_bzDecompressEnd(&bz_);
+        std::memset(&bz_, 0, sizeof(bz_));
+        if (BZ2_bzDecompressInit(&bz_, 0, 0) != BZ_OK)
+        {
+          failure = error{"failed to initialize bzip2"};
+          break;
+        }
+
+        bz_.next_out = sink + *got;
+        bz_.avail_out = static_cast<unsigned>(size - *got);
+        stream_end_ = false;
+      }
+
+      bz_.next_in = input();
+      bz_.avail_in = static_cast<unsigned>(available());
+      auto before = bz_.avail_out;
+      auto r = BZ2_bzDecompress(&bz_);
+      consume(available() - bz_.avail_in);
+      *got += before - bz_.avail_out;
+      if (r == BZ_STREAM_END)
+      {
+        stream_end_ = true;
+      }
+      else if (r != BZ_OK)
+      {
+        failure = error{"bzip2: corrupt stream"};
+        break;
+      }
+    }
+
+    return failure.msg().empty();
+  }
+
+private:
+  bz_stream bz_;
+  bool stream_end_ = false;
+};
+#endif // VAST_HAVE_BZIP2
+
+// Decodes the LZ4 frame format and the legacy format of older lz4 versions.
+class lz4_decoder : public decompressor::decoder
+{
+public:
+  lz4_decoder(file& f, std::vector<char> prefix)
+    : decoder{f, std::move(prefix)}
+  {
+  }
+
+  virtual bool decode(char* sink, size_t size, size_t* got) override
+  {
+    *got = 0;
+    while (*got < size)
+    {
+      if (block_first_ == block_last_ && ! next_block())
+        break;
+
+      auto n = std::min(size - *got,
+                        static_cast<size_t>(block_last_ - block_first_));
+      std::memcpy(sink + *got, block_first_, n);
+      block_first_ += n;
+      *got += n;
+    }
+
+    return failure.msg().empty();
+  }
+
+private:
+  enum state
+  {
+    magic,
+    frame,
+    legacy
+  };
+
+  // Linked blocks may refer to the previous 64 KB of output.
+  static size_t const history_size = 64 << 10;
+
+  bool truncated()
+  {
+    failure = error{"truncated lz4 stream"};
+    return false;
+  }
+
+  bool corrupt()
+  {
+    failure = error{"lz4: corrupt stream"};
+    return false;
+  }
+
+  void resize(size_t block_max)
+  {
+    block_max_ = block_max;
+    if (out_.size() < history_size + block_max_)
+      out_.resize(history_size + block_max_);
+  }
+
+  bool parse_frame_header()
+  {
+    if (! ensure(2))
+      return truncated();
+
+    auto flags = static_cast<uint8_t>(input()[0]);
+    auto bd = static_cast<uint8_t>(input()[1]);
+    if ((flags >> 6) != 1)
+    {
+      failure = error{"unsupported lz4 frame version"};
+      return false;
+    }
+
+    auto block_size_id = (bd >> 4) & 0x07;
+    if (block_size_id < 4)
+      return corrupt();
+
+    linked_ = (flags & 0x20) == 0;
+    block_checksum_ = (flags & 0x10) != 0;
+    content_checksum_ = (flags & 0x04) != 0;
+    size_t header = 2 + (flags & 0x08 ? 8 : 0) + (flags & 0x01 ? 4 : 0) + 1;
+    if (! ensure(header))
+      return truncated();
+
+    consume(header);
+    resize(size_t{1} << (8 + 2 * block_size_id));
+    history_ = 0;
+    return true;
+  }
+
+  // Decodes the next block into the output buffer. Returns false at the end
+  // of input or on failure.
+  bool next_block()
+  {
+    while (true)
+    {
+      if (state_ == magic)
+      {
+        if (! ensure(4))
+          return available() == 0 ? false : truncated();
+
+        auto m = load_le32(input());
+        consume(4);
+        if (m == lz4_magic)
+        {
+          if (! parse_frame_header())
+            return false;
+          state_ = frame;
+        }
+        else if (m == lz4_legacy_magic)
+        {
+          linked_ = false;
+          resize(8 << 20);
+          state_ = legacy;
+        }
+        else if ((m & 0xfffffff0) == lz4_skippable_magic)
+        {
+          if (! ensure(4))
+            return truncated();
+          auto n = load_le32(input()) + size_t{4};
+          if (! ensure(n))
+            return truncated();
+          consume(n);
+        }
+        else
+        {
+          return corrupt();
+        }
+
+        continue;
+      }
+
+      if (! ensure(4))
+        return state_ == legacy && available() == 0 ? false : truncated();
+
+      auto n = load_le32(input());
+      if (state_ == legacy)
+      {
+        // A legacy stream ends at EOF or continues with another frame.
+        if (n == lz4_magic || n == lz4_legacy_magic
+            || (n & 0xfffffff0) == lz4_skippable_magic)
+        {
+          state_ = magic;
+          continue;
+        }
+
+        consume(4);
+        return decompress(n, false);
+      }
+
+      consume(4);
+      if (n == 0)
+      {
+        // The end mark of a frame.
+        if (content_checksum_)
+        {
+          if (! ensure(4))
+            return truncated();
+          consume(4);
+        }
+
+        state_ = magic;
+        continue;
+      }
+
+      auto uncompressed = (n & 0x80000000) != 0;
+      if (! decompress(n & 0x7fffffff, uncompressed))
+        return false;
+
+      if (block_checksum_)
+      {
+        if (! ensure(4))
+          return truncated();
+        consume(4);
+      }
+
+      return true;
+    }
+  }
+
+  bool decompress(size_t size, bool uncompressed)
+  {
+    auto bound = LZ4_compressBound(static_cast<int>(block_max_));
+    if (size > static_cast<size_t>(bound))
+      return corrupt();
+
+    if (! ensure(size))
+      return truncated();
+
+    // Move the last 64 KB of output in front of the new block, such that
+    // linked blocks can refer to it.
+    if (linked_ && history_ > 0)
+      std::memmove(out_.data(), out_.data() + history_, history_size);
+
+    auto dst = out_.data() + history_size;
+    int n;
+    if (uncompressed)
+    {
+      if (size > block_max_)
+        return corrupt();
+      std::memcpy(dst, input(), size);
+      n = static_cast<int>(size);
+    }
+    else if (linked_)
+    {
+      n = LZ4_decompress_safe_withPrefix64k(input(), dst,
+                                            static_cast<int>(size),
+                                            static_cast<int>(block_max_));
+    }
+    else
+    {
+      n = LZ4_decompress_safe(input(), dst, static_cast<int>(size),
+                              static_cast<int>(block_max_));
+    }
+
+    if (n < 0)
+      return corrupt();
+
+    consume(size);
+    history_ = static_cast<size_t>(n);
+    block_first_ = dst;
+    block_last_ = dst + n;
+    return true;
+  }
+
+  state state_ = magic;
+  bool linked_ = false;
+  bool block_checksum_ = false;
+  bool content_checksum_ = false;
+  size_t block_max_ = 0;
+  size_t history_ = 0;
+  std::vector<char> out_;
+  char const* block_first_ = nullptr;
+  char const* block_last_ = nullptr;
+};
+
+std::unique_ptr<decompressor::decoder>
+make_decoder(file& f, file_compression format, std::vector<char> prefix)
+{
+  switch (format)
+  {
+    default:
+      return {};
+#ifdef VAST_HAVE_ZLIB
+    case file_compression::gzip:
+      return util::make_unique<gzip_decoder>(f, std::move(prefix));
+#endif // VAST_HAVE_ZLIB
+#ifdef VAST_HAVE_BZIP2
+    case file_compression::bzip2:
+      return util::make_unique<bzip2_decoder>(f, std::move(prefix));
+#endif // VAST_HAVE_BZIP2
+    case file_compression::lz4:
+      return util::make_unique<lz4_decoder>(f, std::move(prefix));
+  }
+}
+
+} // namespace <anonymous>
+
+decompressor::decompressor(file& f, file_compression format,
+                           std::vector<char> prefix,
+                           size_t block_size, size_t blocks)
+  : decoder_{make_decoder(f, format, std::move(prefix))},
+    ring_(blocks > 0 ? blocks : 1, std::vector<char>(block_size)),
+    sizes_(ring_.size())
+{
+  assert(block_size > 0);
+  if (! decoder_)
+  {
+    done_ = true;
+    failure_ = error{"unsupported compression format"};
+    return;
+  }
+
+  thread_ = std::thread{&decompressor::run, this};
+}
+
+decompressor::~decompressor()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+
+  produce_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool decompressor::read(void* sink, size_t size, size_t* got)
+{
+  *got = 0;
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    consume_.wait(lock, [&] { return done_ || produced_ > consumed_; });
+    if (produced_ == consumed_)
+      return false;
+  }
+
+  // The consumer owns all published buffers, so we can copy without holding
+  // the lock.
+  auto slot = consumed_ % ring_.size();
+  auto n = std::min(size, sizes_[slot] - pos_);
+  std::memcpy(sink, ring_[slot].data() + pos_, n);
+  pos_ += n;
+  *got = n;
+
+  if (pos_ == sizes_[slot])
+  {
+    pos_ = 0;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      ++consumed_;
+    }
+
+    produce_.notify_one();
+  }
+
+  return true;
+}
+
+error const& decompressor::failure() const
+{
+  return failure_;
+}
+
+void decompressor::run()
+{
+  while (true)
+  {
+    size_t slot;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      produce_.wait(
+          lock, [&] { return stop_ || produced_ - consumed_ < ring_.size(); });
+
+      if (stop_)
+        return;
+
+      slot = produced_ % ring_.size();
+    }
+
+    auto& buffer = ring_[slot];
+    size_t size = 0;
+    auto more = true;
+    while (size < buffer.size())
+    {
+      size_t got = 0;
+      if (! decoder_->decode(buffer.data() + size, buffer.size() - size, &got)
+          || got == 0)
+      {
+        more = false;
+        size += got;
+        break;
+      }
+
+      size += got;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      sizes_[slot] = size;
+      if (size > 0)
+        ++produced_;
+
+      if (! more)
+      {
+        done_ = true;
+        failure_ = decoder_->failure;
+      }
+    }
+
+    consume_.notify_one();
+    if (! more)
+      return;
+  }
+}
+
+} // namespace io
+} // namespace vast
@@ -0,0 +1,113 @@
+#ifndef VAST_IO_DECOMPRESSOR_H
+#define VAST_IO_DECOMPRESSOR_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "vast/config.h"
+#include "vast/util/error.h"
+
+namespace vast {
+
+class file;
+
+namespace io {
+
+/// The compression formats of files we can ingest directly.
+enum class file_compression : uint8_t
+{
+  none,
+  gzip,
+  bzip2,
+  lz4
+};
+
+/// The minimum number of bytes detect_compression() needs to recognize all
+/// formats.
+static size_t const compression_magic_size = 4;
+
+/// Detects the compression format of a file from its magic bytes.
+/// @param data The beginning of the file.
+/// @param size The number of bytes in *data*.
+/// @returns The compression format of the file starting with *data*.
+file_compression detect_compression(void const* data, size_t size);
+
+/// Checks whether this build can decompress a given format.
+/// @param format The compression format.
+/// @returns `true` *iff* a ::decompressor can handle *format*.
+bool supports(file_compression format);
+
+/// Decompresses a file on a separate thread into a bounded ring of buffers.
+/// The consumer thus processes one block while the next ones get
+/// decompressed, and the decompressor never runs more than the ring size
+/// ahead of the consumer.
+class decompressor
+{
+  decompressor(decompressor const&) = delete;
+  decompressor& operator=(decompressor) = delete;
+
+public:
+  /// The interface of the format-specific decoders.
+  class decoder;
+
+  /// Constructs a decompressor and starts the decompression thread.
+  ///
+  /// @param f The file to read compressed data from.
+  ///
+  /// @param format The compression format of *f*.
+  ///
+  /// @param prefix Data which has already been read from *f*, e.g., to
+  /// detect the compression format.
+  ///
+  /// @param block_size The size of a single buffer in the ring.
+  ///
+  /// @param blocks The number of buffers in the ring.
+  ///
+  /// @pre `supports(format)`
+  decompressor(file& f, file_compression format, std::vector<char> prefix,
+               size_t block_size, size_t blocks = 4);
+
+  /// Stops the decompression thread.
+  ~decompressor();
+
+  /// Reads decompressed data. Blocks until data is available.
+  ///
+  /// @param sink The buffer to copy the data into.
+  ///
+  /// @param size The number of bytes *sink* can hold.
+  ///
+  /// @param got A result parameter that contains the number of bytes copied
+  /// into *sink*.
+  ///
+  /// @returns `true` if at least one byte could be read, and `false` on EOF
+  /// or failure.
+  bool read(void* sink, size_t size, size_t* got);
+
+  /// Retrieves the error that caused the decompression to stop.
+  /// @returns The error, which is empty if the decompressor reached EOF.
+  error const& failure() const;
+
+private:
+  void run();
+
+  std::unique_ptr<decoder> decoder_;
+  std::vector<std::vector<char>> ring_;
+  std::vector<size_t> sizes_;
+  size_t produced_ = 0;
+  size_t consumed_ = 0;
+  size_t pos_ = 0;
+  bool done_ = false;
+  bool stop_ = false;
+  error failure_;
+  std::mutex mutex_;
+  std::condition_variable produce_;
+  std::condition_variable consume_;
+  std::thread thread_;
+};
+
+} // namespace io
+} // namespace vast
+
+#endif
@@ -0,0 +1,218 @@
+#include "vast/io/line_reader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "vast/file_system.h"
+#include "vast/util/make_unique.h"
+#include "vast/util/simd.h"
+
+#ifdef VAST_POSIX
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif // VAST_POSIX
+
+namespace vast {
+namespace io {
+
+line_reader::line_reader(file& f, size_t block_size)
+  : file_{&f},
+    block_size_{block_size > 0 ? block_size : default_line_block_size}
+{
+  if (! file_->is_open())
+    return;
+
+#ifdef VAST_POSIX
+  // We only map regular files which we read from the beginning. Everything
+  // else goes through the block buffer.
+  auto fd = file_->handle();
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+      && ::lseek(fd, 0, SEEK_CUR) == 0)
+  {
+    auto size = static_cast<size_t>(st.st_size);
+    auto map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED)
+    {
+      // Mapping does not move the file offset, so the decompressor can still
+      // read compressed files from the beginning.
+      auto format = detect_compression(map, size);
+      if (format != file_compression::none)
+      {
+        ::munmap(map, size);
+        decompress(format, {});
+        return;
+      }
+
+      ::madvise(map, size, MADV_SEQUENTIAL);
+      map_ = map;
+      map_size_ = size;
+      first_ = static_cast<char const*>(map_);
+      last_ = first_ + map_size_;
+      eof_ = true;
+      return;
+    }
+  }
+#endif // VAST_POSIX
+
+  // Read enough to recognize the magic bytes of compressed input.
+  buffer_.resize(std::max(block_size_, compression_magic_size));
+  size_t n = 0;
+  while (n < compression_magic_size)
+  {
+    size_t got = 0;
+    if (! file_->read(buffer_.data() + n, buffer_.size() - n, &got)
+        || got == 0)
+    {
+      eof_ = true;
+      break;
+    }
+
+    n += got;
+  }
+
+  auto format = detect_compression(buffer_.data(), n);
+  if (format != file_compression::none)
+  {
+    std::vector<char> prefix(buffer_.begin(), buffer_.begin() + n);
+    decompress(format, std::move(prefix));
+    return;
+  }
+
+  first_ = buffer_.data();
+  last_ = first_ + n;
+}
+
+line_reader::line_reader(char const* data, size_t size)
+  : first_{data},
+    last_{data + size},
+    eof_{true}
+{
+}
+
+line_reader::~line_reader()
+{
+#ifdef VAST_POSIX
+  if (map_)
+    ::munmap(map_, map_size_);
+#endif // VAST_POSIX
+}
+
+bool line_reader::next(char const** data, size_t* size)
+{
+  while (true)
+  {
+    auto sep = util::find_any(first_, last_, '\n', '\r');
+    if (sep != last_)
+    {
+      // An \r at the end of the buffer may be followed by a \n that we have
+      // not yet read.
+      if (*sep == '\r' && sep + 1 == last_ && ! eof_)
+      {
+        fill();
+        continue;
+      }
+
+      *data = first_;
+      *size = sep - first_;
+      first_ = sep + 1;
+      if (*sep == '\r' && first_ != last_ && *first_ == '\n')
+        ++first_;
+
+      return true;
+    }
+
+    if (eof_)
+    {
+      if (first_ == last_)
+        return false;
+
+      // The last line has no trailing separator.
+      *data = first_;
+      *size = last_ - first_;
+      first_ = last_;
+      return true;
+    }
+
+    fill();
+  }
+}
+
+error const& line_reader::failure() const
+{
+  return failure_;
+}
+
+file_compression line_reader::compression() const
+{
+  return compression_;
+}
+
+bool line_reader::mapped() const
+{
+  return map_ != nullptr;
+}
+
+bool line_reader::rest(char const** data, size_t* size) const
+{
+  if (! map_)
+    return false;
+
+  *data = first_;
+  *size = last_ - first_;
+  return true;
+}
+
+void line_reader::decompress(file_compression format,
+                             std::vector<char> prefix)
+{
+  compression_ = format;
+  first_ = last_ = buffer_.data();
+  if (! supports(format))
+  {
+    failure_ = error{"cannot decompress input: not compiled with support "
+                     "for the compression format"};
+    eof_ = true;
+    return;
+  }
+
+  decompressor_ = util::make_unique<decompressor>(
+      *file_, format, std::move(prefix), block_size_);
+  eof_ = false;
+}
+
+void line_reader::fill()
+{
+  assert(file_ && ! eof_);
+
+  // Move the partial line to the front and grow the buffer if the line does
+  // not fit into it.
+  auto remaining = static_cast<size_t>(last_ - first_);
+  if (remaining > 0 && first_ != buffer_.data())
+    std::memmove(buffer_.data(), first_, remaining);
+
+  if (buffer_.size() < block_size_)
+    buffer_.resize(block_size_);
+  else if (remaining == buffer_.size())
+    buffer_.resize(2 * buffer_.size());
+
+  size_t got = 0;
+  auto free = buffer_.size() - remaining;
+  auto success = decompressor_
+    ? decompressor_->read(buffer_.data() + remaining, free, &got)
+    : file_->read(buffer_.data() + remaining, free, &got);
+
+  if (! success || got == 0)
+  {
+    eof_ = true;
+    if (decompressor_)
+      failure_ = decompressor_->failure();
+  }
+
+  first_ = buffer_.data();
+  last_ = first_ + remaining + got;
+}
+
+} // namespace io
+} // namespace vast
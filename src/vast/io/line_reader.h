@@ -0,0 +1,109 @@
+#ifndef VAST_IO_LINE_READER_H
+#define VAST_IO_LINE_READER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "vast/config.h"
+#include "vast/io/decompressor.h"
+#include "vast/util/error.h"
+
+namespace vast {
+
+class file;
+
+namespace io {
+
+/// The default number of bytes a ::line_reader reads at once from a file
+/// that cannot be memory-mapped.
+static size_t const default_line_block_size = 1 << 20;
+
+/// Extracts lines from a file or a memory region without copying them. If the
+/// file is a regular file, the reader maps it into memory as a whole.
+/// Otherwise, e.g., for pipes or standard input, it reads large blocks into an
+/// internal buffer. Like io::getline, the reader treats `\r`, `\n`, and
+/// `\r\n` as line separator.
+///
+/// If the file starts with the magic bytes of gzip, bzip2, or lz4, the reader
+/// decompresses it transparently with an io::decompressor, which runs on a
+/// separate thread.
+class line_reader
+{
+  line_reader(line_reader const&) = delete;
+  line_reader& operator=(line_reader) = delete;
+
+public:
+  /// Constructs a line reader from an open file.
+  ///
+  /// @param f The file to read from.
+  ///
+  /// @param block_size The number of bytes to read at once if *f* cannot be
+  /// memory-mapped.
+  line_reader(file& f, size_t block_size = 0);
+
+  /// Constructs a line reader from a memory region.
+  /// @param data The beginning of the region.
+  /// @param size The number of bytes in *data*.
+  line_reader(char const* data, size_t size);
+
+  /// Unmaps the file if it has been memory-mapped.
+  ~line_reader();
+
+  /// Retrieves the next line.
+  ///
+  /// @param data A result parameter that points to the beginning of the line
+  /// *iff* next() returned `true`. The line remains valid until the next call
+  /// to next().
+  ///
+  /// @param size A result parameter that contains the length of the line
+  /// without the line separator *iff* next() returned `true`.
+  ///
+  /// @returns `true` if a line could be extracted, and `false` on EOF or
+  /// failure.
+  bool next(char const** data, size_t* size);
+
+  /// Retrieves the error that caused next() to fail.
+  /// @returns The error, which is empty if next() failed because of EOF.
+  error const& failure() const;
+
+  /// Retrieves the compression format of the input.
+  /// @returns The detected compression format.
+  file_compression compression() const;
+
+  /// Checks whether the reader operates on a memory-mapped file.
+  /// @returns `true` *iff* the file has been memory-mapped.
+  bool mapped() const;
+
+  /// Retrieves all remaining input of a memory-mapped file in one piece
+  /// without consuming it.
+  ///
+  /// @param data A result parameter that points to the remaining input *iff*
+  /// rest() returned `true`.
+  ///
+  /// @param size A result parameter that contains the size of *data* *iff*
+  /// rest() returned `true`.
+  ///
+  /// @returns `true` if the reader operates on a memory-mapped file.
+  bool rest(char const** data, size_t* size) const;
+
+private:
+  void decompress(file_compression format, std::vector<char> prefix);
+  void fill();
+
+  file* file_ = nullptr;
+  size_t block_size_ = 0;
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
+  std::vector<char> buffer_;
+  char const* first_ = nullptr;
+  char const* last_ = nullptr;
+  bool eof_ = false;
+  file_compression compression_ = file_compression::none;
+  std::unique_ptr<decompressor> decompressor_;
+  error failure_;
+};
+
+} // namespace io
+} // namespace vast
+
+#endif
@@ -5,6 +5,7 @@
 #include "vast/event.h"
 #include "vast/segment.h"
 #include "vast/io/serialization.h"
+#include "vast/util/thread_pool.h"
 
 namespace vast {
 
@@ -209,20 +210,13 @@ struct dispatcher : expr::default_const_visitor
       for (auto& p1 : p0.second)
         if (p1.second.type == te.type)
         {
-          if (p1.second.actor)
-          {
-            indexes_.push_back(p1.second.actor);
-          }
+          auto i = actor_.load_indexer(p0.first, p1.first);
+          if (i.failed())
+            VAST_LOG_ERROR(i.failure().msg());
+          else if (i.empty())
+            assert(! "file system inconsistency: index must exist");
           else
-          {
-            auto i = actor_.load_indexer(p0.first, p1.first);
-            if (i.failed())
-              VAST_LOG_ERROR(i.failure().msg());
-            else if (i.empty())
-              assert(! "file system inconsistency: index must exist");
-            else
-              indexes_.push_back(*i);
-          }
+            indexes_.push_back(*i);
         }
   }
 
@@ -241,7 +235,7 @@ struct dispatcher : expr::default_const_visitor
         VAST_LOG_WARN("type mismatch: requested " << value_->which() <<
                       " but offset " << oe.off << " has " << i->second.type);
       }
-      else if (! i->second.actor)
+      else
       {
         auto a = actor_.load_indexer(p0.first, oe.off);
         if (a.failed())
@@ -251,10 +245,6 @@ struct dispatcher : expr::default_const_visitor
         else
           indexes_.push_back(*a);
       }
-      else
-      {
-        indexes_.push_back(i->second.actor);
-      }
     }
   }
 
@@ -270,11 +260,34 @@ struct dispatcher : expr::default_const_visitor
 
 } // namespace <anonymous>
 
-partition_actor::partition_actor(path dir, size_t batch_size, uuid id)
+partition_actor::partition_actor(path dir, size_t batch_size, uuid id,
+                                 std::shared_ptr<util::thread_pool> read_ahead,
+                                 size_t max_indexers,
+                                 util::cache_policy policy)
   : dir_{std::move(dir)},
     batch_size_{batch_size},
-    partition_{std::move(id)}
+    read_ahead_{std::move(read_ahead)},
+    partition_{std::move(id)},
+    max_indexers_{max_indexers},
+    loaded_{util::make_replacement_policy<indexer_key, std::map>(policy)}
+{
+}
+
+void partition_actor::retire_indexers()
 {
+  if (max_indexers_ == 0)
+    return;
+
+  while (loaded_->size() > max_indexers_)
+  {
+    auto key = loaded_->evict({});
+    auto& is = indexers_[key.first][key.second];
+    assert(is.actor);
+    VAST_LOG_ACTOR_DEBUG("retires indexer " << VAST_ACTOR_ID(is.actor));
+    send_exit(is.actor, exit::done);
+    retiring_[key] = is.actor;
+    is.actor = {};
+  }
 }
 
 void partition_actor::act()
@@ -304,8 +317,11 @@ void partition_actor::act()
     }
 
     for (auto& p0 : types)
+    {
+      auto e = event_type_registry::instance()->intern(p0.first);
       for (auto& p1 : p0.second)
-        indexers_[p0.first][p1.first].type = p1.second;
+        indexers_[e][p1.first].type = p1.second;
+    }
   }
 
   traverse(
@@ -319,7 +335,8 @@ void partition_actor::act()
           return true;
         }
 
-        auto event_name = event_dir.basename().str();
+        auto t = event_type_registry::instance()->intern(
+            event_dir.basename().str());
         traverse(
             event_dir,
             [&](path const& idx_file) -> bool
@@ -339,7 +356,7 @@ void partition_actor::act()
                 return false;
               }
 
-              if (! indexers_[event_name].count(o))
+              if (! indexers_[t].count(o))
               {
                 VAST_LOG_ACTOR_ERROR("has no meta data for " <<
                                      idx_file);
@@ -387,7 +404,7 @@ void partition_actor::act()
 
           actor_ptr indexer;
 
-          auto i = load_indexer(e.name(), o);
+          auto i = load_indexer(e.type(), o);
           if (i.failed())
           {
             VAST_LOG_ACTOR_ERROR(i.failure().msg());
@@ -396,7 +413,7 @@ void partition_actor::act()
           }
           else if (i.empty())
           {
-            auto a = create_indexer(e.name(), o, v.which());
+            auto a = create_indexer(e.type(), o, v.which());
             if (! a)
             {
               VAST_LOG_ACTOR_ERROR(a.failure().msg());
@@ -425,7 +442,9 @@ void partition_actor::act()
     for (auto& p0 : indexers_)
       for (auto& p1 : p0.second)
       {
-        types[p0.first][p1.first] = p1.second.type;
+        auto name = event_type_registry::instance()->name(p0.first);
+        assert(name != nullptr);
+        types[*name][p1.first] = p1.second.type;
 
         if (p1.second.actor)
           send(p1.second.actor, atom("flush"));
@@ -472,7 +491,17 @@ void partition_actor::act()
         for (auto& p0 : indexers_)
           for (auto& p1 : p0.second)
             if (p1.second.actor == last_sender())
+            {
               p1.second.actor = {};
+              if (max_indexers_ > 0)
+                loaded_->erase(indexer_key{p0.first, p1.first});
+            }
+
+        for (auto i = retiring_.begin(); i != retiring_.end(); )
+          if (i->second == last_sender())
+            i = retiring_.erase(i);
+          else
+            ++i;
 
         stats_.erase(last_sender());
       },
@@ -497,6 +526,8 @@ void partition_actor::act()
           for (auto& a : d.indexes_)
             a << t;
         }
+
+        retire_indexers();
       },
       on(atom("flush")) >> flush,
       on_arg_match >> [=](segment const& s)
@@ -506,9 +537,12 @@ void partition_actor::act()
 
         std::vector<cow<event>> all_events;
         all_events.reserve(batch_size_);
-        std::unordered_map<string, std::vector<cow<event>>> groups;
+        std::unordered_map<event_type, std::vector<cow<event>>> groups;
 
         segment::reader r{&s};
+        if (read_ahead_)
+          r.read_ahead(read_ahead_);
+
         while (auto ev = r.read())
         {
           assert(ev);
@@ -521,7 +555,7 @@ void partition_actor::act()
             all_events = {};
           }
 
-          auto& group = groups[e->name()];
+          auto& group = groups[e->type()];
           group.push_back(e);
           if (group.size() == batch_size_)
           {
@@ -544,6 +578,7 @@ void partition_actor::act()
 
         // Flush partition meta data and data indexes.
         flush();
+        retire_indexers();
         send(self, atom("stats"), atom("show"));
       },
       on(atom("stats"), arg_match) >> [=](uint64_t n, uint64_t rate, uint64_t mean)
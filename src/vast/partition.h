@@ -1,18 +1,23 @@
 #ifndef VAST_PARTITION_H
 #define VAST_PARTITION_H
 
+#include <memory>
 #include "vast/actor.h"
 #include "vast/bitmap_indexer.h"
+#include "vast/event_type_registry.h"
 #include "vast/file_system.h"
 #include "vast/string.h"
 #include "vast/time.h"
 #include "vast/uuid.h"
+#include "vast/util/cache_policy.h"
 #include "vast/util/result.h"
 
 namespace vast {
 
 class segment;
 
+namespace util { class thread_pool; }
+
 /// A horizontal partition of the index.
 class partition
 {
@@ -71,13 +76,34 @@ struct partition_actor : actor<partition_actor>
     uint64_t mean = 0;
   };
 
-  partition_actor(path dir, size_t batch_size, uuid id = uuid::random());
+  using indexer_key = std::pair<event_type, offset>;
+
+  /// Spawns a partition actor.
+  ///
+  /// @param dir The directory of the partition.
+  ///
+  /// @param batch_size The number of events to index at once.
+  ///
+  /// @param id The ID of the partition.
+  ///
+  /// @param read_ahead If not `nullptr`, the threads to decompress the
+  /// chunks of a segment on while the actor indexes its events.
+  ///
+  /// @param max_indexers The maximum number of event data indexers to keep
+  /// running. If 0, the partition never terminates an indexer it has loaded.
+  ///
+  /// @param policy The replacement policy selecting the indexers to
+  /// terminate once more than *max_indexers* run.
+  partition_actor(path dir, size_t batch_size, uuid id = uuid::random(),
+                  std::shared_ptr<util::thread_pool> read_ahead = nullptr,
+                  size_t max_indexers = 0,
+                  util::cache_policy policy = util::cache_policy::lru);
 
   void act();
   char const* description() const;
 
   template <typename Bitstream = default_bitstream>
-  result<cppa::actor_ptr> load_indexer(string const& e, offset const& o)
+  result<cppa::actor_ptr> load_indexer(event_type e, offset const& o)
   {
     auto i = indexers_.find(e);
     if (i == indexers_.end())
@@ -88,7 +114,12 @@ struct partition_actor : actor<partition_actor>
       return {};
 
     if (j->second.actor)
+    {
+      if (max_indexers_ > 0)
+        loaded_->access(indexer_key{e, o});
+
       return j->second.actor;
+    }
 
     auto a = create_indexer<Bitstream>(e, o, j->second.type);
     if (! a)
@@ -101,29 +132,54 @@ struct partition_actor : actor<partition_actor>
   }
 
   template <typename Bitstream = default_bitstream>
-  trial<cppa::actor_ptr> create_indexer(string const& e, offset const& o, value_type t)
+  trial<cppa::actor_ptr>
+  create_indexer(event_type e, offset const& o, value_type t)
   {
     auto& is = indexers_[e][o];
     assert(! is.actor);
 
-    auto p = dir_ / partition::event_data_dir / e / (to<string>(o) + ".idx");
-    auto a = make_indexer<Bitstream>(t, std::move(p), o);
+    auto name = event_type_registry::instance()->name(e);
+    assert(name != nullptr);
+    auto p =
+      dir_ / partition::event_data_dir / *name / (to<string>(o) + ".idx");
+
+    // If we have retired the previous indexer of the same file, the new one
+    // waits for it to finish writing.
+    indexer_key const key{e, o};
+    cppa::actor_ptr predecessor;
+    auto r = retiring_.find(key);
+    if (r != retiring_.end())
+      predecessor = r->second;
+
+    auto a = make_indexer<Bitstream>(t, std::move(p), e, o, predecessor);
     if (! a)
       return a;
 
     monitor(*a);
     is.actor = *a;
     is.type = t;
+    if (max_indexers_ > 0)
+      loaded_->insert(key);
 
     return *a;
   }
 
+  // Terminates the indexers the replacement policy selects until at most
+  // max_indexers_ remain. An indexer writes its index to disk before it
+  // terminates. We retire indexers only after having sent all messages of
+  // the current batch or query, which they thus still process.
+  void retire_indexers();
+
   path dir_;
   size_t batch_size_;
+  std::shared_ptr<util::thread_pool> read_ahead_;
   partition partition_;
   cppa::actor_ptr time_indexer_;
   cppa::actor_ptr name_indexer_;
-  std::unordered_map<string, std::map<offset, indexer_state>> indexers_;
+  std::unordered_map<event_type, std::map<offset, indexer_state>> indexers_;
+  size_t max_indexers_;
+  std::unique_ptr<util::replacement_policy<indexer_key>> loaded_;
+  std::map<indexer_key, cppa::actor_ptr> retiring_;
   std::unordered_map<cppa::actor_ptr, indexer_stats> stats_;
 };
 
@@ -15,6 +15,7 @@
 #include "vast/search.h"
 #include "vast/signal_monitor.h"
 #include "vast/detail/type_manager.h"
+#include "vast/io/compressed_stream.h"
 #include "vast/util/profiler.h"
 
 #ifdef VAST_HAVE_BROCCOLI
@@ -29,6 +30,119 @@ using namespace cppa;
 
 namespace vast {
 
+namespace {
+
+// Parses the name of a compression method.
+optional<io::compression> to_compression(std::string const& name)
+{
+  if (name == "null")
+    return io::null;
+  else if (name == "automatic")
+    return io::automatic;
+  else if (name == "lz4")
+    return io::lz4;
+#ifdef VAST_HAVE_SNAPPY
+  else if (name == "snappy")
+    return io::snappy;
+#endif
+#ifdef VAST_HAVE_ZSTD
+  else if (name == "zstd")
+    return io::zstd;
+#endif
+  else
+    return {};
+}
+
+// Parses the objective of automatic compression.
+optional<io::compression_policy> to_compression_policy(std::string const& name)
+{
+  if (name == "fastest")
+    return io::fastest;
+  else if (name == "smallest")
+    return io::smallest;
+  else if (name == "balanced")
+    return io::balanced;
+  else
+    return {};
+}
+
+// Parses the name of a chunk layout.
+optional<segment::layout> to_layout(std::string const& name)
+{
+  if (name == "row")
+    return segment::row;
+  else if (name == "columnar")
+    return segment::columnar;
+  else
+    return {};
+}
+
+// Parses the scheduling of an ingestion stage, yielding `true` if the stage
+// runs in a thread of its own.
+optional<bool> to_detached(std::string const& name)
+{
+  if (name == "detached")
+    return true;
+  else if (name == "pooled")
+    return false;
+  else
+    return {};
+}
+
+// Parses the name of a cache replacement policy.
+optional<util::cache_policy> to_cache_policy(std::string const& name)
+{
+  if (name == "lru")
+    return util::cache_policy::lru;
+  else if (name == "2q")
+    return util::cache_policy::two_queue;
+  else if (name == "arc")
+    return util::cache_policy::arc;
+  else if (name == "clock")
+    return util::cache_policy::clock;
+  else
+    return {};
+}
+
+// Parses the name of a durability level for segment writes.
+optional<durability> to_durability(std::string const& name)
+{
+  if (name == "none")
+    return durability::none;
+  else if (name == "segment")
+    return durability::segment;
+  else if (name == "group")
+    return durability::group;
+  else
+    return {};
+}
+
+// Spawns the ingestor with the given spawn options.
+template <spawn_options Options>
+actor_ptr spawn_ingestor(configuration const& config, path const& dir,
+                         actor_ptr receiver)
+{
+  return spawn<ingestor_actor, Options>(
+      dir,
+      receiver,
+      *config.as<size_t>("ingest.max-events-per-chunk"),
+      *config.as<size_t>("ingest.max-segment-size") * 1000000,
+      *config.as<size_t>("ingest.batch-size"),
+      *config.as<size_t>("ingest.parse-threads"),
+      *config.as<size_t>("ingest.credit"),
+      *config.as<size_t>("ingest.max-inflight-segments"),
+      *config.as<size_t>("ingest.max-sources"),
+      *config.as<size_t>("ingest.segmentizers"),
+      *to_detached(*config.get("ingest.parse-stage")),
+      *to_detached(*config.get("ingest.segmentize-stage")),
+      *to_layout(*config.get("ingest.chunk-layout")),
+      *to_compression(*config.get("ingest.compression")),
+      *to_compression_policy(*config.get("ingest.compression-policy")),
+      *config.as<size_t>("ingest.compression-threads"));
+}
+
+} // namespace <anonymous>
+
 program::program(configuration const& config)
   : config_{config}
 {
@@ -114,9 +228,34 @@ void program::act()
     auto archive_port = *config_.as<unsigned>("archive.port");
     if (config_.check("archive-actor") || config_.check("all-server"))
     {
+      auto policy = to_cache_policy(*config_.get("archive.cache-policy"));
+      if (! policy)
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported cache policy: " <<
+                             *config_.get("archive.cache-policy"));
+        quit(exit::error);
+        return;
+      }
+
+      auto d = to_durability(*config_.get("archive.durability"));
+      if (! d)
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported durability: " <<
+                             *config_.get("archive.durability"));
+        quit(exit::error);
+        return;
+      }
+
       archive = spawn<archive_actor, linked>(
           vast_dir / "archive",
-          *config_.as<size_t>("archive.max-segments"));
+          *config_.as<size_t>("archive.cache-size") * 1000000,
+          *policy,
+          *config_.as<size_t>("archive.io-threads"),
+          *d,
+          std::chrono::milliseconds(
+              *config_.as<size_t>("archive.group-commit-window")),
+          *config_.as<size_t>("archive.compaction-target") * 1000000,
+          *config_.as<size_t>("ingest.max-events-per-chunk"));
 
       VAST_LOG_ACTOR_INFO(
           "publishes archive at " << archive_host << ':' << archive_port);
@@ -138,8 +277,20 @@ void program::act()
     auto index_port = *config_.as<unsigned>("index.port");
     if (config_.check("index-actor") || config_.check("all-server"))
     {
+      auto policy = to_cache_policy(*config_.get("index.indexer-policy"));
+      if (! policy)
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported cache policy: " <<
+                             *config_.get("index.indexer-policy"));
+        quit(exit::error);
+        return;
+      }
+
       index = spawn<index_actor, linked>(
-          vast_dir / "index", *config_.as<size_t>("index.batch-size"));
+          vast_dir / "index", *config_.as<size_t>("index.batch-size"),
+          *config_.as<size_t>("index.read-ahead-threads"),
+          *config_.as<size_t>("index.max-indexers"),
+          *policy);
 
       VAST_LOG_ACTOR_INFO(
           "publishes index " << index_host << ':' << index_port);
@@ -173,6 +324,11 @@ void program::act()
         {
           VAST_LOG_INFO("sent all segments to index (" << eid - 1 << " events)");
           become(default_behavior);
+        },
+        on(atom("no segment"), arg_match) >> [=](uuid const& id)
+        {
+          VAST_LOG_ERROR("aborts index rebuild, could not read segment " << id);
+          become(default_behavior);
         });
 
       VAST_LOG_INFO("begins rebuilding index");
@@ -202,12 +358,51 @@ void program::act()
     actor_ptr ingestor;
     if (config_.check("ingestor-actor"))
     {
-      ingestor = spawn<ingestor_actor, linked>(
-          vast_dir,
-          receiver,
-          *config_.as<size_t>("ingest.max-events-per-chunk"),
-          *config_.as<size_t>("ingest.max-segment-size") * 1000000,
-          *config_.as<size_t>("ingest.batch-size"));
+      if (! to_compression(*config_.get("ingest.compression")))
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported compression method: " <<
+                             *config_.get("ingest.compression"));
+        quit(exit::error);
+        return;
+      }
+
+      if (! to_compression_policy(*config_.get("ingest.compression-policy")))
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported compression policy: " <<
+                             *config_.get("ingest.compression-policy"));
+        quit(exit::error);
+        return;
+      }
+
+      if (! to_layout(*config_.get("ingest.chunk-layout")))
+      {
+        VAST_LOG_ACTOR_ERROR("unsupported chunk layout: " <<
+                             *config_.get("ingest.chunk-layout"));
+        quit(exit::error);
+        return;
+      }
+
+      for (auto stage : {"ingest.parse-stage",
+                         "ingest.segmentize-stage",
+                         "ingest.ship-stage"})
+        if (! to_detached(*config_.get(stage)))
+        {
+          VAST_LOG_ACTOR_ERROR("unsupported scheduling of " << stage <<
+                               ": " << *config_.get(stage));
+          quit(exit::error);
+          return;
+        }
+
+#ifdef VAST_HAVE_ZSTD
+      io::zstd_registry::instance()->level(
+          *config_.as<int>("ingest.zstd-level"));
+#endif
+
+      if (*to_detached(*config_.get("ingest.ship-stage")))
+        ingestor =
+          spawn_ingestor<linked + detached>(config_, vast_dir, receiver);
+      else
+        ingestor = spawn_ingestor<linked>(config_, vast_dir, receiver);
 
 #ifdef VAST_HAVE_BROCCOLI
       util::broccoli::init(config_.check("broccoli-messages"),
@@ -230,6 +425,9 @@ void program::act()
       else if (auto file = config_.get("ingest.file-name"))
         send(ingestor, atom("ingest"), *config_.get("ingest.file-type"), *file,
              *config_.as<int32_t>("ingest.time-field"));
+      else if (auto endpoint = config_.get("ingest.listen"))
+        send(ingestor, atom("ingest"), atom("listen"), *endpoint,
+             *config_.as<int32_t>("ingest.time-field"));
       else
         send_exit(ingestor, exit::done);
     }
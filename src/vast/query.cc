@@ -1,11 +1,52 @@
 #include "vast/query.h"
 
+#include <set>
 #include <cppa/cppa.hpp>
 #include "vast/event.h"
 #include "vast/logger.h"
 
 namespace vast {
 
+namespace {
+
+// Collects the top-level fields which an expression accesses.
+struct field_collector : expr::default_const_visitor
+{
+  virtual void visit(expr::conjunction const& conj)
+  {
+    for (auto& op : conj.operands)
+      op->accept(*this);
+  }
+
+  virtual void visit(expr::disjunction const& disj)
+  {
+    for (auto& op : disj.operands)
+      op->accept(*this);
+  }
+
+  virtual void visit(expr::predicate const& pred)
+  {
+    pred.lhs().accept(*this);
+    pred.rhs().accept(*this);
+  }
+
+  virtual void visit(expr::offset_extractor const& oe)
+  {
+    if (! oe.off.empty())
+      fields_.insert(oe.off[0]);
+  }
+
+  virtual void visit(expr::type_extractor const&)
+  {
+    all_ = true;
+  }
+
+  bool all_ = false;
+  std::set<size_t> fields_;
+};
+
+} // namespace <anonymous>
+
 query::query(expr::ast ast, std::function<void(event)> fn)
   : ast_{std::move(ast)},
     fn_{fn},
@@ -13,6 +54,10 @@ query::query(expr::ast ast, std::function<void(event)> fn)
     unprocessed_{bitstream_type{}},
     masked_{bitstream_type{}}
 {
+  field_collector collector;
+  ast_.accept(collector);
+  project_ = ! collector.all_;
+  fields_.assign(collector.fields_.begin(), collector.fields_.end());
 }
 
 query::query_state query::state() const
@@ -93,7 +138,7 @@ trial<uint64_t> query::extract(uint64_t max)
   uint64_t n = 0;
   for (auto id : masked_)
   {
-    auto e = reader_->read(id);
+    auto e = reader_->read(id, project_ ? &fields_ : nullptr);
     if (! e)
     {
       state_ = failed;
@@ -102,6 +147,16 @@ trial<uint64_t> query::extract(uint64_t max)
 
     if (evaluate(ast_, *e).get<bool>())
     {
+      if (project_ && reader_->columnar())
+      {
+        e = reader_->read(id);
+        if (! e)
+        {
+          state_ = failed;
+          return error{"query failed to extract event " + to_string(id)};
+        }
+      }
+
       fn_(std::move(*e));
       if (++n == max && id != masked_.find_last())
       {
@@ -120,7 +175,7 @@ trial<uint64_t> query::extract(uint64_t max)
     }
   }
 
-  if (n == 0)
+  if (n == 0 && masked_.find_first() != bitstream::npos)
     VAST_LOG_WARN("query could not find a single result in segment " <<
                   current_->id());
 
@@ -182,7 +237,13 @@ bool query::instantiate()
   masked_.append(current_->events(), true);
   masked_ &= unprocessed_;
 
-  assert(! masked_.empty());
+  // Hits in chunks which cannot contain a match according to their zone maps
+  // are false positives, which we process without decompressing the chunks.
+  bitstream skipped = current_->excluded<bitstream_type>(ast_);
+  skipped &= masked_;
+  processed_ |= skipped;
+  unprocessed_ -= skipped;
+  masked_ -= skipped;
 
   return true;
 }
@@ -318,12 +379,18 @@ void query_actor::act()
 
         inflight_.erase(i, inflight_.end());
 
+        // After a compaction, the archive may return a segment overlapping
+        // one we already have. We ask again once we have processed that one,
+        // rather than right away.
         if (! query_.add(s))
+        {
           VAST_LOG_ACTOR_WARN("ignores duplicate segment " << s->id());
-        else
-          VAST_LOG_ACTOR_DEBUG(
-              "added segment " << s->id() <<
-              " [" << s->base() << ", " << s->base() + s->events() << ")");
+          return;
+        }
+
+        VAST_LOG_ACTOR_DEBUG(
+            "added segment " << s->id() <<
+            " [" << s->base() << ", " << s->base() + s->events() << ")");
 
         prefetch(prefetch_);
 
@@ -345,6 +412,11 @@ void query_actor::act()
         VAST_LOG_ACTOR_ERROR("could not obtain segment for event ID " << eid);
         quit(exit::error);
       },
+      on(atom("no segment"), arg_match) >> [=](uuid const& id)
+      {
+        VAST_LOG_ACTOR_ERROR("could not read segment " << id);
+        quit(exit::error);
+      },
       others() >> [=]
       {
         VAST_LOG_ACTOR_ERROR("got unexpected message from @" <<
@@ -14,6 +14,8 @@
 namespace vast {
 
 /// Takes bitstreams and segments to produce results in the form of events.
+/// For events in columnar chunks, the query first materializes only the
+/// fields its expression refers to, and all fields only for actual results.
 class query
 {
 public:
@@ -75,6 +77,8 @@ private:
   bool finishing_ = false;
   query_state state_ = idle;
   expr::ast ast_;
+  bool project_ = true;
+  std::vector<size_t> fields_;
   std::function<void(event)> fn_;
   bitstream hits_;
   bitstream processed_;
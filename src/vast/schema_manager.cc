@@ -1,6 +1,7 @@
 #include "vast/schema_manager.h"
 
 #include <cppa/cppa.hpp>
+#include "vast/event_type_registry.h"
 #include "vast/file_system.h"
 #include "vast/schema.h"
 
@@ -28,6 +29,18 @@ void schema_manager_actor::act()
       on(atom("schema")) >> [=]()
       {
         return make_any_tuple(schema_);
+      },
+      on(atom("event type"), arg_match) >> [=](string const& name)
+      {
+        return make_any_tuple(event_type_registry::instance()->intern(name));
+      },
+      on(atom("event name"), arg_match) >> [=](event_type t)
+      {
+        auto name = event_type_registry::instance()->name(t);
+        if (! name)
+          return make_any_tuple(atom("failure"));
+
+        return make_any_tuple(*name);
       });
 }
 
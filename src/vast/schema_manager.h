@@ -6,7 +6,8 @@
 
 namespace vast {
 
-/// Manages the existing taxonomies.
+/// Manages the existing taxonomies and provides actors access to the
+/// ::event_type_registry of its process.
 class schema_manager_actor : public actor<schema_manager_actor>
 {
 public:
@@ -1,12 +1,35 @@
 #include "vast/segment.h"
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include "vast/event.h"
+#include "vast/event_type_registry.h"
+#include "vast/file_system.h"
 #include "vast/logger.h"
 #include "vast/serialization.h"
+#include "vast/io/file_stream.h"
+#include "vast/io/serialization.h"
 #include "vast/util/make_unique.h"
+#include "vast/util/thread_pool.h"
 
 namespace vast {
 
+namespace {
+
+// The number of events between two entries of a chunk's offset table. This
+// bounds the number of events a seek within a row chunk has to deserialize,
+// whereas each entry also ends a compression block.
+uint32_t const events_per_mark = 1024;
+
+// The number of bytes of serialized events of one type to train a zstd
+// dictionary on, and the maximum size of the dictionary. The former should be
+// about 100 times the latter.
+size_t const dictionary_training_bytes = 2 << 20;
+size_t const dictionary_size = 16 << 10;
+
+} // namespace <anonymous>
+
 // FIXME: Why does the linker complain without these definitions? These are
 // redundant to those in the header file.
 uint32_t const segment::header::magic;
@@ -36,7 +59,11 @@ void segment::header::deserialize(deserializer& source)
   uint32_t v;
   source >> v;
   if (v > version)
-    throw std::runtime_error{"segment version too high"};
+    throw std::runtime_error{"segment version " + std::to_string(v) +
+                             " too high, expected " + std::to_string(version)};
+  else if (v < version)
+    throw std::runtime_error{"segment version " + std::to_string(v) +
+                             " too low, expected " + std::to_string(version)};
 
   source
     >> id
@@ -61,29 +88,48 @@ bool operator==(segment::header const& x, segment::header const& y)
       && x.occupied_bytes == y.occupied_bytes;
 }
 
-segment::writer::writer(segment* s, size_t max_events_per_chunk)
+segment::writer::writer(segment* s, size_t max_events_per_chunk, layout l,
+                        io::compression_policy policy,
+                        std::shared_ptr<util::thread_pool> pool)
   : segment_(s),
-    chunk_{make_unique<chunk>(segment_->header_.compression)},
-    chunk_writer_{make_unique<chunk::writer>(*chunk_)},
-    max_events_per_chunk_{max_events_per_chunk}
+    chunk_{make_unique<chunk>(segment_->header_.compression, policy)},
+    max_events_per_chunk_{max_events_per_chunk},
+    layout_{l},
+    policy_{policy},
+    pool_{std::move(pool)}
 {
   assert(s != nullptr);
+  assert(s->local_types_.empty());
 }
 
 segment::writer::~writer()
 {
   if (! flush())
-    VAST_LOG_WARN("segment writer discarded " <<
-                  chunk_->elements() << " events");
+  {
+    // The pending tasks reference the chunks we discard.
+    size_t n = 0;
+    for (auto& s : sealed_)
+    {
+      if (s.compressed.valid())
+        s.compressed.wait();
+
+      n += s.data->elements();
+    }
+
+    VAST_LOG_WARN("segment writer discarded " << n << " events");
+  }
 }
 
 bool segment::writer::write(event const& e)
 {
-  if (! (chunk_writer_ && store(e)))
+  if (full_ || ! store(e))
     return false;
 
-  if (max_events_per_chunk_ && chunk_->elements() % max_events_per_chunk_ == 0)
-    return flush();
+  if (max_events_per_chunk_ && pending() % max_events_per_chunk_ == 0)
+  {
+    seal();
+    drain(false);
+  }
 
   return true;
 }
@@ -91,32 +137,15 @@ bool segment::writer::write(event const& e)
 void segment::writer::attach_to(segment* s)
 {
   assert(s != nullptr);
+  assert(s->local_types_.empty());
   segment_ = s;
+  full_ = false;
 }
 
 bool segment::writer::flush()
 {
-  if (chunk_->empty())
-    return true;
-
-  chunk_writer_.reset();
-
-  if (segment_->max_bytes() > 0
-      && segment_->bytes() + chunk_->compressed_bytes() > segment_->max_bytes())
-    return false;
-
-  segment_->header_.first = first_;
-  segment_->header_.last = last_;
-  segment_->header_.n += chunk_->elements();
-  segment_->header_.occupied_bytes += chunk_->compressed_bytes();
-  segment_->chunks_.push_back(std::move(*chunk_));
-
-  chunk_ = make_unique<chunk>(segment_->header_.compression);
-  chunk_writer_ = make_unique<chunk::writer>(*chunk_);
-  first_ = time_range{};
-  last_ = time_range{};
-
-  return true;
+  seal();
+  return drain(true);
 }
 
 size_t segment::writer::bytes() const
@@ -126,10 +155,30 @@ size_t segment::writer::bytes() const
 
 bool segment::writer::store(event const& e)
 {
-  auto success =
-    chunk_writer_->write(e.name(), 0) &&
-    chunk_writer_->write(e.timestamp(), 0) &&
-    chunk_writer_->write(static_cast<std::vector<value> const&>(e));
+  if (layout_ == row && ! chunk_writer_)
+  {
+    chunk_dictionary_ = dictionary(e.type());
+    chunk_writer_ = make_unique<chunk::writer>(*chunk_, events_per_mark,
+                                               chunk_dictionary_, true);
+  }
+
+  // Events of the same type usually arrive in runs, so we only need to
+  // remember the type when it changes.
+  if (e.type() != last_type_)
+  {
+    last_type_ = e.type();
+    if (last_type_ != unnamed_event_type)
+      chunk_types_.insert(last_type_);
+  }
+
+  auto success = true;
+  if (layout_ == row)
+    success =
+      chunk_writer_->write(e.type(), 0) &&
+      chunk_writer_->write(e.timestamp(), 0) &&
+      chunk_writer_->write(static_cast<std::vector<value> const&>(e));
+  else
+    events_.push_back(e);
 
   if (first_ == time_range{} || e.timestamp() < first_)
     first_ = e.timestamp();
@@ -137,12 +186,199 @@ bool segment::writer::store(event const& e)
   if (last_ == time_range{} || e.timestamp() > last_)
     last_ = e.timestamp();
 
+  if (layout_ == row)
+    zones_.add(e);
+
   if (! success)
     VAST_LOG_ERROR("failed to write event to chunk");
+  else if (layout_ == row)
+    sample(e);
 
   return success;
 }
 
+size_t segment::writer::pending() const
+{
+  return events_.empty() ? chunk_->elements() : events_.size();
+}
+
+void segment::writer::seal()
+{
+  if (pending() == 0)
+    return;
+
+  std::function<trial<nothing>()> compress;
+  auto c = chunk_.get();
+  std::shared_ptr<zone_map> zones;
+  if (layout_ == row)
+  {
+    zones = std::make_shared<zone_map>(std::move(zones_));
+    chunk_writer_.reset();
+    compress = [c]() -> trial<nothing>
+    {
+      c->compress();
+      return nil;
+    };
+  }
+  else
+  {
+    auto events = std::make_shared<std::vector<event>>();
+    events->swap(events_);
+    zones = std::make_shared<zone_map>();
+    compress = [c, events, zones]
+    {
+      for (auto& e : *events)
+        zones->add(e);
+
+      return write_columns(*events, *c);
+    };
+  }
+
+  sealed_chunk s;
+  if (pool_)
+  {
+    s.compressed = pool_->submit(compress);
+  }
+  else
+  {
+    std::packaged_task<trial<nothing>()> task{compress};
+    s.compressed = task.get_future();
+    task();
+  }
+
+  s.data = std::move(chunk_);
+  s.types.swap(chunk_types_);
+  s.dictionary = chunk_dictionary_;
+  s.first = first_;
+  s.last = last_;
+  s.zones = std::move(zones);
+  sealed_.push_back(std::move(s));
+
+  chunk_ = make_unique<chunk>(segment_->header_.compression, policy_);
+  chunk_dictionary_ = 0;
+  last_type_ = unnamed_event_type;
+  first_ = time_range{};
+  last_ = time_range{};
+  zones_ = {};
+}
+
+bool segment::writer::drain(bool all)
+{
+  // We bound the number of chunks in flight, so that a slow pool throttles
+  // the writer rather than letting uncompressed chunks pile up.
+  auto const max_sealed = pool_ ? 2 * pool_->size() : 0;
+  while (! sealed_.empty())
+  {
+    auto& s = sealed_.front();
+    if (s.compressed.valid())
+    {
+      if (! all && sealed_.size() <= max_sealed
+          && s.compressed.wait_for(std::chrono::seconds(0))
+               != std::future_status::ready)
+        return true;
+
+      auto t = s.compressed.get();
+      if (! t)
+      {
+        VAST_LOG_ERROR("failed to compress chunk: " << t.failure().msg());
+        sealed_.pop_front();
+        continue;
+      }
+    }
+
+    // An empty segment takes any chunk, so that a chunk larger than a
+    // segment does not stall the writer.
+    if (segment_->max_bytes() > 0
+        && ! segment_->chunks_.empty()
+        && segment_->bytes() + s.data->compressed_bytes()
+             > segment_->max_bytes())
+    {
+      full_ = true;
+      return false;
+    }
+
+    // The chunk may have been written while the writer was attached to a
+    // different segment, so we record its event types only now.
+    for (auto t : s.types)
+      if (! segment_->types_.count(t))
+        segment_->types_.emplace(t, *event_type_registry::instance()->name(t));
+
+#ifdef VAST_HAVE_ZSTD
+    auto d = s.dictionary;
+    if (d != 0 && ! segment_->dictionaries_.count(d))
+      segment_->dictionaries_.emplace(
+          d, *io::zstd_registry::instance()->find(d));
+#endif
+
+    segment_->header_.first = s.first;
+    segment_->header_.last = s.last;
+    segment_->header_.n += s.data->elements();
+    segment_->header_.occupied_bytes += s.data->compressed_bytes();
+    segment_->chunks_.push_back(std::move(*s.data));
+    segment_->zones_.push_back(std::move(*s.zones));
+    sealed_.pop_front();
+  }
+
+  return true;
+}
+
+uint32_t segment::writer::dictionary(event_type t) const
+{
+#ifdef VAST_HAVE_ZSTD
+  if (segment_->header_.compression == io::zstd)
+  {
+    auto name = event_type_registry::instance()->name(t);
+    return io::zstd_registry::instance()->lookup(
+        std::string{name->data(), name->size()});
+  }
+#else
+  static_cast<void>(t);
+#endif
+
+  return 0;
+}
+
+void segment::writer::sample(event const& e)
+{
+#ifdef VAST_HAVE_ZSTD
+  if (segment_->header_.compression != io::zstd || dictionary(e.type()) != 0)
+    return;
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, e.type(), e.timestamp(),
+              static_cast<std::vector<value> const&>(e));
+
+  auto& s = samples_[e.type()];
+  s.bytes += buf.size();
+  s.data.push_back(std::move(buf));
+  if (s.bytes < dictionary_training_bytes)
+    return;
+
+  auto& name = *event_type_registry::instance()->name(e.type());
+  auto dict = io::zstd_registry::train(s.data, dictionary_size);
+  samples_.erase(e.type());
+  if (! dict)
+  {
+    VAST_LOG_WARN("failed to train dictionary for " << name << ": " <<
+                  dict.failure().msg());
+    return;
+  }
+
+  auto id = io::zstd_registry::instance()->add(std::move(*dict));
+  if (! id)
+  {
+    VAST_LOG_WARN(id.failure().msg());
+    return;
+  }
+
+  VAST_LOG_VERBOSE("trained zstd dictionary " << *id << " for " << name);
+  io::zstd_registry::instance()->assign(
+      std::string{name.data(), name.size()}, *id);
+#else
+  static_cast<void>(e);
+#endif
+}
+
 
 segment::reader::reader(segment const* s)
   : segment_{*s},
@@ -152,21 +388,40 @@ segment::reader::reader(segment const* s)
   if (! segment_.chunks_.empty())
   {
     current_ = &segment_.chunks_.front().read();
-    chunk_reader_ = make_unique<chunk::reader>(*current_);
+    open();
   }
 }
 
+segment::reader::~reader()
+{
+  // The pending tasks reference chunks of the segment.
+  for (auto& p : ahead_)
+    p.second.wait();
+}
+
+void segment::reader::read_ahead(std::shared_ptr<util::thread_pool> pool,
+                                 size_t max_chunks)
+{
+  assert(pool != nullptr);
+  assert(max_chunks > 0);
+  pool_ = std::move(pool);
+  max_window_ = max_chunks;
+  window_ = std::min(window_, max_window_);
+  schedule();
+}
+
 event_id segment::reader::position() const
 {
   return next_;
 }
 
-trial<event> segment::reader::read(event_id id)
+trial<event> segment::reader::read(event_id id,
+                                   std::vector<size_t> const* fields)
 {
   if (id > 0 && ! seek(id))
     return error{"event id " + to_string(id) + " out of bounds"};
 
-  auto r = load();
+  auto r = load(false, fields);
   if (r.engaged())
     return {std::move(r.value())};
   else if (r.failed())
@@ -176,6 +431,11 @@ trial<event> segment::reader::read(event_id id)
   return error{"empty event"}; // should never happen.
 }
 
+bool segment::reader::columnar() const
+{
+  return column_reader_ != nullptr;
+}
+
 bool segment::reader::seek(event_id id)
 {
   if (! segment_.contains(id))
@@ -192,16 +452,21 @@ bool segment::reader::seek(event_id id)
       backup();
     else
       while (next_ > id)
-        if (! prev())
+        if (! prev(false))
           return false;
   }
   else
   {
     while (! within_current_chunk(id))
-      if (! next())
+      if (! next(false))
         return false;
   }
 
+  // We pass over chunks without reading from them, because instantiating a
+  // reader touches the chunk's data.
+  if (! chunk_reader_ && ! column_reader_)
+    open();
+
   assert(id >= next_);
   auto n = id - next_;
 
@@ -242,7 +507,7 @@ optional<size_t> segment::reader::extract(event_id begin,
   return n;
 }
 
-chunk const* segment::reader::next()
+chunk const* segment::reader::next(bool instantiate)
 {
   if (! current_ || chunk_idx_ + 1 == segment_.chunks_.size())
     return nullptr;
@@ -253,19 +518,25 @@ chunk const* segment::reader::next()
     next_ = chunk_base_;
   }
 
-  current_ = &segment_.chunks_[++chunk_idx_].read();
-  chunk_reader_ = make_unique<chunk::reader>(*current_);
+  current_ = fetch(++chunk_idx_);
+  if (instantiate)
+    open();
+  else
+    close();
 
   return current_;
 }
 
-chunk const* segment::reader::prev()
+chunk const* segment::reader::prev(bool instantiate)
 {
   if (segment_.chunks_.empty() || chunk_idx_ == 0)
     return nullptr;
 
-  current_ = &segment_.chunks_[--chunk_idx_].read();
-  chunk_reader_ = make_unique<chunk::reader>(*current_);
+  current_ = fetch(--chunk_idx_);
+  if (instantiate)
+    open();
+  else
+    close();
 
   if (next_ > 0)
   {
@@ -283,18 +554,49 @@ event_id segment::reader::backup()
 
   auto distance = next_ - chunk_base_;
   next_ = chunk_base_;
-  chunk_reader_ = make_unique<chunk::reader>(*current_);
+
+  // A column reader keeps its decoded columns.
+  if (column_reader_)
+    row_ = 0;
+  else
+    chunk_reader_ = make_unique<chunk::reader>(*current_);
+
   return distance;
 }
 
-result<event> segment::reader::load(bool discard)
+result<event> segment::reader::load(bool discard,
+                                    std::vector<size_t> const* fields)
 {
+  if (column_reader_)
+  {
+    if (row_ == column_reader_->size())
+      return next() ? load(discard, fields) : error{"no more events to load"};
+
+    if (discard)
+    {
+      ++row_;
+      if (next_ > 0)
+        ++next_;
+
+      return {};
+    }
+
+    auto e = column_reader_->read(row_++, fields);
+    if (! e)
+      return e.failure();
+
+    if (next_ > 0)
+      e->id(next_++);
+
+    return {std::move(*e)};
+  }
+
   if (! chunk_reader_ || chunk_reader_->available() == 0)
-    return next() ? load(discard) : error{"no more events to load"};
+    return next() ? load(discard, fields) : error{"no more events to load"};
 
-  string name;
-  if (! chunk_reader_->read(name, 0))
-    return error{"failed to read event name from chunk"};
+  event_type type;
+  if (! chunk_reader_->read(type, 0))
+    return error{"failed to read event type from chunk"};
 
   time_point t;
   if (! chunk_reader_->read(t, 0))
@@ -306,8 +608,12 @@ result<event> segment::reader::load(bool discard)
 
   if (! discard)
   {
+    auto i = segment_.local_types_.find(type);
+    if (i != segment_.local_types_.end())
+      type = i->second;
+
     event e(std::move(v));
-    e.name(std::move(name));
+    e.type(type);
     e.timestamp(t);
     if (next_ > 0)
       e.id(next_++);
@@ -326,7 +632,32 @@ trial<event_id> segment::reader::skip(size_t n)
   if (n == 0)
     return 0;
 
+  // Columnar chunks allow for skipping within the chunk in constant time.
+  if (column_reader_ && row_ + n <= column_reader_->size())
+  {
+    row_ += n;
+    if (next_ > 0)
+      next_ += n;
+
+    return n;
+  }
+
+  // Row chunks let us jump close to the target by means of their offset
+  // table, and we deserialize only the events thereafter.
   event_id skipped = 0;
+  if (chunk_reader_)
+  {
+    auto available = chunk_reader_->available();
+    auto current = current_->elements() - available;
+    if (n < available)
+    {
+      skipped = chunk_reader_->seek(current + n) - current;
+      n -= skipped;
+      if (next_ > 0)
+        next_ += skipped;
+    }
+  }
+
   while (n --> 0)
   {
     auto r = load(true);
@@ -340,6 +671,76 @@ trial<event_id> segment::reader::skip(size_t n)
   return skipped;
 }
 
+void segment::reader::open()
+{
+  assert(current_ != nullptr);
+  row_ = 0;
+  if (current_->columns().empty())
+  {
+    column_reader_.reset();
+    chunk_reader_ = make_unique<chunk::reader>(*current_);
+  }
+  else
+  {
+    chunk_reader_.reset();
+    column_reader_ =
+      make_unique<column_reader>(*current_, &segment_.local_types_);
+  }
+}
+
+void segment::reader::close()
+{
+  chunk_reader_.reset();
+  column_reader_.reset();
+}
+
+chunk const* segment::reader::fetch(size_t i)
+{
+  auto c = &segment_.chunks_[i].read();
+  if (! pool_)
+    return c;
+
+  // The readers may still reference the previously decompressed chunk.
+  close();
+
+  // Seeking may skip over chunks of the window or go backwards.
+  while (! ahead_.empty() && ahead_.front().first != i)
+  {
+    ahead_.front().second.wait();
+    ahead_.pop_front();
+  }
+
+  if (! ahead_.empty())
+  {
+    auto ready = [](std::future<chunk> const& f)
+    {
+      return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+
+    if (! ready(ahead_.front().second))
+      window_ = std::min(2 * window_, max_window_);
+    else if (window_ > 1 && ready(ahead_.back().second))
+      --window_;
+
+    decompressed_ = make_unique<chunk>(ahead_.front().second.get());
+    ahead_.pop_front();
+    c = decompressed_.get();
+  }
+
+  schedule();
+  return c;
+}
+
+void segment::reader::schedule()
+{
+  auto i = ahead_.empty() ? chunk_idx_ + 1 : ahead_.back().first + 1;
+  while (ahead_.size() < window_ && i < segment_.chunks_.size())
+  {
+    auto c = &segment_.chunks_[i].read();
+    ahead_.emplace_back(i++, pool_->submit([c] { return c->decompress(); }));
+  }
+}
+
 bool segment::reader::within_current_chunk(event_id eid) const
 {
   assert(current_ != nullptr);
@@ -361,6 +762,11 @@ uuid const& segment::id() const
   return header_.id;
 }
 
+io::compression segment::compression() const
+{
+  return header_.compression;
+}
+
 time_point segment::first() const
 {
   return header_.first;
@@ -427,12 +833,119 @@ size_t segment::store(std::vector<event> const& v, size_t max_events_per_chunk)
 
 void segment::serialize(serializer& sink) const
 {
-  sink << header_ << chunks_;
+  sink << header_ << types_ << dictionaries_ << zones_ << chunks_;
+}
+
+trial<nothing> segment::save(path const& filename) const
+{
+  file f{filename};
+  auto t = f.open(file::write_only);
+  if (! t)
+    return t;
+
+  io::file_output_stream sink{f};
+  {
+    // The serializer hands unused buffer space back to the stream when it
+    // goes out of scope, which must happen before flushing.
+    binary_serializer s{sink};
+    s << header_ << types_ << dictionaries_ << zones_;
+    s.begin_sequence(chunks_.size());
+    for (auto& c : chunks_)
+      c->serialize_outline(s);
+    s.end_sequence();
+
+    for (auto& c : chunks_)
+      c->serialize_bytes(s);
+  }
+
+  if (! sink.flush())
+    return error{"failed to write " + to_string(filename)};
+
+  return nil;
+}
+
+trial<nothing> segment::map(path const& filename)
+{
+  auto m = mapped_file::map(filename);
+  if (! m)
+    return m.failure();
+
+  auto& file = **m;
+  std::shared_ptr<void const> mapping = *m;
+  io::array_input_stream source{file.data(), file.size()};
+  binary_deserializer d{source};
+
+  // We only take over the contents once the whole file has checked out.
+  header hdr;
+  std::map<event_type, string> types;
+  std::map<uint32_t, std::vector<uint8_t>> dictionaries;
+  std::vector<zone_map> zones;
+  std::vector<cow<chunk>> chunks;
+  try
+  {
+    d >> hdr >> types >> dictionaries >> zones;
+    uint64_t n;
+    d.begin_sequence(n);
+    chunks.reserve(n);
+    for (uint64_t i = 0; i < n; ++i)
+    {
+      chunk c;
+      c.deserialize_outline(d, mapping);
+      chunks.emplace_back(std::move(c));
+    }
+
+    d.end_sequence();
+  }
+  catch (std::exception const& e)
+  {
+    return error{"failed to read " + to_string(filename) + ": " + e.what()};
+  }
+
+  // The compressed bytes of all chunks make up the rest of the file.
+  uint64_t bytes = 0;
+  for (auto& c : chunks)
+    bytes += c->compressed_bytes();
+
+  if (d.bytes() > file.size() || file.size() - d.bytes() != bytes)
+    return error{"truncated segment file " + to_string(filename)};
+
+  auto data = file.data() + d.bytes();
+  for (auto& c : chunks)
+    c.write().attach(data);
+
+  header_ = std::move(hdr);
+  types_ = std::move(types);
+  dictionaries_ = std::move(dictionaries);
+  zones_ = std::move(zones);
+  chunks_ = std::move(chunks);
+  localize();
+
+  return nil;
+}
+
+void segment::localize()
+{
+#ifdef VAST_HAVE_ZSTD
+  for (auto& p : dictionaries_)
+    io::zstd_registry::instance()->add(p.second);
+#endif
+
+  // The chunks contain the event types of the process that wrote them. We
+  // keep them as they are and only translate those types on access which
+  // differ in this process.
+  local_types_.clear();
+  for (auto& p : types_)
+  {
+    auto local = event_type_registry::instance()->intern(p.second);
+    if (local != p.first)
+      local_types_.emplace(p.first, local);
+  }
 }
 
 void segment::deserialize(deserializer& source)
 {
-  source >> header_ >> chunks_;
+  source >> header_ >> types_ >> dictionaries_ >> zones_ >> chunks_;
+  localize();
 }
 
 bool operator==(segment const& x, segment const& y)
@@ -1,14 +1,22 @@
 #ifndef VAST_SEGMENT_H
 #define VAST_SEGMENT_H
 
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include "vast/aliases.h"
 #include "vast/chunk.h"
+#include "vast/columnar.h"
 #include "vast/cow.h"
 #include "vast/time.h"
 #include "vast/optional.h"
 #include "vast/uuid.h"
+#include "vast/zone_map.h"
 #include "vast/io/compression.h"
 #include "vast/util/operators.h"
 #include "vast/util/result.h"
@@ -17,15 +25,31 @@ namespace vast {
 
 class event;
 
+namespace util { class thread_pool; }
+
 /// Contains a vector of chunks with additional meta data.
 class segment : util::equality_comparable<segment>
 {
 public:
+  /// The layout of the events within a chunk.
+  enum layout : uint8_t
+  {
+    /// One event after another.
+    row,
+
+    /// Each top-level field of an event type in a column of its own, as
+    /// written by ::write_columns.
+    columnar
+  };
+
   /// Segment meta data.
   struct header : util::equality_comparable<header>
   {
     static uint32_t const magic = 0x2a2a2a2a;
-    static uint32_t const version = 1;
+    /// The on-disk format version. Segments of a different version cannot
+    /// be read; there is no conversion, so data archived with an older
+    /// version must be imported anew.
+    static uint32_t const version = 7;
 
     uuid id;
     io::compression compression;
@@ -45,6 +69,33 @@ public:
   /// A proxy class for writing into a segment. Each writer maintains a local
   /// chunk that receives events to serialize. Upon flushing, the writer
   /// appends the chunk to the underlying segment.
+  ///
+  /// Chunks store the ::event_type of each event rather than its name. The
+  /// segment records the name of every event type it contains, so that
+  /// readers in other processes can map the types to their own.
+  ///
+  /// With a columnar layout, the writer buffers the events of a chunk and
+  /// encodes them upon flushing.
+  ///
+  /// For each chunk, the writer also records a ::zone_map of its events,
+  /// which the segment stores next to the chunk. For columnar chunks, it
+  /// builds the zone map along with the columns.
+  ///
+  /// For zstd-compressed row chunks, the writer trains a dictionary per event
+  /// type from the first events of that type and compresses each chunk with
+  /// the dictionary of its first event. The segment stores the dictionaries
+  /// of its chunks, so that readers in other processes can decompress them.
+  ///
+  /// Given a thread pool, the writer compresses full chunks on the pool and
+  /// meanwhile keeps serializing events into the next chunk. It appends the
+  /// compressed chunks to the segment in the order it sealed them. Without a
+  /// pool, it compresses each chunk before it accepts the next event.
+  ///
+  /// The writer keeps the chunks which do not fit into a full segment until
+  /// it gets attached to the next one. With a pool, these may be more than a
+  /// single segment takes, so the caller must keep attaching the writer to a
+  /// new segment while ::flush reports a full segment. An empty segment takes
+  /// at least one chunk, regardless of its size.
   class writer
   {
   public:
@@ -54,8 +105,19 @@ public:
     ///
     /// @param max_events_per_chunk The maximum number of events per chunk.
     ///
+    /// @param l The layout of the chunks to write.
+    ///
+    /// @param policy The objective by which to select the compression method
+    /// of each chunk if the segment has io::automatic compression.
+    ///
+    /// @param pool The threads to compress chunks on. If `nullptr`, the
+    /// writer compresses chunks itself.
+    ///
     /// @pre `s != nullptr`
-    explicit writer(segment* s, size_t max_events_per_chunk = 0);
+    explicit writer(segment* s, size_t max_events_per_chunk = 0,
+                    layout l = row,
+                    io::compression_policy policy = io::balanced,
+                    std::shared_ptr<util::thread_pool> pool = nullptr);
 
     /// Destructs a writer and flushes the event chunk into the underlying
     /// segment.
@@ -65,20 +127,27 @@ public:
     ~writer();
 
     /// Serializes an event into the underlying segment.
+    ///
     /// @param e The event to write.
-    /// @returns `true` on success and `false` if the segment is full.
+    ///
+    /// @returns `true` on success and `false` if the segment is full, in
+    /// which case the writer did not take *e*. Since the writer appends
+    /// chunks only after compressing them, it may notice that the segment is
+    /// full only one event after the chunk that did not fit.
     bool write(event const& e);
 
     /// Attaches the writer to a new segment.
     /// @param s The segment to attach the writer to.
-    /// @pre `s != nullptr`
+    /// @pre `s != nullptr` and *s* has been created in this process.
     void attach_to(segment* s);
 
-    /// Seals the current chunk and appends it to the list of chunks in the
-    /// underlying segment.
+    /// Seals the current chunk and appends it, along with all chunks still
+    /// being compressed, to the list of chunks in the underlying segment.
     ///
-    /// @returns `false` on failure, `true` on success or if there
-    /// were no events to flush.
+    /// @returns `false` if the segment became full before the writer could
+    /// append all chunks, in which case it keeps the remaining ones for the
+    /// next segment, and `true` on success or if there were no events to
+    /// flush.
     bool flush();
 
     /// Retrieves the number of bytes processed in total.
@@ -86,14 +155,61 @@ public:
     size_t bytes() const;
 
   private:
+    struct samples
+    {
+      size_t bytes = 0;
+      std::vector<std::vector<uint8_t>> data;
+    };
+
+    // A chunk on its way from the writer into the segment.
+    struct sealed_chunk
+    {
+      std::unique_ptr<chunk> data;
+      std::future<trial<nothing>> compressed;
+      std::set<event_type> types;
+      uint32_t dictionary;
+      time_point first;
+      time_point last;
+      std::shared_ptr<zone_map> zones;
+    };
+
     bool store(event const& e);
+    size_t pending() const;
+
+    // Hands the current chunk over for compression.
+    void seal();
+
+    // Appends compressed chunks to the segment in the order of sealing, as
+    // long as they fit. If *all* is `false`, only those whose compression has
+    // finished, unless too many chunks are in flight. Returns `false` if the
+    // segment is full.
+    bool drain(bool all);
+
+    // Retrieves the ID of the zstd dictionary for an event type, or 0 if the
+    // segment does not use zstd or the type has no dictionary yet.
+    uint32_t dictionary(event_type t) const;
+
+    // Collects an event as sample for a zstd dictionary and trains the
+    // dictionary of its type once enough samples have accrued.
+    void sample(event const& e);
 
     segment* segment_;
     std::unique_ptr<chunk> chunk_;
     std::unique_ptr<chunk::writer> chunk_writer_;
+    uint32_t chunk_dictionary_ = 0;
     size_t max_events_per_chunk_;
+    layout layout_;
+    io::compression_policy policy_;
+    std::shared_ptr<util::thread_pool> pool_;
+    std::deque<sealed_chunk> sealed_;
+    bool full_ = false;
+    std::vector<event> events_;
+    event_type last_type_ = unnamed_event_type;
+    std::set<event_type> chunk_types_;
+    std::unordered_map<event_type, samples> samples_;
     time_point first_ = time_range{};
     time_point last_ = time_range{};
+    zone_map zones_;
   };
 
   /// A proxy class for reading from a segment. Multiple readers can safely
@@ -105,14 +221,44 @@ public:
     /// @param s The segment to read from.
     explicit reader(segment const* s);
 
+    /// Waits for the chunks still being decompressed ahead.
+    ~reader();
+
+    /// Enables read-ahead. The reader then decompresses the chunks after the
+    /// current one on a thread pool while the caller deserializes events.
+    /// The window of chunks to decompress ahead adapts to the rate of the
+    /// caller: it doubles whenever the reader has to wait for a chunk and
+    /// shrinks by one chunk whenever the pool has finished the whole window
+    /// before the reader needs it.
+    ///
+    /// @param pool The threads to decompress on.
+    ///
+    /// @param max_chunks The maximum number of chunks to decompress ahead.
+    ///
+    /// @pre `pool != nullptr && max_chunks > 0`
+    void read_ahead(std::shared_ptr<util::thread_pool> pool,
+                    size_t max_chunks = 8);
+
     /// Retrieves the current position of the reader.
     /// @returns The ID of the next event to ::read.
     event_id position() const;
 
     /// Reads the next event from the current position.
+    ///
     /// @param id If non-zero, specifies the ID of the event to extract.
+    ///
+    /// @param fields If not `nullptr`, the indexes of the top-level fields
+    /// to materialize for events in columnar chunks. The remaining fields
+    /// then have an invalid value. Events from row chunks always come with
+    /// all their fields.
+    ///
     /// @returns The extracted event on success.
-    trial<event> read(event_id id = 0);
+    trial<event> read(event_id id = 0,
+                      std::vector<size_t> const* fields = nullptr);
+
+    /// Checks whether the current chunk has a columnar layout.
+    /// @returns `true` iff the reader currently reads from a columnar chunk.
+    bool columnar() const;
 
     /// Seeks to an event with a given ID.
     ///
@@ -142,12 +288,14 @@ public:
                              std::function<void(event)> f);
 
     /// Moves to the next chunk.
+    /// @param instantiate Whether to instantiate the reader for the chunk.
     /// @returns A pointer to the next chunk or `nullptr` on failure.
-    chunk const* next();
+    chunk const* next(bool instantiate = true);
 
     /// Moves to the previous chunk.
+    /// @param instantiate Whether to instantiate the reader for the chunk.
     /// @returns A pointer to the previous chunk or `nullptr` on failure.
-    chunk const* prev();
+    chunk const* prev(bool instantiate = true);
 
     /// Resets the internal reading position to the beginning of the current
     /// chunk.
@@ -165,9 +313,27 @@ public:
     /// @param discard Flag indicating whether to discard or return the
     /// deserialized event.
     ///
+    /// @param fields The fields to materialize, as in ::read.
+    ///
     /// @returns An event if *discard* was `false` and an empty result if
     /// *discard* was `true`.
-    result<event> load(bool discard = false);
+    result<event> load(bool discard = false,
+                       std::vector<size_t> const* fields = nullptr);
+
+    /// Instantiates the reader for the current chunk.
+    void open();
+
+    /// Destroys the reader for the current chunk.
+    void close();
+
+    /// Retrieves a chunk to read from, which is the decompressed copy from
+    /// the read-ahead window if available.
+    /// @param i The index of the chunk.
+    /// @returns The chunk to read from.
+    chunk const* fetch(size_t i);
+
+    /// Fills the read-ahead window with the chunks after the current one.
+    void schedule();
 
     /// Checks whether a given ID falls into the current chunk.
     /// @param eid The event ID to check.
@@ -180,6 +346,13 @@ public:
     event_id chunk_base_ = 0;
     size_t chunk_idx_ = 0;
     std::unique_ptr<chunk::reader> chunk_reader_;
+    std::unique_ptr<column_reader> column_reader_;
+    size_t row_ = 0;
+    std::shared_ptr<util::thread_pool> pool_;
+    size_t window_ = 1;
+    size_t max_window_ = 0;
+    std::deque<std::pair<size_t, std::future<chunk>>> ahead_;
+    std::unique_ptr<chunk> decompressed_;
   };
 
   /// Constructs a segment.
@@ -193,6 +366,10 @@ public:
   /// @returns A UUID identifying the segment.
   uuid const& id() const;
 
+  /// Retrieves the compression method of the chunks.
+  /// @returns The compression method of the segment.
+  io::compression compression() const;
+
   /// Retrieves the timestamp of the earliest event in the segment.
   time_point first() const;
 
@@ -236,6 +413,28 @@ public:
     return bs;
   }
 
+  /// Generates a bitstream of the events in chunks which cannot contain a
+  /// match for an expression according to their zone maps, so that a query
+  /// need not decompress these chunks.
+  ///
+  /// @param ast The expression to check the chunks against.
+  ///
+  /// @returns A bitstream with the IDs of all events which *ast* cannot
+  /// match set to 1.
+  template <typename Bitstream = default_bitstream>
+  Bitstream excluded(expr::ast const& ast) const
+  {
+    Bitstream bs;
+    if (base() == 0 || zones_.size() != chunks_.size())
+      return bs;
+
+    bs.append(base(), false);
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      bs.append(chunks_[i]->elements(), ! zones_[i].may_match(ast));
+
+    return bs;
+  }
+
   /// Retrieves the number of bytes the segment occupies in memory.
   uint64_t bytes() const;
 
@@ -277,11 +476,37 @@ public:
     return n;
   }
 
+  /// Writes the segment into a file. The file begins with the header and an
+  /// outline of all chunks, followed by the compressed bytes of the chunks,
+  /// so that ::map can reference them in place.
+  ///
+  /// @param filename The file to write.
+  ///
+  /// @returns `nothing` on success.
+  trial<nothing> save(path const& filename) const;
+
+  /// Maps a file written by ::save into memory. The chunks then reference
+  /// their compressed bytes in the mapping instead of copying them, so that
+  /// the operating system reads only the chunks a reader accesses.
+  ///
+  /// @param filename The file to map.
+  ///
+  /// @returns `nothing` on success.
+  trial<nothing> map(path const& filename);
+
 private:
   header header_;
+  std::map<event_type, string> types_;
+  std::unordered_map<event_type, event_type> local_types_;
+  std::map<uint32_t, std::vector<uint8_t>> dictionaries_;
   std::vector<cow<chunk>> chunks_;
+  std::vector<zone_map> zones_;
 
 private:
+  // Registers the dictionaries of a segment from another process and maps
+  // its event types to those of this process.
+  void localize();
+
   friend access;
   void serialize(serializer& sink) const;
   void deserialize(deserializer& source);
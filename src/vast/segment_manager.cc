@@ -1,46 +1,46 @@
 #include "vast/segment_manager.h"
 
+#include <algorithm>
 #include <cppa/cppa.hpp>
 #include "vast/file_system.h"
 #include "vast/segment.h"
-#include "vast/io/file_stream.h"
-#include "vast/io/serialization.h"
-#include "vast/serialization.h"
+#include "vast/util/thread_pool.h"
 
 namespace vast {
 
-segment_manager::segment_manager(size_t capacity, path dir)
+segment_manager::segment_manager(size_t capacity, path dir,
+                                 util::cache_policy policy)
   : dir_{std::move(dir)},
-    cache_{capacity, [&](uuid const& id) { return on_miss(id); }}
+    cache_{capacity,
+           [&](uuid const& id) -> cow<segment>
+           {
+             auto t = read(id);
+             if (t)
+               return std::move(*t);
+
+             VAST_LOG_ERROR(t.failure().msg());
+             return {};
+           },
+           [](cow<segment> const& s) { return s->bytes(); },
+           policy}
 {
-  traverse(
-      dir_,
-      [&](path const& p) -> bool
+  cache_.admission(
+      [=](uuid const&, cow<segment> const& s)
       {
-        segment_files_.emplace(to_string(p.basename()), p);
-        return true;
+        return s->bytes() <= capacity;
       });
 }
 
 bool segment_manager::store(cow<segment> const& s)
 {
-  if (segment_files_.empty())
+  auto t = write(*s);
+  if (! t)
   {
-    assert(! exists(dir_));
-    if (! mkdir(dir_))
-    {
-      VAST_LOG_ERROR("failed to create directory " << dir_);
-      return false;
-    }
+    VAST_LOG_ERROR(t.failure().msg());
+    return false;
   }
 
-  assert(segment_files_.find(s->id()) == segment_files_.end());
-  auto const filename = dir_ / path{to_string(s->id())};
-  io::archive(filename, *s);
-  segment_files_.emplace(s->id(), filename);
-  cache_.insert(s->id(), s);
-
-  VAST_LOG_VERBOSE("wrote segment to " << filename);
+  insert(s);
   return true;
 }
 
@@ -49,22 +49,234 @@ cow<segment> segment_manager::lookup(uuid const& id)
   return cache_.retrieve(id);
 }
 
-cow<segment> segment_manager::on_miss(uuid const& uid)
+trial<nothing> segment_manager::write(segment const& s, durability d) const
+{
+  // Creating an existing directory fails, so a concurrent writer may have
+  // won the race if the directory exists afterwards.
+  if (! exists(dir_) && ! mkdir(dir_) && ! exists(dir_))
+    return error{"failed to create directory " + to_string(dir_)};
+
+  // Opening an existing file does not truncate it.
+  auto const tmp = temporary(s.id());
+  if (exists(tmp) && ! rm(tmp))
+    return error{"failed to remove stale " + to_string(tmp)};
+
+  auto t = s.save(tmp);
+  if (! t)
+    return error{"failed to write segment to " + to_string(tmp) + ": " +
+                 t.failure().msg()};
+
+  switch (d)
+  {
+    case durability::none:
+      t = mv(tmp, filename(s.id()));
+      break;
+    case durability::segment:
+      t = commit({s.id()});
+      break;
+    case durability::group:
+      return nil;
+  }
+
+  if (! t)
+    return t;
+
+  VAST_LOG_VERBOSE("wrote segment to " << filename(s.id()));
+  return nil;
+}
+
+trial<nothing> segment_manager::commit(std::vector<uuid> const& ids) const
 {
-  assert(segment_files_.find(uid) != segment_files_.end());
-  VAST_LOG_DEBUG("experienced cache miss for " << uid <<
+  // The data must reach the disk before the rename, because otherwise a
+  // crash could leave a segment file with missing data. The rename itself
+  // becomes durable with the directory.
+  for (auto& id : ids)
+  {
+    auto const tmp = temporary(id);
+    file f{tmp};
+    auto t = f.open(file::read_only);
+    if (! t)
+      return error{"failed to open " + to_string(tmp) + ": " +
+                   t.failure().msg()};
+
+    if (! f.sync(false))
+      return error{"failed to sync " + to_string(tmp)};
+  }
+
+  for (auto& id : ids)
+  {
+    auto t = mv(temporary(id), filename(id));
+    if (! t)
+      return t;
+  }
+
+  return sync_directory(dir_);
+}
+
+trial<cow<segment>> segment_manager::read(uuid const& id) const
+{
+  VAST_LOG_DEBUG("experienced cache miss for " << id <<
                        ", going to file system");
 
+  // Mapping the file reads only the segment header and the chunk outlines.
+  // The compressed bytes of a chunk remain on disk until a reader accesses
+  // them.
   segment s;
-  io::unarchive(dir_ / path{to_string(uid)}, s);
-  return {std::move(s)};
+  auto t = s.map(filename(id));
+  if (! t)
+    return error{"failed to load segment " + to_string(id) + ": " +
+                 t.failure().msg()};
+
+  return cow<segment>{std::move(s)};
+}
+
+void segment_manager::insert(cow<segment> const& s)
+{
+  cache_.insert(s->id(), s);
+}
+
+cow<segment> const* segment_manager::find(uuid const& id)
+{
+  return cache_.find(id);
+}
+
+void segment_manager::admit(cow<segment> const& s)
+{
+  cache_.admit(s->id(), s);
+}
+
+void segment_manager::erase(uuid const& id)
+{
+  cache_.erase(id);
+}
+
+trial<segment> segment_manager::compact(uuid const& id,
+                                        std::vector<uuid> const& ids,
+                                        size_t max_events_per_chunk,
+                                        durability d) const
+{
+  if (ids.size() < 2)
+    return error{"need at least two segments to compact"};
+
+  std::vector<segment> sources(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    auto t = sources[i].map(filename(ids[i]));
+    if (! t)
+      return error{"failed to load segment " + to_string(ids[i]) + ": " +
+                   t.failure().msg()};
+
+    if (i > 0 && sources[i - 1].base() + sources[i - 1].events()
+                 != sources[i].base())
+      return error{"segment " + to_string(ids[i]) + " does not follow " +
+                   to_string(ids[i - 1])};
+  }
+
+  // The merged segment inherits compression method and layout of the first
+  // segment. Since the events keep their order, they also keep their IDs.
+  auto layout = segment::row;
+  {
+    segment::reader r{&sources.front()};
+    if (r.read() && r.columnar())
+      layout = segment::columnar;
+  }
+
+  segment merged{id, 0, sources.front().compression()};
+  merged.base(sources.front().base());
+  {
+    segment::writer w{&merged, max_events_per_chunk, layout};
+    for (auto& s : sources)
+    {
+      segment::reader r{&s};
+      for (uint64_t i = 0; i < s.events(); ++i)
+      {
+        auto e = r.read();
+        if (! e)
+          return error{"failed to read event from segment " +
+                       to_string(s.id()) + ": " + e.failure().msg()};
+
+        if (! w.write(*e))
+          return error{"failed to write event into merged segment"};
+      }
+    }
+
+    if (! w.flush())
+      return error{"failed to flush merged segment"};
+  }
+
+  auto t = write(merged, d);
+  if (! t)
+    return t.failure();
+
+  return std::move(merged);
+}
+
+bool segment_manager::remove(uuid const& id) const
+{
+  return rm(filename(id));
+}
+
+segment_manager::cache_type const& segment_manager::cache() const
+{
+  return cache_;
+}
+
+path segment_manager::filename(uuid const& id) const
+{
+  return dir_ / path{to_string(id)};
+}
+
+path segment_manager::temporary(uuid const& id) const
+{
+  return dir_ / path{to_string(id) + ".tmp"};
 }
 
 using namespace cppa;
 
-segment_manager_actor::segment_manager_actor(size_t capacity, path dir)
-  : segment_manager_{capacity, std::move(dir)}
+segment_manager_actor::segment_manager_actor(size_t capacity, path dir,
+                                             util::cache_policy policy,
+                                             size_t io_threads,
+                                             durability d,
+                                             std::chrono::milliseconds window)
+  : segment_manager_{capacity, std::move(dir), policy},
+    durability_{d},
+    window_{window},
+    io_{new util::thread_pool{std::max<size_t>(io_threads, 1)}}
+{
+}
+
+void segment_manager_actor::load(uuid const& id)
+{
+  actor_ptr me = self;
+  auto slot = std::make_shared<cow<segment>>();
+  reads_[id].slot = slot;
+  io_->submit(
+      [=]
+      {
+        auto t = segment_manager_.read(id);
+        if (t)
+        {
+          *slot = std::move(*t);
+          me << make_any_tuple(atom("read"), id);
+        }
+        else
+        {
+          VAST_LOG_ERROR(t.failure().msg());
+          me << make_any_tuple(atom("read"), atom("failed"), id);
+        }
+      });
+}
+
+void segment_manager_actor::remove(uuid const& id)
 {
+  io_->submit(
+      [=]
+      {
+        if (segment_manager_.remove(id))
+          VAST_LOG_VERBOSE("deleted retired segment " << id);
+        else
+          VAST_LOG_WARN("failed to delete retired segment " << id);
+      });
 }
 
 void segment_manager_actor::act()
@@ -72,18 +284,183 @@ void segment_manager_actor::act()
   become(
       on_arg_match >> [=](segment const& s)
       {
-        if (! segment_manager_.store(*tuple_cast<segment>(last_dequeued())))
-        {
-          send_exit(self, exit::error);
-          return make_any_tuple(atom("segment"), atom("nack"), s.id());
-        }
+        // The segment goes into the cache right away, so that lookups
+        // succeed while it is still being written.
+        cow<segment> cs = *tuple_cast<segment>(last_dequeued());
+        segment_manager_.insert(cs);
+
+        actor_ptr me = self;
+        actor_ptr sender = last_sender();
+        auto id = s.id();
+        auto d = durability_;
+        writing_.insert(id);
+        io_->submit(
+            [=]
+            {
+              auto t = segment_manager_.write(*cs, d);
+              if (! t)
+                me << make_any_tuple(atom("failed"), id, sender,
+                                     t.failure().msg());
+              else if (d == durability::group)
+                me << make_any_tuple(atom("staged"), id, sender);
+              else
+                me << make_any_tuple(atom("written"), id, sender);
+            });
+      },
+      on(atom("staged"), arg_match) >> [=](uuid const& id,
+                                           actor_ptr const& sender)
+      {
+        group_.emplace_back(id, sender);
+        if (group_.size() == 1)
+          delayed_send(self, window_, atom("commit"));
+      },
+      on(atom("commit")) >> [=]
+      {
+        VAST_LOG_ACTOR_DEBUG("commits " << group_.size() << " segments");
+        actor_ptr me = self;
+        auto group = std::move(group_);
+        group_.clear();
+        io_->submit(
+            [=]
+            {
+              std::vector<uuid> ids;
+              for (auto& p : group)
+                ids.push_back(p.first);
+
+              auto t = segment_manager_.commit(ids);
+              for (auto& p : group)
+                if (t)
+                  me << make_any_tuple(atom("written"), p.first, p.second);
+                else
+                  me << make_any_tuple(atom("failed"), p.first, p.second,
+                                       t.failure().msg());
+            });
+      },
+      on(atom("written"), arg_match) >> [=](uuid const& id,
+                                            actor_ptr const& sender)
+      {
+        writing_.erase(id);
+        if (sender)
+          send(sender, atom("segment"), atom("ack"), id);
+
+        // A read of the segment had to wait until it reached its file.
+        auto i = reads_.find(id);
+        if (i != reads_.end() && ! i->second.slot)
+          load(id);
+      },
+      on(atom("failed"), arg_match) >> [=](uuid const& id,
+                                           actor_ptr const& sender,
+                                           std::string const& msg)
+      {
+        VAST_LOG_ACTOR_ERROR(msg);
+        if (sender)
+          send(sender, atom("segment"), atom("nack"), id);
 
-        return make_any_tuple(atom("segment"), atom("ack"), s.id());
+        send_exit(self, exit::error);
       },
       on_arg_match >> [=](uuid const& id, actor_ptr const& sink)
       {
         VAST_LOG_ACTOR_DEBUG("retrieves segment " << id);
-        sink << segment_manager_.lookup(id);
+        if (auto cs = segment_manager_.find(id))
+        {
+          sink << *cs;
+          return;
+        }
+
+        // Only the first request for a missing segment reads it, the others
+        // wait for the same read to complete.
+        auto& pending = reads_[id];
+        pending.sinks.push_back(sink);
+        if (! pending.slot && ! writing_.count(id))
+          load(id);
+      },
+      on(atom("read"), arg_match) >> [=](uuid const& id)
+      {
+        auto i = reads_.find(id);
+        assert(i != reads_.end());
+
+        // The message from the I/O thread orders its write to the slot before
+        // this access.
+        auto& cs = *i->second.slot;
+        auto retired = retired_.erase(id) > 0;
+        if (! retired)
+          segment_manager_.admit(cs);
+
+        for (auto& sink : i->second.sinks)
+          sink << cs;
+
+        reads_.erase(i);
+        if (retired)
+          remove(id);
+      },
+      on(atom("read"), atom("failed"), arg_match) >> [=](uuid const& id)
+      {
+        auto i = reads_.find(id);
+        assert(i != reads_.end());
+
+        // The sinks would wait forever for a segment which never arrives.
+        for (auto& sink : i->second.sinks)
+          send(sink, atom("no segment"), id);
+
+        reads_.erase(i);
+        if (retired_.erase(id) > 0)
+          remove(id);
+      },
+      on(atom("compact"), arg_match) >> [=](uuid const& id,
+                                            std::vector<uuid> const& ids,
+                                            uint64_t max_events_per_chunk)
+      {
+        actor_ptr sender = last_sender();
+        for (auto& seg : ids)
+          if (writing_.count(seg))
+          {
+            send(sender, atom("compact"), atom("nack"), ids);
+            return;
+          }
+
+        // Unless durability is off, the merged segment must survive a crash,
+        // because the archive deletes the original segments afterwards.
+        auto d = durability_ == durability::none
+          ? durability::none
+          : durability::segment;
+
+        io_->submit(
+            [=]
+            {
+              auto t = segment_manager_.compact(id, ids, max_events_per_chunk,
+                                                d);
+              if (t)
+              {
+                sender << make_any_tuple(atom("compact"), atom("ack"), ids,
+                                         std::move(*t));
+              }
+              else
+              {
+                VAST_LOG_ERROR("failed to compact segments: " <<
+                               t.failure().msg());
+                sender << make_any_tuple(atom("compact"), atom("nack"), ids);
+              }
+            });
+      },
+      on(atom("retire"), arg_match) >> [=](std::vector<uuid> const& ids)
+      {
+        for (auto& id : ids)
+        {
+          segment_manager_.erase(id);
+          if (reads_.count(id))
+            retired_.insert(id);
+          else
+            remove(id);
+        }
+      },
+      on(atom("statistics")) >> [=]
+      {
+        auto& cache = segment_manager_.cache();
+        auto& stats = cache.stats();
+        return make_any_tuple(
+            atom("statistics"),
+            stats.hits, stats.misses, stats.evictions, stats.rejections,
+            uint64_t{cache.weight()}, uint64_t{cache.size()});
       });
 }
 
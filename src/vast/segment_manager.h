@@ -1,55 +1,218 @@
 #ifndef VAST_SEGMENT_MANAGER_H
 #define VAST_SEGMENT_MANAGER_H
 
+#include <chrono>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "vast/actor.h"
 #include "vast/cow.h"
 #include "vast/file_system.h"
 #include "vast/uuid.h"
 #include "vast/util/lru_cache.h"
+#include "vast/util/trial.h"
 
 namespace vast {
 
 class segment;
+namespace util { class thread_pool; }
 
-/// Manages the segments on disk an in-memory segments in a LRU fashion.
+/// Determines when the segment manager flushes a new segment to disk.
+enum class durability
+{
+  none,     ///< Leaves flushing to the operating system.
+  segment,  ///< Flushes each segment on its own.
+  group     ///< Flushes all segments written within a time window together.
+};
+
+/// Manages the segments on disk an in-memory segments in a LRU fashion. The
+/// cache has a budget in bytes, as measured by segment::bytes, and a
+/// configurable replacement policy. Segments larger than the entire budget
+/// bypass the cache rather than displacing all others. The segments loaded
+/// from disk are memory mappings of their files. The file of a segment has
+/// the segment's UUID as name, so that the manager does not need to know the
+/// directory contents in advance.
+///
+/// Only ::write, ::commit, and ::read touch the file system. They are safe to
+/// call from any thread, which allows for performing the I/O outside of the
+/// thread owning the cache.
+///
+/// A segment file never appears half-written: the manager writes a segment
+/// into a temporary file first and then renames it. Depending on the
+/// ::durability, it flushes the temporary file and the directory around the
+/// rename, so that the segment also survives a crash.
 class segment_manager
 {
 public:
   /// Constructs a segment manager.
   ///
-  /// @param capacity The number of segments to keep in memory until old ones
-  /// should be evicted.
+  /// @param capacity The number of bytes of segments to keep in memory until
+  /// old ones should be evicted.
   ///
   /// @param dir The directory with the segments.
-  segment_manager(size_t capacity, path dir);
+  ///
+  /// @param policy The replacement policy of the cache.
+  segment_manager(size_t capacity, path dir,
+                  util::cache_policy policy = util::cache_policy::lru);
 
   /// Records a given segment to disk and puts it in the cache.
   /// @param cs The segment to store.
   /// @returns `true` on success.
   bool store(cow<segment> const& cs);
 
-  /// Retrieves a segment.
+  /// Retrieves a segment, reading it from disk on a cache miss.
   /// @param id The ID of the segment to retrieve.
-  /// @return The segment with ID *id*.
+  /// @return The segment with ID *id*, which is empty if reading failed.
   cow<segment> lookup(uuid const& id);
 
+  /// Writes a segment to disk without touching the cache.
+  ///
+  /// @param s The segment to write.
+  ///
+  /// @param d The durability of the write. With durability::group, the
+  /// segment remains in its temporary file until a ::commit.
+  ///
+  /// @returns `nothing` on success.
+  trial<nothing> write(segment const& s,
+                       durability d = durability::segment) const;
+
+  /// Flushes a group of segments written with durability::group and moves
+  /// them to their final location.
+  /// @param ids The IDs of the segments to commit.
+  /// @returns `nothing` on success.
+  trial<nothing> commit(std::vector<uuid> const& ids) const;
+
+  /// Reads a segment from disk without touching the cache.
+  /// @param id The ID of the segment to read.
+  /// @returns The segment with ID *id*.
+  trial<cow<segment>> read(uuid const& id) const;
+
+  /// Puts a new segment into the cache.
+  /// @param cs The segment to insert.
+  /// @pre The cache does not contain *cs*.
+  void insert(cow<segment> const& cs);
+
+  /// Looks up a segment in the cache only.
+  /// @param id The ID of the segment to look up.
+  /// @returns A pointer to the cached segment or `nullptr` on a cache miss.
+  cow<segment> const* find(uuid const& id);
+
+  /// Hands a segment obtained via ::read after a cache miss to the cache,
+  /// which keeps it unless the admission filter rejects it.
+  /// @param cs The segment to admit.
+  void admit(cow<segment> const& cs);
+
+  /// Drops a segment from the cache.
+  /// @param id The ID of the segment to drop.
+  void erase(uuid const& id);
+
+  /// Merges segments with adjacent event ID ranges into a new segment and
+  /// writes it to disk, leaving the original segments untouched.
+  ///
+  /// @param id The ID of the merged segment.
+  ///
+  /// @param ids The IDs of the segments to merge, ordered by event ID.
+  ///
+  /// @param max_events_per_chunk The maximum number of events per chunk of
+  /// the merged segment.
+  ///
+  /// @param d The durability of the write.
+  ///
+  /// @returns The merged segment.
+  trial<segment> compact(uuid const& id, std::vector<uuid> const& ids,
+                         size_t max_events_per_chunk, durability d) const;
+
+  /// Deletes the file of a segment.
+  /// @param id The ID of the segment to delete.
+  /// @returns `true` on success.
+  bool remove(uuid const& id) const;
+
+  /// The cache of in-memory segments.
+  using cache_type = util::lru_cache<uuid, cow<segment>>;
+
+  /// Retrieves the segment cache, e.g., to inspect its statistics.
+  /// @returns The cache of in-memory segments.
+  cache_type const& cache() const;
+
 private:
-  cow<segment> on_miss(uuid const& id);
+  path filename(uuid const& id) const;
+  path temporary(uuid const& id) const;
 
   path const dir_;
-  util::lru_cache<uuid, cow<segment>> cache_;
-  std::unordered_map<uuid, path> segment_files_;
+  cache_type cache_;
 };
 
+/// Serves the segments of a ::segment_manager. A pool of I/O threads writes
+/// new segments and reads missing ones, so that the actor keeps answering
+/// cache hits while the disk is busy. Concurrent requests for the same
+/// missing segment share a single read. If the read fails, the actor answers
+/// the waiting sinks with `no segment` and the segment ID. The actor
+/// acknowledges a new segment once it is as durable as configured.
+///
+/// On request of the archive, the actor merges small segments on the I/O
+/// threads. Once the archive refers to the merged segment, it retires the
+/// original ones, whose files the actor deletes as soon as no read needs
+/// them anymore.
 struct segment_manager_actor : actor<segment_manager_actor>
 {
-  segment_manager_actor(size_t capacity, path dir);
+  /// Spawns a segment manager actor.
+  ///
+  /// @param capacity The number of bytes of segments to keep in memory.
+  ///
+  /// @param dir The directory with the segments.
+  ///
+  /// @param policy The replacement policy of the cache.
+  ///
+  /// @param io_threads The number of threads performing file I/O.
+  ///
+  /// @param d The durability of new segments.
+  ///
+  /// @param window The time span within which durability::group collects
+  /// segments before flushing them together.
+  segment_manager_actor(
+      size_t capacity, path dir,
+      util::cache_policy policy = util::cache_policy::lru,
+      size_t io_threads = 4,
+      durability d = durability::segment,
+      std::chrono::milliseconds window = std::chrono::milliseconds{50});
 
   void act();
   char const* description() const;
 
+  // Reads a segment on one of the I/O threads.
+  void load(uuid const& id);
+
+  // Deletes the file of a segment on one of the I/O threads.
+  void remove(uuid const& id);
+
+  // The sinks waiting for a segment along with the slot which receives the
+  // segment from the I/O thread reading it.
+  struct pending_read
+  {
+    std::shared_ptr<cow<segment>> slot;
+    std::vector<cppa::actor_ptr> sinks;
+  };
+
   segment_manager segment_manager_;
+  durability durability_;
+  std::chrono::milliseconds window_;
+  std::unordered_map<uuid, pending_read> reads_;
+
+  // The segments not yet at their final location, which a read must wait
+  // for.
+  std::unordered_set<uuid> writing_;
+
+  // The segments awaiting the next group commit along with the actors to
+  // acknowledge them to.
+  std::vector<std::pair<uuid, cppa::actor_ptr>> group_;
+
+  // The retired segments with a pending read.
+  std::unordered_set<uuid> retired_;
+
+  // Declared last so that destruction joins the I/O threads before the
+  // segment manager goes away.
+  std::unique_ptr<util::thread_pool> io_;
 };
 
 } // namespace vast
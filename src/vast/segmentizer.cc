@@ -1,5 +1,7 @@
 #include "vast/segmentizer.h"
 
+#include <algorithm>
+#include <limits>
 #include <cppa/cppa.hpp>
 #include "vast/event.h"
 #include "vast/logger.h"
@@ -9,11 +11,19 @@ namespace vast {
 using namespace cppa;
 
 segmentizer::segmentizer(actor_ptr upstream,
-                         size_t max_events_per_chunk, size_t max_segment_size)
+                         size_t max_events_per_chunk, size_t max_segment_size,
+                         uint64_t credit, size_t max_inflight_segments,
+                         segment::layout chunk_layout,
+                         io::compression method,
+                         io::compression_policy policy,
+                         std::shared_ptr<util::thread_pool> pool)
   : upstream_{upstream},
+    credit_{credit > 0 ? credit : std::numeric_limits<uint64_t>::max()},
+    max_inflight_segments_{max_inflight_segments},
     stats_{std::chrono::seconds(1)},
-    segment_{uuid::random(), max_segment_size},
-    writer_{&segment_, max_events_per_chunk}
+    segment_{uuid::random(), max_segment_size, method},
+    writer_{&segment_, max_events_per_chunk, chunk_layout, policy,
+            std::move(pool)}
 {
 }
 
@@ -25,14 +35,8 @@ void segmentizer::act()
   become(
       on(atom("EXIT"), arg_match) >> [=](uint32_t reason)
       {
-        if (! writer_.flush())
-        {
-          segment_ = segment{uuid::random()};
-          writer_.attach_to(&segment_);
-          if (! writer_.flush())
-            VAST_LOG_ACTOR_ERROR("failed to flush a fresh segment");
-          assert(segment_.events() > 0);
-        }
+        while (! writer_.flush())
+          rotate();
 
         if (segment_.events() > 0)
         {
@@ -40,14 +44,50 @@ void segmentizer::act()
               "sends final segment " << segment_.id() << " with " <<
               segment_.events() << " events to " << VAST_ACTOR_ID(upstream_));
 
+          ++total_segments_;
           send(upstream_, std::move(segment_));
         }
 
+        send(upstream_, atom("statistics"), atom("segmentize"),
+             total_events_, total_segments_);
+
         if (total_events_ > 0)
           VAST_LOG_ACTOR_VERBOSE("processed " << total_events_ << " events");
 
         quit(reason);
       },
+      on(atom("source"), arg_match) >> [=](actor_ptr source)
+      {
+        VAST_LOG_ACTOR_DEBUG("grants " << VAST_ACTOR_ID(source) <<
+                             " initial credit of " << credit_ << " events");
+        monitor(source);
+        sources_.emplace_back(source, 0);
+        send(source, atom("credit"), credit_);
+      },
+      on(atom("DOWN"), arg_match) >> [=](uint32_t /* reason */)
+      {
+        // A terminated source takes no more credit.
+        auto sender = last_sender();
+        auto i = std::find_if(
+            sources_.begin(),
+            sources_.end(),
+            [&](std::pair<actor_ptr, uint64_t> const& p)
+            {
+              return p.first == sender;
+            });
+
+        if (i != sources_.end())
+        {
+          VAST_LOG_ACTOR_DEBUG("removes terminated source " <<
+                               VAST_ACTOR_ID(sender));
+          sources_.erase(i);
+        }
+      },
+      on(atom("ack"), arg_match) >> [=](uuid const& id)
+      {
+        if (inflight_.erase(id) > 0)
+          grant();
+      },
       on_arg_match >> [=](std::vector<event> const& v)
       {
         total_events_ += v.size();
@@ -58,7 +98,8 @@ void segmentizer::act()
           {
             if (stats_.increment())
             {
-              send(upstream_, atom("statistics"), stats_.last());
+              send(upstream_, atom("statistics"), atom("segmentize"),
+                   total_events_, total_segments_);
               VAST_LOG_ACTOR_VERBOSE(
                   "ingests at rate " << stats_.last() << " events/sec" <<
                   " (mean " << stats_.mean() <<
@@ -68,22 +109,13 @@ void segmentizer::act()
           }
           else
           {
-            VAST_LOG_ACTOR_DEBUG("sends segment " << segment_.id() <<
-                                 " with " << segment_.events() <<
-                                 " events to " << VAST_ACTOR_ID(upstream_));
-
-            auto max_segment_size = segment_.max_bytes();
-            send(upstream_, std::move(segment_));
-            segment_ = segment{uuid::random(), max_segment_size};
-
-            writer_.attach_to(&segment_);
-
-            if (! writer_.flush())
+            // The writer may hold on to more chunks than a single segment
+            // takes.
+            do
             {
-              VAST_LOG_ACTOR_ERROR("failed to flush chunk to fresh segment");
-              quit(exit::error);
-              return;
+              rotate();
             }
+            while (! writer_.flush());
 
             if (! writer_.write(e))
             {
@@ -93,6 +125,16 @@ void segmentizer::act()
             }
           }
         }
+
+        // Return the credit for the events we just wrote.
+        auto sender = last_sender();
+        for (auto& p : sources_)
+          if (p.first == sender)
+          {
+            p.second += v.size();
+            grant();
+            break;
+          }
       },
       others() >> [=]
       {
@@ -102,6 +144,43 @@ void segmentizer::act()
       });
 }
 
+void segmentizer::rotate()
+{
+  auto max_segment_size = segment_.max_bytes();
+  auto method = segment_.compression();
+  if (segment_.events() > 0)
+  {
+    VAST_LOG_ACTOR_DEBUG("sends segment " << segment_.id() <<
+                         " with " << segment_.events() <<
+                         " events to " << VAST_ACTOR_ID(upstream_));
+
+    inflight_.insert(segment_.id());
+    ++total_segments_;
+    send(upstream_, std::move(segment_));
+  }
+
+  segment_ = segment{uuid::random(), max_segment_size, method};
+  writer_.attach_to(&segment_);
+}
+
+void segmentizer::grant()
+{
+  if (max_inflight_segments_ > 0
+      && inflight_.size() >= max_inflight_segments_)
+  {
+    VAST_LOG_ACTOR_DEBUG("withholds credit until upstream acknowledges " <<
+                         inflight_.size() << " segments");
+    return;
+  }
+
+  for (auto& p : sources_)
+    if (p.second > 0)
+    {
+      send(p.first, atom("credit"), p.second);
+      p.second = 0;
+    }
+}
+
 char const* segmentizer::description() const
 {
   return "segmentizer";
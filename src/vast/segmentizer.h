@@ -1,6 +1,7 @@
 #ifndef VAST_SEGMENTIZER_H
 #define VAST_SEGMENTIZER_H
 
+#include <set>
 #include "vast/actor.h"
 #include "vast/segment.h"
 #include "vast/util/accumulator.h"
@@ -9,6 +10,16 @@ namespace vast {
 
 /// Receives events from sources, writes them into segments, and then relays
 /// them upstream.
+///
+/// The segmentizer controls the rate of its sources with credit: a registered
+/// source may send as many events as it has credit, and the segmentizer
+/// returns the credit once it has written the events. If too many segments
+/// have not yet been acknowledged upstream, the segmentizer withholds the
+/// credit until the next ACK arrives. The segmentizer monitors its sources
+/// and forgets a source once it terminates.
+///
+/// Once per second, the segmentizer reports the number of events and
+/// segments it has processed so far to its upstream actor.
 class segmentizer : public actor<segmentizer>
 {
 public:
@@ -21,18 +32,50 @@ public:
   ///
   /// @param max_segment_size The maximum number of bytes to put in a single
   /// segment.
+  ///
+  /// @param credit The number of events a source may send ahead of the
+  /// segmentizer. If 0, sources have unlimited credit.
+  ///
+  /// @param max_inflight_segments The maximum number of segments sent
+  /// upstream but not yet acknowledged before the segmentizer withholds
+  /// credit. If 0, the segmentizer does not wait for acknowledgements.
+  ///
+  /// @param chunk_layout The layout of the chunks to write.
+  ///
+  /// @param method The compression method of the chunks.
+  ///
+  /// @param policy The objective by which to select the compression method
+  /// of each chunk if *method* is io::automatic.
+  ///
+  /// @param pool The threads to compress chunks on. If `nullptr`, the
+  /// segmentizer compresses chunks itself.
   segmentizer(cppa::actor_ptr upstream,
-              size_t max_events_per_chunk, size_t max_segment_size);
+              size_t max_events_per_chunk, size_t max_segment_size,
+              uint64_t credit = 0, size_t max_inflight_segments = 0,
+              segment::layout chunk_layout = segment::row,
+              io::compression method = io::lz4,
+              io::compression_policy policy = io::balanced,
+              std::shared_ptr<util::thread_pool> pool = nullptr);
 
   void act();
   char const* description() const;
 
 private:
+  // Sends the current segment upstream and attaches the writer to a new one.
+  void rotate();
+
+  void grant();
+
   cppa::actor_ptr upstream_;
+  uint64_t credit_;
+  size_t max_inflight_segments_;
+  std::vector<std::pair<cppa::actor_ptr, uint64_t>> sources_;
+  std::set<uuid> inflight_;
   util::rate_accumulator<uint64_t> stats_;
   segment segment_;
   segment::writer writer_;
-  size_t total_events_ = 0;
+  uint64_t total_events_ = 0;
+  uint64_t total_segments_ = 0;
 };
 
 } // namespace vast
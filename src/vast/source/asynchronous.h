@@ -2,6 +2,8 @@
 #define VAST_SOURCE_ASYNCHRONOUS_H
 
 #include <cassert>
+#include <chrono>
+#include <limits>
 #include <cppa/cppa.hpp>
 #include "vast/event.h"
 
@@ -10,12 +12,17 @@ namespace source {
 
 /// An asynchronous source that buffers and relays events in batches.
 /// Any child deriving from this class must be an actor.
+///
+/// Like a synchronous source, an asynchronous source only relays events as
+/// long as it has credit from its sink via `atom("credit")`. Children that
+/// generate events themselves should check has_credit() before producing
+/// more of them.
 template <typename Derived>
 class asynchronous : public cppa::event_based_actor
 {
 public:
   /// Spawns an asynchronous source.
-  asynchronous(actor_ptr sink, size_t batch_size = 0)
+  asynchronous(cppa::actor_ptr sink, size_t batch_size = 0)
     : sink_(sink),
       batch_size_(batch_size)
   {
@@ -25,16 +32,18 @@ public:
         {
           batch_size_ = batch_size;
         },
+        on(atom("statistics"), arg_match) >> [=](actor_ptr reporter)
+        {
+          reporter_ = reporter;
+        },
+        on(atom("credit"), arg_match) >> [=](uint64_t credit)
+        {
+          auto max = std::numeric_limits<uint64_t>::max();
+          credit_ = credit > max - credit_ ? max : credit_ + credit;
+        },
         on_arg_match >> [=](event& e)
         {
-          assert(sink_);
-          if (batch_size_ == 0)
-          {
-            send(sink_, std::move(e));
-            return;
-          }
-          this->events_.push_back(std::move(e));
-          send_events();
+          relay(std::move(e));
         },
         on_arg_match >> [=](std::vector<event> v)
         {
@@ -42,9 +51,6 @@ public:
           events_.insert(events_.end(),
               std::make_move_iterator(v.begin()),
               std::make_move_iterator(v.end()));
-          std::inplace_merge(events_.begin(),
-                             events_.begin() + events_.size(),
-                             events_.end());
           send_events();
         });
   }
@@ -55,18 +61,69 @@ public:
     become(operating_.or_else(static_cast<Derived*>(this)->impl_));
   }
 
+  /// Buffers an event and relays the buffer once it reached the batch size.
+  /// @param e The event to relay.
+  void relay(event e)
+  {
+    assert(sink_);
+    events_.push_back(std::move(e));
+    send_events();
+  }
+
+  /// Relays all buffered events if the buffer reached the batch size.
   void send_events()
   {
     if (events_.size() < batch_size_)
       return;
+
+    flush();
+  }
+
+  /// Relays all buffered events regardless of the batch size.
+  void flush()
+  {
+    if (events_.empty())
+      return;
+
+    credit_ -= std::min<uint64_t>(credit_, events_.size());
+    total_events_ += events_.size();
     send(sink_, std::move(this->events_));
     this->events_.clear();
+    report();
+  }
+
+  /// Checks whether the sink permits more events than the source has
+  /// buffered.
+  /// @returns `true` if the source may generate more events.
+  bool has_credit() const
+  {
+    return credit_ > events_.size();
   }
 
 private:
+  // Sends the number of events relayed so far to the reporter, at most once
+  // per second.
+  void report()
+  {
+    if (! reporter_)
+      return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report_ < std::chrono::seconds(1))
+      return;
+
+    last_report_ = now;
+    send(reporter_, cppa::atom("statistics"), cppa::atom("parse"),
+         total_events_);
+  }
+
   cppa::actor_ptr sink_;
   size_t batch_size_ = 0;
+  uint64_t credit_ = 0;
   std::vector<event> events_;
+  cppa::actor_ptr reporter_;
+  uint64_t total_events_ = 0;
+  std::chrono::steady_clock::time_point last_report_;
   cppa::partial_function operating_;
 };
 
@@ -0,0 +1,597 @@
+#include "vast/source/bro2_parser.h"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include "vast/event_type_registry.h"
+#include "vast/logger.h"
+#include "vast/util/field_splitter.h"
+#include "vast/util/monotonic_arena.h"
+
+namespace vast {
+namespace source {
+
+namespace {
+
+// Converts a Bro type to a VAST type.
+value_type bro_to_vast(string const& type)
+{
+  if (type == "enum" || type == "string" || type == "file")
+    return string_value;
+  else if (type == "bool")
+    return bool_value;
+  else if (type == "int")
+    return int_value;
+  else if (type == "count")
+    return uint_value;
+  else if (type == "double")
+    return double_value;
+  else if (type == "interval")
+    return time_range_value;
+  else if (type == "time")
+    return time_point_value;
+  else if (type == "addr")
+    return address_value;
+  else if (type == "port")
+    return port_value;
+  else if (type == "pattern")
+    return regex_value;
+  else if (type == "subnet")
+    return prefix_value;
+  else if (type.starts_with("record"))
+    return record_value;
+  else if (type.starts_with("vector"))
+    return vector_value;
+  else if (type.starts_with("set"))
+    return set_value;
+  else if (type.starts_with("table"))
+    return table_value;
+  else
+    return invalid_value;
+}
+
+// Checks whether a field equals a header string, e.g., the unset field.
+bool field_equals(char const* start, char const* end, string const& str)
+{
+  auto size = static_cast<size_t>(end - start);
+  return size == str.size() && std::memcmp(start, str.data(), size) == 0;
+}
+
+// Consumes a sequence of decimal digits. Fails if the number does not fit
+// into 64 bits.
+bool parse_digits(char const*& p, char const* end, uint64_t& x)
+{
+  auto start = p;
+  x = 0;
+  while (p != end && *p >= '0' && *p <= '9')
+  {
+    uint64_t d = *p++ - '0';
+    if (x > (std::numeric_limits<uint64_t>::max() - d) / 10)
+      return false;
+
+    x = x * 10 + d;
+  }
+
+  return p != start;
+}
+
+// Checks whether a magnitude fits into a signed 64-bit integer.
+bool fits_int64(uint64_t x, bool negative)
+{
+  auto max = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+  return x <= (negative ? max + 1 : max);
+}
+
+// Negates a magnitude which passed ::fits_int64 without overflowing.
+int64_t to_int64(uint64_t x, bool negative)
+{
+  return negative ? static_cast<int64_t>(0 - x) : static_cast<int64_t>(x);
+}
+
+// Parses Bro's fixed-point representation of seconds, e.g., 1258531221.4865,
+// into nanoseconds.
+bool parse_nanoseconds(char const* p, char const* end, int64_t& ns)
+{
+  auto negative = p != end && *p == '-';
+  if (negative)
+    ++p;
+
+  uint64_t secs;
+  if (! parse_digits(p, end, secs))
+    return false;
+
+  uint64_t frac = 0;
+  auto digits = 0;
+  if (p != end && *p == '.')
+    for (++p; p != end && *p >= '0' && *p <= '9'; ++p)
+      if (digits < 9)
+      {
+        frac = frac * 10 + (*p - '0');
+        ++digits;
+      }
+
+  if (p != end)
+    return false;
+
+  while (digits++ < 9)
+    frac *= 10;
+
+  // With at most 9223372036 seconds, the sum stays far below 2^64 and only
+  // the signed range remains to check.
+  if (secs > std::numeric_limits<int64_t>::max() / 1000000000ull)
+    return false;
+
+  auto x = secs * 1000000000ull + frac;
+  if (! fits_int64(x, negative))
+    return false;
+
+  ns = to_int64(x, negative);
+  return true;
+}
+
+// The fast field parsers below handle the representation Bro writes. If they
+// return false, the caller falls back to the generic value parser which
+// handles all other forms and reports errors.
+
+bool parse_bool(char const* start, char const* end, value& v)
+{
+  if (end - start != 1 || (*start != 'T' && *start != 'F'))
+    return false;
+
+  v = *start == 'T';
+  return true;
+}
+
+bool parse_int(char const* start, char const* end, value& v)
+{
+  auto p = start;
+  auto negative = p != end && *p == '-';
+  if (negative || (p != end && *p == '+'))
+    ++p;
+
+  uint64_t x;
+  if (! parse_digits(p, end, x) || p != end || ! fits_int64(x, negative))
+    return false;
+
+  v = to_int64(x, negative);
+  return true;
+}
+
+bool parse_count(char const* start, char const* end, value& v)
+{
+  auto p = start;
+  uint64_t x;
+  if (! parse_digits(p, end, x) || p != end)
+    return false;
+
+  v = x;
+  return true;
+}
+
+bool parse_double(char const* start, char const* end, value& v)
+{
+  // A mantissa below 2^53 divided by an exact power of ten yields the
+  // correctly rounded result. Everything else goes through strtod.
+  static double const powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+    1e14, 1e15};
+
+  auto p = start;
+  auto negative = p != end && *p == '-';
+  if (negative)
+    ++p;
+
+  uint64_t mantissa = 0;
+  auto digits = 0;
+  auto decimals = 0;
+  auto dot = false;
+  for (; p != end; ++p)
+  {
+    if (*p >= '0' && *p <= '9')
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      ++digits;
+      if (dot)
+        ++decimals;
+    }
+    else if (*p == '.' && ! dot)
+    {
+      dot = true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  if (digits == 0 || digits > 15)
+    return false;
+
+  auto d = static_cast<double>(mantissa) / powers[decimals];
+  v = negative ? -d : d;
+  return true;
+}
+
+bool parse_interval(char const* start, char const* end, value& v)
+{
+  int64_t ns;
+  if (! parse_nanoseconds(start, end, ns))
+    return false;
+
+  v = time_range::nanoseconds(ns);
+  return true;
+}
+
+bool parse_time(char const* start, char const* end, value& v)
+{
+  int64_t ns;
+  if (! parse_nanoseconds(start, end, ns))
+    return false;
+
+  v = time_point{time_range::nanoseconds(ns)};
+  return true;
+}
+
+bool parse_string(char const* start, char const* end, value& v)
+{
+  auto size = static_cast<size_t>(end - start);
+  if (std::memchr(start, '\\', size))
+    v = string{start, end}.unescape();
+  else
+    v = value{start, size};
+
+  return true;
+}
+
+bool parse_address(char const* start, char const* end, value& v)
+{
+  if (std::memchr(start, ':', end - start))
+  {
+    char buf[64];
+    auto size = static_cast<size_t>(end - start);
+    if (size >= sizeof(buf))
+      return false;
+
+    std::memcpy(buf, start, size);
+    buf[size] = '\0';
+    auto a = address::from_v6(buf);
+    if (! a)
+      return false;
+
+    v = std::move(*a);
+    return true;
+  }
+
+  uint32_t bytes = 0;
+  auto p = start;
+  for (auto i = 0; i < 4; ++i)
+  {
+    if (i > 0 && (p == end || *p++ != '.'))
+      return false;
+
+    auto first = p;
+    uint64_t octet;
+    if (! parse_digits(p, end, octet) || p - first > 3 || octet > 255)
+      return false;
+
+    bytes = (bytes << 8) | static_cast<uint32_t>(octet);
+  }
+
+  if (p != end)
+    return false;
+
+  v = address{&bytes, address::ipv4, address::host};
+  return true;
+}
+
+bool parse_port(char const* start, char const* end, value& v)
+{
+  auto p = start;
+  uint64_t x;
+  if (! parse_digits(p, end, x) || p != end || x > 65535)
+    return false;
+
+  v = port{static_cast<port::number_type>(x)};
+  return true;
+}
+
+// Selects the parser for a column of a given type. Types without a fast
+// parser go through the generic value parser.
+bro2_parser::field_parser make_field_parser(value_type type)
+{
+  switch (type)
+  {
+    case bool_value:
+      return parse_bool;
+    case int_value:
+      return parse_int;
+    case uint_value:
+      return parse_count;
+    case double_value:
+      return parse_double;
+    case time_range_value:
+      return parse_interval;
+    case time_point_value:
+      return parse_time;
+    case string_value:
+      return parse_string;
+    case address_value:
+      return parse_address;
+    case port_value:
+      return parse_port;
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace <anonymous>
+
+bro2_parser::bro2_parser(int32_t timestamp_field)
+  : timestamp_field_{timestamp_field}
+{
+}
+
+result<event> bro2_parser::parse(char const* first, char const* last)
+{
+  if (first == last)
+    return {};
+
+  if (*first == '#')
+  {
+    static char const restart[] = "#separator";
+    auto size = sizeof(restart) - 1;
+    if (header_lines_ > 0
+        && static_cast<size_t>(last - first) >= size
+        && std::memcmp(first, restart, size) == 0)
+    {
+      VAST_LOG_VERBOSE("bro2 parser restarts with new log");
+      reset();
+    }
+    else if (ready())
+    {
+      VAST_LOG_VERBOSE("bro2 parser ignores comment: " <<
+                       std::string(first, last));
+      return {};
+    }
+  }
+
+  if (! ready())
+  {
+    auto t = parse_header(first, last);
+    if (! t)
+      return t.failure();
+
+    return {};
+  }
+
+  auto e = make_event(first, last);
+  if (! e)
+    return e.failure();
+
+  return std::move(*e);
+}
+
+trial<event> bro2_parser::make_event(char const* first,
+                                     char const* last) const
+{
+  assert(ready());
+  util::field_splitter<char const*> fs{separator_.data(), separator_.size()};
+  fs.split(first, last);
+  if (fs.fields() != field_types_.size())
+    return error{"inconsistent number of fields: expected " +
+                 to_string(field_types_.size()) + ", got " +
+                 to_string(fs.fields())};
+
+  event e;
+  e.reserve(field_types_.size());
+  e.type(type_);
+  e.timestamp(now());
+  size_t containers = 0;
+  for (size_t f = 0; f < fs.fields(); ++f)
+  {
+    auto start = fs.start(f);
+    auto end = fs.end(f);
+
+    // Check whether the field is set or empty. (Not '-' and "(empty)" by
+    // default.)
+    if (field_equals(start, end, unset_field_)
+        || field_equals(start, end, empty_field_))
+    {
+      e.emplace_back(field_types_[f]);
+      continue;
+    }
+
+    if (field_types_[f] == record_value)
+    {
+      record r;
+      if (! extract(start, end, r, complex_types_[containers++],
+                    set_separator_, "{", "}"))
+        return error{"got invalid record syntax"};
+
+      e.emplace_back(std::move(r));
+    }
+    else if (field_types_[f] == vector_value)
+    {
+      vector v;
+      if (! extract(start, end, v, complex_types_[containers++],
+                    set_separator_, "{", "}"))
+        return error{"got invalid vector syntax"};
+
+      e.emplace_back(std::move(v));
+    }
+    else if (field_types_[f] == set_value || field_types_[f] == table_value)
+    {
+      set s;
+      if (! extract(start, end, s, complex_types_[containers++],
+                    set_separator_, "{", "}"))
+        return error{"got invalid set/table syntax"};
+
+      e.emplace_back(std::move(s));
+    }
+    else
+    {
+      value v;
+      auto parse = field_parsers_[f];
+      if (! (parse && parse(start, end, v))
+          && ! extract(start, end, v, field_types_[f]))
+        return error{"could not parse field: " + std::string{start, end}};
+
+      if (f == static_cast<size_t>(timestamp_field_)
+          && v.which() == time_point_value)
+        e.timestamp(v.get<time_point>());
+
+      e.push_back(std::move(v));
+    }
+  }
+
+  return std::move(e);
+}
+
+bool bro2_parser::ready() const
+{
+  return header_lines_ == 8;
+}
+
+trial<nothing> bro2_parser::parse_header(char const* first, char const* last)
+{
+  // The header outlives the batch whose arena the caller may allocate from.
+  util::arena_scope heap{nullptr};
+
+  util::field_splitter<char const*> fs{separator_.data(), separator_.size()};
+  fs.split(first, last);
+
+  switch (header_lines_++)
+  {
+    default:
+      assert(! "header already complete");
+      break;
+    case 0:
+      {
+        if (fs.fields() != 2 || ! fs.equals(0, "#separator"))
+          return error{"got invalid #separator"};
+
+        std::string sep;
+        std::string bro_sep(fs.start(1), fs.end(1));
+        std::string::size_type pos = 0;
+        while (pos != std::string::npos)
+        {
+          pos = bro_sep.find("\\x", pos);
+          if (pos != std::string::npos)
+          {
+            auto i = std::stoi(bro_sep.substr(pos + 2, 2), nullptr, 16);
+            assert(i >= 0 && i <= 255);
+            sep.push_back(i);
+            pos += 2;
+          }
+        }
+
+        separator_ = string{sep.begin(), sep.end()};
+      }
+      break;
+    case 1:
+      if (fs.fields() != 2 || ! fs.equals(0, "#set_separator"))
+        return error{"got invalid #set_separator"};
+
+      set_separator_ = string{fs.start(1), fs.end(1)};
+      break;
+    case 2:
+      if (fs.fields() != 2 || ! fs.equals(0, "#empty_field"))
+        return error{"invalid #empty_field"};
+
+      empty_field_ = string{fs.start(1), fs.end(1)};
+      break;
+    case 3:
+      if (fs.fields() != 2 || ! fs.equals(0, "#unset_field"))
+        return error{"invalid #unset_field"};
+
+      unset_field_ = string{fs.start(1), fs.end(1)};
+      break;
+    case 4:
+      if (fs.fields() != 2 || ! fs.equals(0, "#path"))
+        return error{"invalid #path"};
+
+      path_ = "bro::" + string(fs.start(1), fs.end(1));
+      type_ = event_type_registry::instance()->intern(path_);
+      break;
+    case 5:
+      // Skip #open tag.
+      break;
+    case 6:
+      if (! fs.equals(0, "#fields"))
+        return error{"got invalid #fields"};
+
+      for (size_t i = 1; i < fs.fields(); ++i)
+        field_names_.emplace_back(fs.start(i), fs.end(i));
+      break;
+    case 7:
+      {
+        if (! fs.equals(0, "#types"))
+          return error{"got invalid #types"};
+
+        for (size_t i = 1; i < fs.fields(); ++i)
+        {
+          string t(fs.start(i), fs.end(i));
+          auto type = bro_to_vast(t);
+          field_types_.push_back(type);
+          field_parsers_.push_back(make_field_parser(type));
+          if (is_container(type))
+          {
+            auto open = t.find("[");
+            assert(open != string::npos);
+            auto close = t.find("]", open);
+            assert(close != string::npos);
+            auto elem = t.substr(open + 1, close - open - 1);
+            complex_types_.push_back(bro_to_vast(elem));
+          }
+        }
+
+        if (field_names_.size() != field_types_.size())
+          return error{"got inconsistent #fields and #types"};
+
+        VAST_LOG_DEBUG("parsed bro2 header:");
+        VAST_LOG_DEBUG("    #separator " << separator_);
+        VAST_LOG_DEBUG("    #set_separator " << set_separator_);
+        VAST_LOG_DEBUG("    #empty_field " << empty_field_);
+        VAST_LOG_DEBUG("    #unset_field " << unset_field_);
+        VAST_LOG_DEBUG("    #path " << path_);
+        VAST_LOG_DEBUG("  fields:");
+        for (size_t i = 0; i < field_names_.size(); ++i)
+          VAST_LOG_DEBUG("    " << i << ") " << field_names_[i] <<
+                         " (" << field_types_[i] << ')');
+
+        if (timestamp_field_ > -1)
+        {
+          VAST_LOG_VERBOSE("attempts to extract timestamp from field " <<
+                           timestamp_field_);
+        }
+        else
+        {
+          for (size_t i = 0; i < field_types_.size(); ++i)
+            if (field_types_[i] == time_point_value)
+            {
+              VAST_LOG_VERBOSE("auto-detected field " << i <<
+                               " as event timestamp");
+              timestamp_field_ = static_cast<int32_t>(i);
+              break;
+            }
+        }
+      }
+      break;
+  }
+
+  return nil;
+}
+
+void bro2_parser::reset()
+{
+  timestamp_field_ = -1;
+  header_lines_ = 0;
+  separator_ = " ";
+  field_names_.clear();
+  field_types_.clear();
+  field_parsers_.clear();
+  complex_types_.clear();
+}
+
+} // namespace source
+} // namespace vast
@@ -0,0 +1,72 @@
+#ifndef VAST_SOURCE_BRO2_PARSER_H
+#define VAST_SOURCE_BRO2_PARSER_H
+
+#include <vector>
+#include "vast/event.h"
+#include "vast/string.h"
+#include "vast/value_type.h"
+#include "vast/util/result.h"
+
+namespace vast {
+namespace source {
+
+/// Parses the lines of a Bro 2.x log into events. The parser first consumes
+/// the header of the log, which determines how to parse the subsequent lines.
+/// A new header in the middle of the input, as it occurs in concatenated logs,
+/// restarts the parser.
+class bro2_parser
+{
+public:
+  /// Parses a single field into a value of the type of its column.
+  /// @param start The beginning of the field.
+  /// @param end One past the end of the field.
+  /// @param v The value to assign the result to.
+  /// @returns `true` on success.
+  using field_parser = bool (*)(char const* start, char const* end, value& v);
+
+  /// Constructs a parser.
+  /// @param timestamp_field The field to extract the event timestamp from or
+  /// -1 for auto-detection.
+  bro2_parser(int32_t timestamp_field = -1);
+
+  /// Processes the next line of the log.
+  /// @param first The beginning of the line.
+  /// @param last One past the end of the line, without the line separator.
+  /// @returns The event of a data line, an empty result for header and
+  /// comment lines, or an error.
+  result<event> parse(char const* first, char const* last);
+
+  /// Parses a data line into an event. Since this function does not modify
+  /// the parser, multiple threads may invoke it concurrently.
+  /// @param first The beginning of the line.
+  /// @param last One past the end of the line, without the line separator.
+  /// @returns The event of the line.
+  /// @pre `ready()`
+  trial<event> make_event(char const* first, char const* last) const;
+
+  /// Checks whether the parser has processed a complete header.
+  /// @returns `true` *iff* the parser can process data lines.
+  bool ready() const;
+
+private:
+  trial<nothing> parse_header(char const* first, char const* last);
+  void reset();
+
+  int32_t timestamp_field_;
+  size_t header_lines_ = 0;
+  string separator_ = " ";
+  string set_separator_;
+  string empty_field_;
+  string unset_field_;
+  string path_;
+  event_type type_ = unnamed_event_type;
+  std::vector<string> field_names_;
+  std::vector<value_type> field_types_;
+  std::vector<field_parser> field_parsers_;
+  std::vector<value_type> complex_types_;
+};
+
+} // namespace source
+} // namespace vast
+
+#endif
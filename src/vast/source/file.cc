@@ -1,376 +1,167 @@
 #include "vast/source/file.h"
 
-#include "vast/util/field_splitter.h"
-#include "vast/schema.h"
+#include <algorithm>
+#include <cstring>
+#include "vast/util/monotonic_arena.h"
 
 namespace vast {
 namespace source {
 
 namespace {
 
-// Converts a Bro type to a VAST type.
-value_type bro_to_vast(string const& type)
-{
-  if (type == "enum" || type == "string" || type == "file")
-    return string_value;
-  else if (type == "bool")
-    return bool_value;
-  else if (type == "int")
-    return int_value;
-  else if (type == "count")
-    return uint_value;
-  else if (type == "double")
-    return double_value;
-  else if (type == "interval")
-    return time_range_value;
-  else if (type == "time")
-    return time_point_value;
-  else if (type == "addr")
-    return address_value;
-  else if (type == "port")
-    return port_value;
-  else if (type == "pattern")
-    return regex_value;
-  else if (type == "subnet")
-    return prefix_value;
-  else if (type.starts_with("record"))
-    return record_value;
-  else if (type.starts_with("vector"))
-    return vector_value;
-  else if (type.starts_with("set"))
-    return set_value;
-  else if (type.starts_with("table"))
-    return table_value;
-  else
-    return invalid_value;
-}
+// The number of bytes a single worker parses at once in parallel mode.
+size_t const parallel_block_size = 4 << 20;
 
 } // namespace <anonymous>
 
 bro2::bro2(cppa::actor_ptr sink, std::string const& filename,
-           int32_t timestamp_field)
+           int32_t timestamp_field, size_t threads)
   : line<bro2>{std::move(sink), filename},
-    timestamp_field_{timestamp_field}
+    parser_{timestamp_field},
+    threads_{threads > 0 ? threads : 1}
 {
 }
 
 result<event> bro2::extract_impl_impl()
 {
-  using vast::extract;
-
-  util::field_splitter<std::string::const_iterator>
-    fs{separator_.data(), separator_.size()};
+  if (parallel_)
+    return extract_parallel();
 
-  // We assume that each Bro log comes with more than zero field names.
-  // Consequently, if we have not yet recorded any field names, we still need
-  // to parse the header.
-  if (field_names_.empty())
+  while (true)
   {
     auto line = this->next();
     if (! line)
-      return error{"could not read first line of header"};
-
-    auto t = parse_header();
-    if (! t)
-      return t.failure();
-  }
-
-  auto line = this->next();
-  if (! line)
-    return {};
-
-  fs.split(line->begin(), line->end());
-  if (fs.fields() > 0 && *fs.start(0) == '#')
-  {
-    auto first = string{fs.start(0), fs.end(0)};
-    if (first.starts_with("#separator"))
     {
-      VAST_LOG_ACTOR_VERBOSE("restarts with new log");
-
-      timestamp_field_ = -1;
-      separator_ = " ";
-      field_names_.clear();
-      field_types_.clear();
-      complex_types_.clear();
-
-      auto t = parse_header();
-      if (! t)
-        return t.failure();
+      if (! parser_.ready())
+        return error{"could not read complete header"};
 
-      auto line = this->next();
-      if (! line)
-        return {};
-
-      fs = {separator_.data(), separator_.size()};
-      fs.split(line->begin(), line->end());
-    }
-    else
-    {
-      VAST_LOG_ACTOR_INFO("ignored comment at line " << number() <<
-                   ": " << *line);
       return {};
     }
-  }
-
-  if (fs.fields() != field_types_.size())
-    return error{"inconsistent number of fields at line " +
-                 to_string(number()) + ": expected " +
-                 to_string(field_types_.size()) + ", got " +
-//                 to_string(fs.fields())};
-                 to_string(fs.fields()) + " (" + *line + ')'};
-
-  event e;
-  e.name(path_);
-  e.timestamp(now());
-  size_t containers = 0;
-  for (size_t f = 0; f < fs.fields(); ++f)
-  {
-    auto start = fs.start(f);
-    auto end = fs.end(f);
-
-    // Check whether the field is set. (Not '-' by default.)
-    auto unset = true;
-    for (size_t i = 0; i < unset_field_.size(); ++i)
-    {
-      if (unset_field_[i] != *(start + i))
-      {
-        unset = false;
-        break;
-      }
-    }
-    if (unset)
-    {
-      e.emplace_back(field_types_[f]);
-      continue;
-    }
-
-    // Check whether the field is empty. (Not "(empty)" by default.)
-    auto empty = true;
-    for (size_t i = 0; i < empty_field_.size(); ++i)
-    {
-      if (empty_field_[i] != *(start + i))
-      {
-        empty = false;
-        break;
-      }
-    }
-    if (empty)
-    {
-      e.emplace_back(field_types_[f]);
-      continue;
-    }
-
-    if (field_types_[f] == record_value)
-    {
-      record r;
-      if (! extract(start, end, r, complex_types_[containers++],
-                    set_separator_, "{", "}"))
-        return error{"got invalid record syntax"};
 
-      e.emplace_back(std::move(r));
-    }
-    else if (field_types_[f] == vector_value)
-    {
-      vector v;
-      if (! extract(start, end, v, complex_types_[containers++],
-                    set_separator_, "{", "}"))
-        return error{"got invalid vector syntax"};
+    auto ready = parser_.ready();
+    auto r = parser_.parse(line.begin(), line.end());
+    if (r.failed())
+      return error{r.failure().msg() + " at line " + to_string(number()) +
+                   " (" + std::string(line.begin(), line.end()) + ')'};
 
-      e.emplace_back(std::move(v));
-    }
-    else if (field_types_[f] == set_value || field_types_[f] == table_value)
-    {
-      set s;
-      if (! extract(start, end, s, complex_types_[containers++],
-                    set_separator_, "{", "}"))
-        return error{"got invalid set/table syntax"};
+    if (r)
+      return std::move(r);
 
-      e.emplace_back(std::move(s));
-    }
-    else
+    // Once we have the header of the first log, we can hand out the rest
+    // of the input to parallel workers.
+    if (! ready && parser_.ready() && threads_ > 1 && ! split_)
     {
-      value v;
-      if (! extract(start, end, v, field_types_[f]))
-        return error{"could not parse field: " + std::string{start, end}};
-
-      if (f == static_cast<size_t>(timestamp_field_)
-          && v.which() == time_point_value)
-        e.timestamp(v.get<time_point>());
-
-      e.push_back(std::move(v));
+      split_ = true;
+      split_input();
+      if (parallel_)
+        return extract_parallel();
     }
   }
-
-  return std::move(e);
 }
 
-char const* bro2::description_impl_impl() const
+bool bro2::done_impl_impl() const
 {
-  return "bro2-source";
+  if (parallel_)
+    return rest_first_ == rest_last_
+        && blocks_.empty()
+        && block_pos_ == block_.size();
+
+  return ! current();
 }
 
-trial<schema> bro2::parse_header()
+void bro2::split_input()
 {
-  auto line = this->current();
-  if (! line)
-    return error{"failed to retrieve first header line"};
-
-  util::field_splitter<std::string::const_iterator>
-    fs{separator_.data(), separator_.size()};
-
-  fs.split(line->begin(), line->end());
-
-  if (fs.fields() != 2 || ! fs.equals(0, "#separator"))
-    return error{"got invalid #separator"};
-
-  std::string sep;
-  std::string bro_sep(fs.start(1), fs.end(1));
-  std::string::size_type pos = 0;
-  while (pos != std::string::npos)
+  auto rest = this->rest();
+  if (! rest)
   {
-    pos = bro_sep.find("\\x", pos);
-    if (pos != std::string::npos)
-    {
-      auto i = std::stoi(bro_sep.substr(pos + 2, 2), nullptr, 16);
-      assert(i >= 0 && i <= 255);
-      sep.push_back(i);
-      pos += 2;
-    }
+    VAST_LOG_ACTOR_VERBOSE("cannot parse non-mapped input in parallel");
+    return;
   }
 
-  separator_ = string{sep.begin(), sep.end()};
-  fs = {separator_.data(), separator_.size()};
-
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
-
-  fs.split(line->begin(), line->end());
-  if (fs.fields() != 2 || ! fs.equals(0, "#set_separator"))
-    return error{"got invalid #set_separator"};
-
-  auto set_sep = std::string(fs.start(1), fs.end(1));
-  set_separator_ = string(set_sep.begin(), set_sep.end());
-
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
-
-  fs.split(line->begin(), line->end());
-  if (fs.fields() != 2 || ! fs.equals(0, "#empty_field"))
-    return error{"invalid #empty_field"};
-
-  auto empty = std::string(fs.start(1), fs.end(1));
-  empty_field_ = string(empty.begin(), empty.end());
-
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
-
-  fs.split(line->begin(), line->end());
-  if (fs.fields() != 2 || ! fs.equals(0, "#unset_field"))
-    return error{"invalid #unset_field"};
-
-  auto unset = std::string(fs.start(1), fs.end(1));
-  unset_field_ = string(unset.begin(), unset.end());
-
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
-
-  fs.split(line->begin(), line->end());
-  if (fs.fields() != 2 || ! fs.equals(0, "#path"))
-    return error{"invalid #path"};
-
-  path_ = "bro::" + string(fs.start(1), fs.end(1));
-
-  // Skip #open tag.
-  line = this->next();
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
-
-  fs.split(line->begin(), line->end());
-  if (! fs.equals(0, "#fields"))
-    return error{"got invalid #fields"};
-
-  for (size_t i = 1; i < fs.fields(); ++i)
-    field_names_.emplace_back(fs.start(i), fs.end(i));
-
-  line = this->next();
-  if (! line)
-    return error{"failed to retrieve next header line"};
+  // Concatenated logs change the header midway, which we can only handle
+  // sequentially.
+  static std::string const restart = "\n#separator";
+  if (std::search(rest.begin(), rest.end(), restart.begin(), restart.end())
+      != rest.end())
+  {
+    VAST_LOG_ACTOR_VERBOSE("parses concatenated logs sequentially");
+    return;
+  }
 
-  fs.split(line->begin(), line->end());
-  if (! fs.equals(0, "#types"))
-    return error{"got invalid #types"};
+  VAST_LOG_ACTOR_VERBOSE("parses with " << threads_ << " threads");
+  parallel_ = true;
+  rest_first_ = rest.begin();
+  rest_last_ = rest.end();
+}
 
-  for (size_t i = 1; i < fs.fields(); ++i)
+result<event> bro2::extract_parallel()
+{
+  while (block_pos_ == block_.size())
   {
-    string t(fs.start(i), fs.end(i));
-    auto type = bro_to_vast(t);
-    field_types_.push_back(type);
-    if (is_container(type))
+    // Keep all workers busy while we hand out the events of the oldest block.
+    while (blocks_.size() < threads_ && rest_first_ != rest_last_)
     {
-      auto open = t.find("[");
-      assert(open != string::npos);
-      auto close = t.find("]", open);
-      assert(close != string::npos);
-      auto elem = t.substr(open + 1, close - open - 1);
-      complex_types_.push_back(bro_to_vast(elem));
-    }
-  }
+      auto first = rest_first_;
+      auto last = rest_last_;
+      if (static_cast<size_t>(last - first) > parallel_block_size)
+      {
+        last = first + parallel_block_size;
+        auto nl = static_cast<char const*>(
+            std::memchr(last, '\n', rest_last_ - last));
+        last = nl ? nl + 1 : rest_last_;
+      }
 
-  VAST_LOG_ACTOR_DEBUG("parsed bro2 header:");
-  VAST_LOG_ACTOR_DEBUG("    #separator " << separator_);
-  VAST_LOG_ACTOR_DEBUG("    #set_separator " << set_separator_);
-  VAST_LOG_ACTOR_DEBUG("    #empty_field " << empty_field_);
-  VAST_LOG_ACTOR_DEBUG("    #unset_field " << unset_field_);
-  VAST_LOG_ACTOR_DEBUG("    #path " << path_);
+      rest_first_ = last;
+      blocks_.push_back(
+          std::async(std::launch::async,
+                     [=] { return parse_block(first, last); }));
+    }
 
-  assert(field_names_.size() == field_types_.size());
-  VAST_LOG_ACTOR_DEBUG("  fields:");
-  for (size_t i = 0; i < field_names_.size(); ++i)
-    VAST_LOG_ACTOR_DEBUG("    " << i << ") " << field_names_[i] <<
-                         " (" << field_types_[i] << ')');
+    if (blocks_.empty())
+      return {};
 
-  //if (! complex_types_.empty())
-  //{
-  //  VAST_LOG_ACTOR_DEBUG("  complex fields:");
-  //  for (size_t i = 0; i < complex_types_.size(); ++i)
-  //    VAST_LOG_ACTOR_DEBUG("    " << i << ") " << complex_types_[i]);
-  //}
+    auto t = blocks_.front().get();
+    blocks_.pop_front();
+    if (! t)
+      return t.failure();
 
-  if (timestamp_field_ > -1)
-  {
-    VAST_LOG_ACTOR_VERBOSE("attempts to extract timestamp from field " <<
-                           timestamp_field_);
+    block_ = std::move(*t);
+    block_pos_ = 0;
   }
-  else
+
+  return std::move(block_[block_pos_++]);
+}
+
+trial<std::vector<event>> bro2::parse_block(char const* first,
+                                            char const* last) const
+{
+  // Each block has its own arena because it gets parsed on a separate
+  // thread.
+  auto arena = make_intrusive<util::monotonic_arena>();
+  util::arena_scope scope{*arena};
+  std::vector<event> events;
+  io::line_reader reader{first, static_cast<size_t>(last - first)};
+  char const* data;
+  size_t size;
+  while (reader.next(&data, &size))
   {
-    for (size_t i = 0; i < field_types_.size(); ++i)
-      if (field_types_[0] == time_point_value)
-      {
-        VAST_LOG_ACTOR_VERBOSE("auto-detected field " << i <<
-                               " as event timestamp");
-        timestamp_field_ = static_cast<int32_t>(i);
-        break;
-      }
-  }
+    // Skip empty lines and comments, such as the trailing #close.
+    if (size == 0 || *data == '#')
+      continue;
 
-  //std::vector<argument> args;
-  //for (size_t i = 0; i < field_names_; ++i)
-  //{
-  //  schema::argument a;
-  //  a.name = field_names_[i];
+    auto e = parser_.make_event(data, data + size);
+    if (! e)
+      return error{e.failure().msg() + " (" + std::string(data, size) + ')'};
 
-  //  e.args.push_back(std::move(a));
-  //}
+    events.push_back(std::move(*e));
+  }
 
-  //event_info e{path_, ;
-  schema s;
+  return std::move(events);
+}
 
-  return s;
+char const* bro2::description_impl_impl() const
+{
+  return "bro2-source";
 }
 
 } // namespace source
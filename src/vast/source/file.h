@@ -2,12 +2,13 @@
 #define VAST_SOURCE_FILE_H
 
 #include <cassert>
-#include "vast/value_type.h"
-#include "vast/string.h"
-#include "vast/io/file_stream.h"
-#include "vast/io/getline.h"
+#include <deque>
+#include <future>
+#include "vast/file_system.h"
+#include "vast/io/line_reader.h"
+#include "vast/source/bro2_parser.h"
 #include "vast/source/synchronous.h"
-#include "vast/util/convert.h"
+#include "vast/util/range.h"
 
 namespace vast {
 
@@ -28,8 +29,7 @@ public:
       file_handle_{
           filename == "-"
             ? vast::file{path{filename}, ::fileno(stdin)}
-            : vast::file{path{filename}}},
-      file_stream_{file_handle_}
+            : vast::file{path{filename}}}
   {
     file_handle_.open(vast::file::read_only);
   }
@@ -54,11 +54,8 @@ public:
     return file_handle_.is_open();
   }
 
-private:
-  vast::file file_handle_;
-
 protected:
-  io::file_input_stream file_stream_;
+  vast::file file_handle_;
 };
 
 
@@ -67,8 +64,12 @@ template <typename Derived>
 class line : public file<line<Derived>>
 {
 public:
+  /// A non-owning view of a line.
+  using range = util::iterator_range<char const*>;
+
   line(cppa::actor_ptr sink, std::string const& filename)
-    : file<line<Derived>>{std::move(sink), filename}
+    : file<line<Derived>>{std::move(sink), filename},
+      reader_{this->file_handle_}
   {
   }
 
@@ -79,7 +80,7 @@ public:
 
   bool done_impl() const
   {
-    return current() == nullptr;
+    return static_cast<Derived const*>(this)->done_impl_impl();
   }
 
   char const* description_impl() const
@@ -89,21 +90,29 @@ public:
 
   /// Retrieves the next non-empty line from the file.
   ///
-  /// @returns A pointer to the next line if extracting was successful and
-  /// `nullptr` on failure or EOF.
-  std::string const* next()
+  /// @returns The next line if extracting was successful and an empty range
+  /// on failure or EOF. The range remains valid until the next call to
+  /// next().
+  range next()
   {
     if (! this->good())
-      return nullptr;
-
-    line_.clear();
-    while (line_.empty())
-      if (io::getline(this->file_stream_, line_))
-        ++current_;
-      else
-        return nullptr;
-
-    return &line_;
+      return line_ = {};
+
+    char const* data;
+    size_t size = 0;
+    do
+    {
+      if (! reader_.next(&data, &size))
+      {
+        if (! reader_.failure().msg().empty())
+          VAST_LOG_ACTOR_ERROR(reader_.failure().msg());
+        return line_ = {};
+      }
+      ++current_;
+    }
+    while (size == 0);
+
+    return line_ = {data, data + size};
   }
 
   uint64_t number() const
@@ -111,39 +120,70 @@ public:
     return current_;
   }
 
-  std::string const* current() const
+  range current() const
   {
-    return line_.empty() ? nullptr : &line_;
+    return line_;
+  }
+
+  /// Retrieves the remaining input in one piece without consuming it.
+  /// @returns The unprocessed input if the file is memory-mapped and an empty
+  /// range otherwise.
+  range rest() const
+  {
+    char const* data;
+    size_t size;
+    if (! reader_.rest(&data, &size))
+      return {};
+    return {data, data + size};
   }
 
 private:
+  io::line_reader reader_;
   uint64_t current_ = 0;
-  std::string line_;
+  range line_;
 };
 
 /// A generic Bro 2.x log file source.
 class bro2 : public line<bro2>
 {
 public:
+  /// Spawns a Bro 2.x source.
+  ///
+  /// @param sink The actor to send the generated events to.
+  ///
+  /// @param filename The name of the file to ingest.
+  ///
+  /// @param timestamp_field The field to extract the event timestamp from or
+  /// -1 for auto-detection.
+  ///
+  /// @param threads The number of threads to parse with. Values greater than
+  /// 1 only take effect for memory-mapped files, which the source then splits
+  /// into blocks of lines that workers parse concurrently. The events still
+  /// leave the source in their original order.
   bro2(cppa::actor_ptr sink, std::string const& filename,
-       int32_t timestamp_field);
+       int32_t timestamp_field, size_t threads = 1);
 
   result<event> extract_impl_impl();
 
+  bool done_impl_impl() const;
+
   char const* description_impl_impl() const;
 
 private:
-  trial<nothing> parse_header();
-
-  int32_t timestamp_field_ = -1;
-  string separator_ = " ";
-  string set_separator_;
-  string empty_field_;
-  string unset_field_;
-  string path_;
-  std::vector<string> field_names_;
-  std::vector<value_type> field_types_;
-  std::vector<value_type> complex_types_;
+  void split_input();
+  result<event> extract_parallel();
+  trial<std::vector<event>> parse_block(char const* first,
+                                        char const* last) const;
+
+  bro2_parser parser_;
+  size_t threads_ = 1;
+  bool split_ = false;
+  bool parallel_ = false;
+  char const* rest_first_ = nullptr;
+  char const* rest_last_ = nullptr;
+  std::deque<std::future<trial<std::vector<event>>>> blocks_;
+  std::vector<event> block_;
+  size_t block_pos_ = 0;
 };
 
 } // namespace source
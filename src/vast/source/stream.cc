@@ -0,0 +1,320 @@
+#include "vast/source/stream.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "vast/actor.h"
+#include "vast/util/monotonic_arena.h"
+#include "vast/util/poll.h"
+
+namespace vast {
+namespace source {
+
+namespace {
+
+// The number of bytes to read from a connection at once.
+size_t const read_size = 64 << 10;
+
+// The maximum length of a line before we consider the peer broken.
+size_t const max_line_size = 16 << 20;
+
+bool make_nonblocking(int fd)
+{
+  auto flags = ::fcntl(fd, F_GETFL, 0);
+  return flags != -1 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+} // namespace <anonymous>
+
+using namespace cppa;
+
+bro2_stream::bro2_stream(actor_ptr sink, std::string endpoint,
+                         int32_t timestamp_field)
+  : asynchronous<bro2_stream>{std::move(sink)},
+    endpoint_{std::move(endpoint)},
+    timestamp_field_{timestamp_field},
+    unix_{endpoint_.find('/') != std::string::npos}
+{
+  trap_exit(true);
+  impl_ = (
+      on(atom("EXIT"), arg_match) >> [=](uint32_t reason)
+      {
+        flush();
+        quit(reason);
+      },
+      on(atom("run")) >> [=]
+      {
+        auto t = listen();
+        if (! t)
+        {
+          VAST_LOG_ACTOR_ERROR("failed to listen on " << endpoint_ << ": " <<
+                               t.failure().msg());
+          quit(exit::error);
+          return;
+        }
+
+        VAST_LOG_ACTOR_INFO("accepts Bro logs on " << endpoint_);
+        send(self, atom("poll"));
+      },
+      on(atom("poll")) >> [=]
+      {
+        poll();
+        send(self, atom("poll"));
+      });
+}
+
+bro2_stream::~bro2_stream()
+{
+  while (! connections_.empty())
+    close(connections_.begin()->first);
+
+  if (listener_ != -1)
+  {
+    ::close(listener_);
+    if (unix_)
+      ::unlink(endpoint_.data());
+  }
+}
+
+char const* bro2_stream::description() const
+{
+  return "bro2-stream";
+}
+
+trial<nothing> bro2_stream::listen()
+{
+  if (unix_)
+  {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (endpoint_.size() >= sizeof(addr.sun_path))
+      return error{"socket path too long"};
+
+    // Remove a stale socket of a previous run, but nothing else.
+    struct stat st;
+    if (::stat(endpoint_.data(), &st) == 0 && S_ISSOCK(st.st_mode))
+      ::unlink(endpoint_.data());
+
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, endpoint_.data());
+    listener_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ == -1)
+      return error{std::strerror(errno)};
+
+    if (::bind(listener_, reinterpret_cast<sockaddr*>(&addr),
+               sizeof(addr)) == -1)
+      return error{std::strerror(errno)};
+  }
+  else
+  {
+    auto colon = endpoint_.rfind(':');
+    if (colon == std::string::npos)
+      return error{"endpoint neither host:port nor a socket path"};
+
+    auto host = endpoint_.substr(0, colon);
+    auto port = endpoint_.substr(colon + 1);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* info;
+    auto rc = ::getaddrinfo(host.empty() ? nullptr : host.data(), port.data(),
+                            &hints, &info);
+    if (rc != 0)
+      return error{::gai_strerror(rc)};
+
+    std::string failure;
+    for (auto i = info; i != nullptr; i = i->ai_next)
+    {
+      listener_ = ::socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+      if (listener_ == -1)
+        continue;
+
+      int yes = 1;
+      ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+      if (::bind(listener_, i->ai_addr, i->ai_addrlen) == 0)
+        break;
+
+      failure = std::strerror(errno);
+      ::close(listener_);
+      listener_ = -1;
+    }
+
+    ::freeaddrinfo(info);
+    if (listener_ == -1)
+      return error{failure.empty() ? "no usable address" : failure};
+  }
+
+  if (::listen(listener_, SOMAXCONN) == -1 || ! make_nonblocking(listener_))
+    return error{std::strerror(errno)};
+
+  return nil;
+}
+
+void bro2_stream::poll()
+{
+  // Without credit, we only accept new connections and leave the data in the
+  // socket buffers. The poll timeout then also paces this loop.
+  std::vector<int> fds{listener_};
+  if (has_credit())
+    for (auto& p : connections_)
+      fds.push_back(p.first);
+
+  std::vector<int> ready;
+  if (! util::poll(fds, ready))
+  {
+    VAST_LOG_ACTOR_ERROR("failed to poll: " << std::strerror(errno));
+    quit(exit::error);
+    return;
+  }
+
+  // All events of this round come from one arena, which lives until the sink
+  // has released the last of them.
+  auto arena = make_intrusive<util::monotonic_arena>();
+  util::arena_scope scope{*arena};
+
+  auto idle = true;
+  for (auto fd : ready)
+  {
+    if (fd == listener_)
+    {
+      accept();
+      continue;
+    }
+
+    auto i = connections_.find(fd);
+    assert(i != connections_.end());
+    if (read(fd, i->second))
+      idle = false;
+  }
+
+  // Do not hold back events of slow streams until the batch is full.
+  if (idle)
+    flush();
+}
+
+void bro2_stream::accept()
+{
+  while (true)
+  {
+    auto fd = ::accept(listener_, nullptr, nullptr);
+    if (fd == -1)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        VAST_LOG_ACTOR_ERROR("failed to accept connection: " <<
+                             std::strerror(errno));
+      return;
+    }
+
+    if (! make_nonblocking(fd))
+    {
+      VAST_LOG_ACTOR_ERROR("failed to make connection non-blocking: " <<
+                           std::strerror(errno));
+      ::close(fd);
+      continue;
+    }
+
+    VAST_LOG_ACTOR_VERBOSE("accepted connection " << fd);
+    connections_[fd].parser = bro2_parser{timestamp_field_};
+  }
+}
+
+bool bro2_stream::read(int fd, connection& c)
+{
+  if (c.buffer.size() - c.size < read_size)
+    c.buffer.resize(c.size + read_size);
+
+  auto n = ::read(fd, c.buffer.data() + c.size, c.buffer.size() - c.size);
+  if (n == -1)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return true;
+
+    VAST_LOG_ACTOR_ERROR("failed to read from connection " << fd << ": " <<
+                         std::strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  if (n == 0)
+  {
+    parse(fd, c, true);
+    VAST_LOG_ACTOR_VERBOSE("got EOF from connection " << fd << " after " <<
+                           c.lines << " lines");
+    close(fd);
+    return false;
+  }
+
+  c.size += n;
+  if (! parse(fd, c, false))
+  {
+    close(fd);
+    return false;
+  }
+
+  if (c.size > max_line_size)
+  {
+    VAST_LOG_ACTOR_ERROR("got line exceeding " << max_line_size <<
+                         " bytes from connection " << fd);
+    close(fd);
+    return false;
+  }
+
+  return true;
+}
+
+bool bro2_stream::parse(int fd, connection& c, bool eof)
+{
+  auto first = c.buffer.data();
+  auto last = first + c.size;
+  while (first != last)
+  {
+    auto nl = static_cast<char*>(std::memchr(first, '\n', last - first));
+    if (! nl && ! eof)
+      break;
+
+    auto end = nl ? nl : last;
+    auto line_end = end != first && *(end - 1) == '\r' ? end - 1 : end;
+    ++c.lines;
+
+    // An invalid header renders the whole connection useless, whereas we
+    // only skip invalid data lines.
+    auto header = ! c.parser.ready();
+    auto r = c.parser.parse(first, line_end);
+    if (r)
+    {
+      relay(std::move(*r));
+    }
+    else if (r.failed())
+    {
+      VAST_LOG_ACTOR_ERROR(r.failure().msg() << " at line " << c.lines <<
+                           " of connection " << fd);
+      if (header)
+        return false;
+    }
+
+    first = nl ? nl + 1 : last;
+  }
+
+  c.size = last - first;
+  if (c.size > 0 && first != c.buffer.data())
+    std::memmove(c.buffer.data(), first, c.size);
+
+  return true;
+}
+
+void bro2_stream::close(int fd)
+{
+  ::close(fd);
+  connections_.erase(fd);
+}
+
+} // namespace source
+} // namespace vast
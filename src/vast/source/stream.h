@@ -0,0 +1,84 @@
+#ifndef VAST_SOURCE_STREAM_H
+#define VAST_SOURCE_STREAM_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "vast/source/asynchronous.h"
+#include "vast/source/bro2_parser.h"
+
+namespace vast {
+namespace source {
+
+/// A source that accepts Bro 2.x logs streamed over TCP or Unix domain socket
+/// connections, e.g., from `tail -f conn.log | nc host port` on a sensor.
+/// Each connection carries a log including its header and gets its own
+/// ::bro2_parser, so that connections may stream logs of different types.
+///
+/// The source multiplexes all connections on a single thread with
+/// util::poll. While it has no credit, it stops reading from the
+/// connections. The unread data then fills up the socket buffers, which in
+/// turn throttles the senders.
+class bro2_stream : public asynchronous<bro2_stream>
+{
+public:
+  /// Spawns a streaming Bro 2.x source.
+  ///
+  /// @param sink The actor to send the generated events to.
+  ///
+  /// @param endpoint The endpoint to accept connections on. Either
+  /// `host:port` (or `:port` for all interfaces) for TCP, or the path of a
+  /// Unix domain socket, which must contain a `/`.
+  ///
+  /// @param timestamp_field The field to extract the event timestamp from or
+  /// -1 for auto-detection.
+  bro2_stream(cppa::actor_ptr sink, std::string endpoint,
+              int32_t timestamp_field);
+
+  /// Closes all connections and removes the Unix domain socket.
+  ~bro2_stream();
+
+  char const* description() const;
+
+  cppa::behavior impl_;
+
+private:
+  struct connection
+  {
+    std::vector<char> buffer;
+    size_t size = 0;
+    bro2_parser parser;
+    uint64_t lines = 0;
+  };
+
+  // Binds the listening socket to the endpoint.
+  trial<nothing> listen();
+
+  // Polls the listening socket and, with credit, all connections once.
+  void poll();
+
+  // Accepts all pending connections.
+  void accept();
+
+  // Reads from a connection and parses all complete lines. Returns false if
+  // the connection has been closed.
+  bool read(int fd, connection& c);
+
+  // Parses all complete lines in the buffer of a connection, or all lines if
+  // the connection has reached EOF. Returns false if the log header is
+  // invalid.
+  bool parse(int fd, connection& c, bool eof);
+
+  void close(int fd);
+
+  std::string endpoint_;
+  int32_t timestamp_field_;
+  bool unix_ = false;
+  int listener_ = -1;
+  std::map<int, connection> connections_;
+};
+
+} // namespace source
+} // namespace vast
+
+#endif
@@ -1,15 +1,33 @@
 #ifndef VAST_SOURCE_SYNCHRONOUS_H
 #define VAST_SOURCE_SYNCHRONOUS_H
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <cppa/cppa.hpp>
 #include "vast/actor.h"
 #include "vast/event.h"
+#include "vast/util/monotonic_arena.h"
 #include "vast/util/result.h"
 
 namespace vast {
 namespace source {
 
 /// A synchronous source that extracts events one by one.
+///
+/// The source only extracts events while it has credit, i.e., permission from
+/// its sink to send more events. Each event sent consumes one unit of credit
+/// and the sink replenishes it via `atom("credit")` once it has processed the
+/// events. This bounds the number of events in flight to the sink's window,
+/// regardless of how fast the source can extract them.
+///
+/// The source allocates the heap buffers of each batch from a
+/// util::monotonic_arena, which it releases in one shot once the sink has
+/// dropped the last event of the batch. State which outlives a batch, such as
+/// a parsed log header, must come from a util::arena_scope without an arena.
+///
+/// If told so via `atom("statistics")`, the source periodically reports the
+/// number of events it has extracted to another actor.
 template <typename Derived>
 struct synchronous : public actor<synchronous<Derived>>
 {
@@ -34,16 +52,40 @@ public:
         on(atom("EXIT"), arg_match) >> [=](uint32_t reason)
         {
           send_events();
+          report(true);
           this->quit(reason);
         },
         on(atom("batch size"), arg_match) >> [=](uint64_t batch_size)
         {
           batch_size_ = batch_size;
         },
+        on(atom("statistics"), arg_match) >> [=](cppa::actor_ptr reporter)
+        {
+          reporter_ = reporter;
+        },
+        on(atom("credit"), arg_match) >> [=](uint64_t credit)
+        {
+          auto idle = credit_ == 0;
+          auto max = std::numeric_limits<uint64_t>::max();
+          credit_ = credit > max - credit_ ? max : credit_ + credit;
+          if (idle && running_)
+            send(self, atom("run"));
+        },
         on(atom("run")) >> [=]
         {
+          running_ = true;
+          if (credit_ == 0)
+          {
+            VAST_LOG_ACTOR_DEBUG("waits for credit");
+            return;
+          }
+
+          auto batch_size = std::min(batch_size_, credit_);
+          auto arena = make_intrusive<util::monotonic_arena>();
+          util::arena_scope scope{*arena};
+          events_.reserve(batch_size);
           bool done = false;
-          while (events_.size() < batch_size_ && ! done)
+          while (events_.size() < batch_size && ! done)
           {
             result<event> r{static_cast<Derived*>(this)->extract()};
             if (r)
@@ -61,10 +103,11 @@ public:
           }
 
           send_events();
+          report(done);
 
           if (done)
             this->quit(exit::done);
-          else
+          else if (credit_ > 0)
             send(self, atom("run"));
         },
         others() >> [=]
@@ -85,14 +128,36 @@ private:
   {
     if (! events_.empty())
     {
+      credit_ -= std::min<uint64_t>(credit_, events_.size());
+      total_events_ += events_.size();
       send(sink_, std::move(events_));
       events_.clear();
     }
   }
 
+  // Sends the number of events extracted so far to the reporter, at most
+  // once per second unless forced.
+  void report(bool force = false)
+  {
+    if (! reporter_)
+      return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (! force && now - last_report_ < std::chrono::seconds(1))
+      return;
+
+    last_report_ = now;
+    send(reporter_, atom("statistics"), atom("parse"), total_events_);
+  }
+
   cppa::actor_ptr sink_;
   uint64_t batch_size_ = 0;
+  uint64_t credit_ = 0;
+  bool running_ = false;
   std::vector<event> events_;
+  cppa::actor_ptr reporter_;
+  uint64_t total_events_ = 0;
+  std::chrono::steady_clock::time_point last_report_;
 };
 
 } // namespace source
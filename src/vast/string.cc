@@ -5,6 +5,7 @@
 #include "vast/logger.h"
 #include "vast/serialization.h"
 #include "vast/util/coding.h"
+#include "vast/util/monotonic_arena.h"
 
 namespace vast {
 
@@ -56,8 +57,7 @@ string::string(string&& other)
 
 string::~string()
 {
-  if (is_heap_allocated())
-    delete[] heap_str();
+  release();
 }
 
 string& string::operator=(string other)
@@ -489,8 +489,7 @@ bool string::is_escape_seq(const_iterator i) const
 
 void string::clear()
 {
-  if (is_heap_allocated())
-    delete[] heap_str();
+  release();
   std::memset(buf_, 0, buf_size);
 }
 
@@ -500,11 +499,6 @@ void swap(string& x, string& y)
   swap(x.buf_, y.buf_);
 }
 
-uint8_t string::tag() const
-{
-  return buf_[tag_off] >> 1;
-}
-
 void string::tag(uint8_t t)
 {
   buf_[tag_off] = (t << 1) | (buf_[tag_off] & 1);
@@ -515,12 +509,18 @@ char* string::prepare(size_type size)
   char* str;
   if (size > in_situ_size)
   {
-    str = new char[size + 1];
+    auto arena = util::arena_scope::current();
+    if (arena)
+      str = static_cast<char*>(arena->allocate(size + 1));
+    else
+      str = new char[size + 1];
     str[size] = '\0';
     auto p = reinterpret_cast<char**>(&buf_[heap_str_off]);
     *p = str;
     auto q = reinterpret_cast<size_type*>(&buf_[heap_cnt_off]);
     *q = size;
+    auto a = reinterpret_cast<util::monotonic_arena**>(&buf_[heap_arena_off]);
+    *a = arena;
     buf_[tag_off] |= 0x1;
   }
   else
@@ -544,6 +544,24 @@ char const* string::heap_str() const
   return *str;
 }
 
+util::monotonic_arena* string::heap_arena() const
+{
+  auto a = reinterpret_cast<util::monotonic_arena* const*>(
+      &buf_[heap_arena_off]);
+  return *a;
+}
+
+void string::release()
+{
+  if (! is_heap_allocated())
+    return;
+
+  if (auto arena = heap_arena())
+    arena->deallocate(heap_str());
+  else
+    delete[] heap_str();
+}
+
 void string::serialize(serializer& sink) const
 {
   VAST_ENTER(VAST_THIS);
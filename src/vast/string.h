@@ -19,8 +19,10 @@ namespace vast {
 /// the content is small enough, the internal buffer holds the data in situ. If
 /// there is not enough space, the string allocates space on the heap and
 /// stores a pointer to the buffer followed by the 32-bit size of the string.
-/// The last bit of the tag indicates whether the string uses the heap or
-/// stores its characters in situ.
+/// If the calling thread has a current util::monotonic_arena (see
+/// util::arena_scope), the buffer comes from the arena and the string also
+/// stores a pointer to the arena. The last bit of the tag indicates whether
+/// the string uses the heap or stores its characters in situ.
 ///
 ///
 /// If the string is stack-allocated, it looks schematically like this:
@@ -32,10 +34,10 @@ namespace vast {
 ///
 /// If allocated on the heap, it has the following structure:
 ///
-///           32/64           32                             7    1
-///     +-----------------+--------+-----------...--------+-----+---+
-///     |      ptr        |  size  |                      | tag | 0 |
-///     +-----------------+--------+-----------...--------+-----+---+
+///           32/64           32/64         32/64              7    1
+///     +-----------------+--------+-----------------+--...--+-----+---+
+///     |      ptr        |  size  |      arena      |       | tag | 0 |
+///     +-----------------+--------+-----------------+--...--+-----+---+
 ///
 ///
 /// The minimum space requirements are:
@@ -70,6 +72,10 @@ private:
   /// The position of the string size in case the string is heap-allocated.
   static size_type const heap_cnt_off = sizeof(char*);
 
+  /// The position of the pointer to the arena in case the string is
+  /// heap-allocated.
+  static size_type const heap_arena_off = 2 * sizeof(char*);
+
   /// The position of the tag.
   static size_type const tag_off = buf_size - 1;
 
@@ -79,6 +85,9 @@ private:
   /// The position of the terminating NUL byte.
   static size_type const in_situ_nul_off = in_situ_cnt_off - 1;
 
+  static_assert(heap_arena_off + sizeof(void*) <= in_situ_nul_off,
+                "heap-allocated string layout exceeds buffer");
+
 public:
   typedef char* iterator;
   typedef char const* const_iterator;
@@ -378,6 +387,8 @@ private:
   char* prepare(size_type size);
   char* heap_str();
   char const* heap_str() const;
+  util::monotonic_arena* heap_arena() const;
+  void release();
 
   char buf_[buf_size];
 
@@ -415,6 +426,13 @@ private:
 bool operator==(string const& x, string const& y);
 bool operator<(string const& x, string const& y);
 
+// Values keep their type in the string tag, which makes this function part of
+// every value access.
+inline uint8_t string::tag() const
+{
+  return buf_[tag_off] >> 1;
+}
+
 template <typename From, typename... Opts>
 bool convert(From const& from, string& str, Opts&&... opts)
 {
@@ -0,0 +1,440 @@
+#ifndef VAST_UTIL_CACHE_POLICY_H
+#define VAST_UTIL_CACHE_POLICY_H
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace vast {
+namespace util {
+
+/// The replacement policies of a cache.
+enum class cache_policy
+{
+  lru,        ///< Evicts the least recently used key.
+  two_queue,  ///< Protects keys accessed more than once from one-time keys.
+  arc,        ///< Balances recency and frequency adaptively.
+  clock       ///< Gives each accessed key a second chance.
+};
+
+/// Decides which key a cache evicts next. A policy tracks the keys resident
+/// in a cache. Some policies additionally remember recently evicted keys as
+/// *ghosts*, which never hold more keys than the cache.
+/// @tparam K The key type of the cache.
+template <typename K>
+class replacement_policy
+{
+public:
+  virtual ~replacement_policy() = default;
+
+  /// Records an access to a resident key.
+  /// @param key The accessed key.
+  virtual void access(K const& key) = 0;
+
+  /// Records a new resident key.
+  /// @param key The inserted key.
+  virtual void insert(K const& key) = 0;
+
+  /// Selects a resident key to evict and stops tracking it as resident.
+  /// @param incoming The key the cache is about to insert.
+  /// @returns The key to evict.
+  /// @pre `size() > 0`
+  virtual K evict(K const& incoming) = 0;
+
+  /// Stops tracking a resident key without remembering it as ghost, e.g.,
+  /// because the cache dropped it for another reason than eviction.
+  /// @param key The key to forget.
+  virtual void erase(K const& key) = 0;
+
+  /// Forgets all keys, including ghosts.
+  virtual void clear() = 0;
+
+  /// Retrieves the number of resident keys.
+  /// @returns The number of keys the policy tracks as resident.
+  virtual size_t size() const = 0;
+};
+
+namespace detail {
+
+// A list of keys with constant-time lookup, with the most recent key at the
+// back.
+template <typename K, template <typename...> class Map>
+class key_list
+{
+public:
+  bool contains(K const& key) const
+  {
+    return index_.find(key) != index_.end();
+  }
+
+  void push_back(K const& key)
+  {
+    assert(! contains(key));
+    index_.emplace(key, keys_.insert(keys_.end(), key));
+  }
+
+  // Moves a key to the back.
+  void touch(K const& key)
+  {
+    auto i = index_.find(key);
+    assert(i != index_.end());
+    keys_.splice(keys_.end(), keys_, i->second);
+  }
+
+  bool erase(K const& key)
+  {
+    auto i = index_.find(key);
+    if (i == index_.end())
+      return false;
+
+    keys_.erase(i->second);
+    index_.erase(i);
+    return true;
+  }
+
+  K pop_front()
+  {
+    assert(! keys_.empty());
+    auto key = std::move(keys_.front());
+    keys_.pop_front();
+    index_.erase(key);
+    return key;
+  }
+
+  // Removes keys from the front until at most *n* keys remain.
+  void trim(size_t n)
+  {
+    while (keys_.size() > n)
+      pop_front();
+  }
+
+  size_t size() const
+  {
+    return keys_.size();
+  }
+
+  bool empty() const
+  {
+    return keys_.empty();
+  }
+
+  void clear()
+  {
+    keys_.clear();
+    index_.clear();
+  }
+
+private:
+  std::list<K> keys_;
+  Map<K, typename std::list<K>::iterator> index_;
+};
+
+} // namespace detail
+
+/// Evicts the least recently used key.
+template <typename K, template <typename...> class Map = std::unordered_map>
+class lru_policy : public replacement_policy<K>
+{
+public:
+  void access(K const& key) override
+  {
+    keys_.touch(key);
+  }
+
+  void insert(K const& key) override
+  {
+    keys_.push_back(key);
+  }
+
+  K evict(K const&) override
+  {
+    return keys_.pop_front();
+  }
+
+  void erase(K const& key) override
+  {
+    keys_.erase(key);
+  }
+
+  void clear() override
+  {
+    keys_.clear();
+  }
+
+  size_t size() const override
+  {
+    return keys_.size();
+  }
+
+private:
+  detail::key_list<K, Map> keys_;
+};
+
+/// The 2Q policy by Johnson and Shasha. New keys enter a FIFO queue, and only
+/// keys accessed again, either while in that queue or shortly after their
+/// eviction from it, move into the main LRU queue. As long as the FIFO queue
+/// holds more than a quarter of the keys, evictions come from there, so that
+/// a scan over many keys passes through the FIFO queue without touching the
+/// main queue. The ghosts of keys evicted from the FIFO queue make up at most
+/// half of the number of resident keys.
+template <typename K, template <typename...> class Map = std::unordered_map>
+class two_queue_policy : public replacement_policy<K>
+{
+public:
+  void access(K const& key) override
+  {
+    if (in_.erase(key))
+      main_.push_back(key);
+    else
+      main_.touch(key);
+  }
+
+  void insert(K const& key) override
+  {
+    if (out_.erase(key))
+      main_.push_back(key);
+    else
+      in_.push_back(key);
+  }
+
+  K evict(K const&) override
+  {
+    auto const resident = size();
+    if (! in_.empty() && (in_.size() > std::max<size_t>(resident / 4, 1)
+                          || main_.empty()))
+    {
+      auto key = in_.pop_front();
+      out_.push_back(key);
+      out_.trim(std::max<size_t>(resident / 2, 1));
+      return key;
+    }
+
+    return main_.pop_front();
+  }
+
+  void erase(K const& key) override
+  {
+    if (! in_.erase(key))
+      main_.erase(key);
+  }
+
+  void clear() override
+  {
+    in_.clear();
+    out_.clear();
+    main_.clear();
+  }
+
+  size_t size() const override
+  {
+    return in_.size() + main_.size();
+  }
+
+private:
+  detail::key_list<K, Map> in_;
+  detail::key_list<K, Map> out_;
+  detail::key_list<K, Map> main_;
+};
+
+/// The Adaptive Replacement Cache (ARC) by Megiddo and Modha. It keeps the
+/// keys seen once and the keys seen at least twice in separate LRU lists,
+/// plus a list of ghosts for each. A miss on a ghost shifts the target size
+/// of the first list towards the list the ghost came from. Because a cache
+/// with a size function holds a varying number of keys, the target refers to
+/// the number of resident keys at the time of the miss.
+template <typename K, template <typename...> class Map = std::unordered_map>
+class arc_policy : public replacement_policy<K>
+{
+public:
+  void access(K const& key) override
+  {
+    if (t1_.erase(key))
+      t2_.push_back(key);
+    else
+      t2_.touch(key);
+  }
+
+  void insert(K const& key) override
+  {
+    auto const c = size() + 1;
+    if (b1_.contains(key))
+    {
+      auto delta = b1_.size() >= b2_.size() ? 1 : b2_.size() / b1_.size();
+      p_ = std::min(p_ + delta, c);
+      b1_.erase(key);
+      t2_.push_back(key);
+    }
+    else if (b2_.contains(key))
+    {
+      auto delta = b2_.size() >= b1_.size() ? 1 : b1_.size() / b2_.size();
+      p_ = p_ > delta ? p_ - delta : 0;
+      b2_.erase(key);
+      t2_.push_back(key);
+    }
+    else
+    {
+      t1_.push_back(key);
+    }
+  }
+
+  K evict(K const& incoming) override
+  {
+    auto const c = std::max<size_t>(size() - 1, 1);
+    auto from_t1 = ! t1_.empty()
+      && (t1_.size() > p_
+          || (t1_.size() == p_ && b2_.contains(incoming))
+          || t2_.empty());
+
+    if (from_t1)
+    {
+      auto key = t1_.pop_front();
+      b1_.push_back(key);
+      b1_.trim(c);
+      return key;
+    }
+
+    auto key = t2_.pop_front();
+    b2_.push_back(key);
+    b2_.trim(c);
+    return key;
+  }
+
+  void erase(K const& key) override
+  {
+    if (! t1_.erase(key))
+      t2_.erase(key);
+  }
+
+  void clear() override
+  {
+    t1_.clear();
+    t2_.clear();
+    b1_.clear();
+    b2_.clear();
+    p_ = 0;
+  }
+
+  size_t size() const override
+  {
+    return t1_.size() + t2_.size();
+  }
+
+private:
+  detail::key_list<K, Map> t1_;
+  detail::key_list<K, Map> t2_;
+  detail::key_list<K, Map> b1_;
+  detail::key_list<K, Map> b2_;
+  size_t p_ = 0;
+};
+
+/// The CLOCK policy, an approximation of LRU. The keys form a ring, and an
+/// access sets the reference bit of a key. To find a victim, a hand sweeps
+/// over the ring, clearing reference bits, until it reaches a key without.
+/// New keys enter the ring right behind the hand without reference bit.
+template <typename K, template <typename...> class Map = std::unordered_map>
+class clock_policy : public replacement_policy<K>
+{
+public:
+  clock_policy()
+    : hand_{ring_.end()}
+  {
+  }
+
+  void access(K const& key) override
+  {
+    auto i = index_.find(key);
+    assert(i != index_.end());
+    i->second->referenced = true;
+  }
+
+  void insert(K const& key) override
+  {
+    assert(index_.find(key) == index_.end());
+    index_.emplace(key, ring_.insert(hand_, slot{key, false}));
+  }
+
+  K evict(K const&) override
+  {
+    assert(! ring_.empty());
+    while (true)
+    {
+      if (hand_ == ring_.end())
+        hand_ = ring_.begin();
+
+      if (! hand_->referenced)
+        break;
+
+      hand_->referenced = false;
+      ++hand_;
+    }
+
+    auto key = std::move(hand_->key);
+    index_.erase(key);
+    hand_ = ring_.erase(hand_);
+    return key;
+  }
+
+  void erase(K const& key) override
+  {
+    auto i = index_.find(key);
+    if (i == index_.end())
+      return;
+
+    if (hand_ == i->second)
+      ++hand_;
+
+    ring_.erase(i->second);
+    index_.erase(i);
+  }
+
+  void clear() override
+  {
+    ring_.clear();
+    index_.clear();
+    hand_ = ring_.end();
+  }
+
+  size_t size() const override
+  {
+    return ring_.size();
+  }
+
+private:
+  struct slot
+  {
+    K key;
+    bool referenced;
+  };
+
+  std::list<slot> ring_;
+  Map<K, typename std::list<slot>::iterator> index_;
+  typename std::list<slot>::iterator hand_;
+};
+
+/// Constructs a replacement policy.
+/// @param p The policy to construct.
+/// @returns The replacement policy corresponding to *p*.
+template <typename K, template <typename...> class Map = std::unordered_map>
+std::unique_ptr<replacement_policy<K>> make_replacement_policy(cache_policy p)
+{
+  switch (p)
+  {
+    default:
+    case cache_policy::lru:
+      return std::unique_ptr<replacement_policy<K>>{new lru_policy<K, Map>};
+    case cache_policy::two_queue:
+      return std::unique_ptr<replacement_policy<K>>{
+          new two_queue_policy<K, Map>};
+    case cache_policy::arc:
+      return std::unique_ptr<replacement_policy<K>>{new arc_policy<K, Map>};
+    case cache_policy::clock:
+      return std::unique_ptr<replacement_policy<K>>{new clock_policy<K, Map>};
+  }
+}
+
+} // namespace util
+} // namespace vast
+
+#endif
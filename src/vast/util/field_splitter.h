@@ -3,14 +3,18 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iterator>
+#include <type_traits>
 #include <vector>
+#include "vast/util/simd.h"
 
 namespace vast {
 namespace util {
 
 /// Splits an iterator range into a sequence of iterator pairs according to a
-/// given separator.
+/// given separator. For single-byte separators over contiguous character
+/// buffers, the splitter locates the separators with SIMD instructions.
 template <typename Iterator>
 class field_splitter
 {
@@ -42,16 +46,125 @@ public:
   /// the range *[p, end)* will constitute the final element.
   void split(Iterator start, Iterator end, int max_fields = -1)
   {
-    fields_.clear();
+    size_ = 0;
+    if (sep_len_ == 1)
+      split_byte(start, end, max_fields,
+                 std::is_same<Iterator, char const*>{});
+    else
+      split_scalar(start, end, max_fields);
+  }
+
+  /// Retrieves the start position of a given field.
+  Iterator start(size_t i) const
+  {
+    assert(i < size_);
+    return fields_[i].first;
+  }
+
+  /// Retrieves the end position of a given field.
+  Iterator end(size_t i) const
+  {
+    assert(i < size_);
+    return fields_[i].second;
+  }
+
+  /// Retrieves the number of fields.
+  size_t fields() const
+  {
+    return size_;
+  }
+
+  /// Checks a field against a C string.
+  /// @param field The field to look at.
+  /// @param str The beginning of the string.
+  /// @param str_len The size of the string or 0 for auto-detection.
+  /// @pre `field < fields()`
+  /// @returns `true` *iff* the string at *field* matches *str*.
+  bool equals(size_t field, char const* str, size_t str_len = 0)
+  {
+    assert(field < fields());
+    auto size = str_len == 0 ? std::strlen(str) : str_len;
+    if (static_cast<size_t>(std::distance(start(field), end(field))) != size)
+      return false;
+    return std::equal(start(field), end(field), str);
+  }
+
+private:
+  // Processes ::simd::width bytes at a time and visits each separator in a
+  // block through its bit in the comparison mask. Since a range of *n* bytes
+  // has at most *n + 1* fields, we size the field buffer upfront and write
+  // into it without further checks.
+  void split_byte(char const* start, char const* end, int max_fields,
+                  std::true_type)
+  {
+    auto bound = static_cast<size_t>(end - start) + 1;
+    if (fields_.size() < bound)
+      fields_.resize(bound);
+
+    auto out = fields_.data();
+    auto sep = *sep_;
+    auto begin = start;
+    if (simd::width > 0)
+      while (static_cast<size_t>(end - start) >= simd::width)
+      {
+        auto mask = simd::match(start, sep);
+        while (mask != 0)
+        {
+          auto pos = start + __builtin_ctz(mask);
+          mask &= mask - 1;
+          if (--max_fields == 0)
+          {
+            *out++ = {begin, end};
+            size_ = out - fields_.data();
+            return;
+          }
+
+          *out++ = {begin, pos};
+          begin = pos + 1;
+        }
+
+        start += simd::width;
+      }
+
+    for (; start != end; ++start)
+    {
+      if (*start != sep)
+        continue;
+
+      if (--max_fields == 0)
+      {
+        *out++ = {begin, end};
+        size_ = out - fields_.data();
+        return;
+      }
+
+      *out++ = {begin, start};
+      begin = start + 1;
+    }
+
+    if (begin != end)
+      *out++ = {begin, end};
+
+    size_ = out - fields_.data();
+  }
+
+  void split_byte(Iterator start, Iterator end, int max_fields,
+                  std::false_type)
+  {
+    split_scalar(start, end, max_fields);
+  }
+
+  void split_scalar(Iterator start, Iterator end, int max_fields)
+  {
     auto begin = start;
     while (start != end)
     {
-      while (*start != sep_[0] && start != end)
+      while (start != end && *start != sep_[0])
           ++start;
 
       if (start == end || --max_fields == 0)
       {
-          fields_.emplace_back(begin, end);
+          add(begin, end);
           return;
       }
 
@@ -61,7 +174,7 @@ public:
       {
         if (start == end)
         {
-          fields_.emplace_back(begin, end);
+          add(begin, end);
           return;
         }
         else if (*start == sep_[i])
@@ -77,49 +190,24 @@ public:
 
       if (is_end)
       {
-        fields_.emplace_back(begin, cand_end);
+        add(begin, cand_end);
         begin = start;
       }
     }
   }
 
-  /// Retrieves the start position of a given field.
-  Iterator start(size_t i) const
+  void add(Iterator begin, Iterator end)
   {
-    assert(i < fields_.size());
-    return fields_[i].first;
-  }
+    if (size_ == fields_.size())
+      fields_.emplace_back(begin, end);
+    else
+      fields_[size_] = {begin, end};
 
-  /// Retrieves the end position of a given field.
-  Iterator end(size_t i) const
-  {
-    assert(i < fields_.size());
-    return fields_[i].second;
+    ++size_;
   }
 
-  /// Retrieves the number of fields.
-  size_t fields() const
-  {
-    return fields_.size();
-  }
-
-  /// Checks a field against a C string.
-  /// @param field The field to look at.
-  /// @param str The beginning of the string.
-  /// @param str_len The size of the string or 0 for auto-detection.
-  /// @pre `field < fields()`
-  /// @returns `true` *iff* the string at *field* matches *str*.
-  bool equals(size_t field, char const* str, size_t str_len = 0)
-  {
-    assert(field < fields());
-    auto size = str_len == 0 ? std::strlen(str) : str_len;
-    if (static_cast<size_t>(std::distance(start(field), end(field))) != size)
-      return false;
-    return std::equal(start(field), end(field), str);
-  }
-
-private:
   std::vector<std::pair<Iterator, Iterator>> fields_;
+  size_t size_ = 0;
 
   char const* sep_;
   size_t sep_len_;
@@ -2,14 +2,21 @@
 #define VAST_UTIL_LRU_CACHE
 
 #include <cassert>
+#include <functional>
+#include <memory>
 #include <unordered_map>
-#include <list>
 #include "vast/serialization.h"
+#include "vast/util/cache_policy.h"
 
 namespace vast {
 namespace util {
 
-// A fixed-size cache with LRU eviction policy.
+// A fixed-size cache, with LRU eviction unless configured otherwise. By
+// default, the capacity counts entries. With a size function, it counts the
+// sum of the entry sizes instead, e.g., bytes, and the cache evicts as many
+// entries as necessary to make room for a new one. A ::replacement_policy
+// selects the entries to evict, and an optional admission function decides
+// whether a value retrieved on a miss enters the cache at all.
 // @tparam K The key type when performing cache lookups.
 // @tparam V The value type of the cache lookup table.
 // @tparam Map The map type used as cache table.
@@ -27,56 +34,141 @@ public:
   /// Invoked for each cache miss to retrieve a value for a given key.
   using miss_function = std::function<value_type(key_type const&)>;
 
-  /// Monitors key usage, with the most recently accessed key at the back.
-  using tracker = std::list<key_type>;
+  /// Computes the size of a value in units of the cache capacity.
+  using size_function = std::function<size_t(value_type const&)>;
+
+  /// Decides whether a value retrieved on a miss enters the cache.
+  using admission_function =
+    std::function<bool(key_type const&, value_type const&)>;
+
+  /// A cached value along with its size.
+  struct entry
+  {
+    value_type value;
+    size_t size;
+  };
 
   /// The cache table holding the hot entries.
-  using cache = Map<
-    key_type,
-    std::pair<value_type, typename tracker::iterator>
-  >;
+  using cache = Map<key_type, entry>;
+
+  /// Counters to assess the effectiveness of the cache.
+  struct statistics
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t rejections = 0;
+  };
 
   using iterator = typename cache::iterator;
   using const_iterator = typename cache::const_iterator;
 
-  /// Constructs an LRU cache with a fixed number of elements.
-  /// @param capacity The maximum number of elements in the cache.
+  /// Constructs a cache with a fixed capacity.
+  ///
+  /// @param capacity The maximum number of elements in the cache or, if *s*
+  /// is given, the maximum sum of all element sizes.
+  ///
   /// @param f The function to invoke for each cache miss.
-  lru_cache(size_t capacity, miss_function f)
+  ///
+  /// @param s The function to compute the size of a value. If empty, each
+  /// value has size 1.
+  ///
+  /// @param p The replacement policy.
+  lru_cache(size_t capacity, miss_function f, size_function s = {},
+            cache_policy p = cache_policy::lru)
     : capacity_{capacity},
-      miss_function_{f}
+      miss_function_{f},
+      size_function_{s},
+      policy_{make_replacement_policy<key_type, Map>(p)}
   {
     assert(capacity_ > 0);
   }
 
+  /// Sets the admission function. Values it rejects bypass the cache.
+  /// @param f The function to consult for each value retrieved on a miss.
+  void admission(admission_function f)
+  {
+    admission_function_ = f;
+  }
+
   /// Retrieves a value for a given key. If the key does not exist in the
   /// cache, the function invokes the `miss_function` given at construction
   /// time.
   ///
   /// @param key The key to lookup
   ///
-  /// @returns A reference to the value corresponding to *key*.
+  /// @returns A reference to the value corresponding to *key*. If the
+  /// admission function rejected the value, the reference remains valid only
+  /// until the next retrieval.
   value_type& retrieve(key_type const& key)
+  {
+    if (auto value = find(key))
+      return *value;
+
+    return admit(key, miss_function_(key));
+  }
+
+  /// Looks up a value without invoking the `miss_function`, e.g., to retrieve
+  /// the value for a miss asynchronously and then hand it to ::admit.
+  ///
+  /// @param key The key to lookup.
+  ///
+  /// @returns A pointer to the value corresponding to *key* or `nullptr` if
+  /// *key* does not exist in the cache.
+  value_type* find(key_type const& key)
   {
     auto i = cache_.find(key);
     if (i == cache_.end())
-      return insert(key, miss_function_(key))->second.first;
+    {
+      ++stats_.misses;
+      return nullptr;
+    }
 
-    // Move accessed key to end of tracker.
-    tracker_.splice(tracker_.end(), tracker_, i->second.second);
-    return i->second.first;
+    ++stats_.hits;
+    policy_->access(key);
+    latest_ = key;
+    return &i->second.value;
+  }
+
+  /// Inserts the value for a missed key, unless the admission function
+  /// rejects it.
+  ///
+  /// @param key The key which missed.
+  ///
+  /// @param value The value for *key*.
+  ///
+  /// @returns A reference to the value corresponding to *key*. If the
+  /// admission function rejected the value, the reference remains valid only
+  /// until the next retrieval.
+  value_type& admit(key_type const& key, value_type value)
+  {
+    auto i = cache_.find(key);
+    if (i != cache_.end())
+      return i->second.value;
+
+    if (admission_function_ && ! admission_function_(key, value))
+    {
+      ++stats_.rejections;
+      rejected_.reset(new value_type(std::move(value)));
+      return *rejected_;
+    }
+
+    return insert(key, std::move(value))->second.value;
   }
 
   /// Retrieves the most recently accessed value.
   /// @returns A reference to the value which has been accessed most recently.
-  /// @pre `! empty()`
+  /// @pre `! empty()` and the most recently accessed key is in the cache.
   value_type& retrieve_latest()
   {
     assert(! empty());
-    return retrieve(tracker_.back());
+    auto i = cache_.find(latest_);
+    assert(i != cache_.end());
+    return i->second.value;
   }
 
-  /// Inserts a fresh entry in the cache.
+  /// Inserts a fresh entry in the cache. A value larger than the capacity
+  /// displaces all other entries.
   /// @param key The key mapping to *value*.
   /// @param value The value for *key*.
   /// @returns An iterator to the freshly inserted element.
@@ -85,16 +177,34 @@ public:
   {
     assert(cache_.find(key) == cache_.end());
 
-    if (cache_.size() == capacity_) 
-      evict();
+    auto size = size_function_ ? size_function_(value) : 1;
+    while (! empty() && weight_ + size > capacity_)
+      evict(key);
 
-    auto t = tracker_.insert(tracker_.end(), key);
-    auto i = cache_.emplace(key, make_pair(std::move(value), std::move(t)));
+    policy_->insert(key);
+    auto i = cache_.emplace(key, entry{std::move(value), size});
+    weight_ += size;
+    latest_ = key;
 
     assert(i.second);
     return i.first;
   }
 
+  /// Removes an entry from the cache, e.g., because its value became stale.
+  /// @param key The key of the entry to remove.
+  /// @returns `true` if *key* existed in the cache.
+  bool erase(key_type const& key)
+  {
+    auto i = cache_.find(key);
+    if (i == cache_.end())
+      return false;
+
+    policy_->erase(key);
+    weight_ -= i->second.size;
+    cache_.erase(i);
+    return true;
+  }
+
   iterator begin()
   {
     return cache_.begin();
@@ -122,6 +232,27 @@ public:
     return cache_.size();
   }
 
+  /// Retrieves the sum of the sizes of all elements in the cache.
+  /// @returns The number of capacity units in use.
+  size_t weight() const
+  {
+    return weight_;
+  }
+
+  /// Retrieves the capacity of the cache.
+  /// @returns The maximum weight of the cache.
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  /// Retrieves the hit, miss, eviction, and rejection counters.
+  /// @returns The statistics of the cache.
+  statistics const& stats() const
+  {
+    return stats_;
+  }
+
   /// Checks whether the cache is empty.
   /// @returns `true` iff the cache holds no elements.
   bool empty() const
@@ -132,25 +263,33 @@ public:
   /// Removes all elements from the cache.
   void clear()
   {
-    tracker_.clear();
+    policy_->clear();
     cache_.clear();
+    rejected_.reset();
+    weight_ = 0;
   }
 
 private:
-  // Purges the least-recently-used element in the cache.
-  void evict()
+  // Purges the element the replacement policy selects.
+  void evict(key_type const& incoming)
   {
-    assert(! tracker_.empty());
-    auto i = cache_.find(tracker_.front());
+    auto i = cache_.find(policy_->evict(incoming));
     assert(i != cache_.end());
+    weight_ -= i->second.size;
     cache_.erase(i);
-    tracker_.pop_front();
+    ++stats_.evictions;
   }
 
   size_t const capacity_;
   miss_function miss_function_;
-  tracker tracker_;
+  size_function size_function_;
+  admission_function admission_function_;
+  std::unique_ptr<replacement_policy<key_type>> policy_;
   cache cache_;
+  key_type latest_;
+  std::unique_ptr<value_type> rejected_;
+  size_t weight_ = 0;
+  statistics stats_;
 
 private:
   friend access;
@@ -158,9 +297,9 @@ private:
   void serialize(serializer& sink) const
   {
     sink << capacity_;
-    sink << static_cast<uint64_t>(tracker_.size());
-    for (auto& key : tracker_)
-      sink << key << cache_[key].first;
+    sink << static_cast<uint64_t>(cache_.size());
+    for (auto& p : cache_)
+      sink << p.first << p.second.value;
   }
 
   void deserialize(deserializer& source)
@@ -175,8 +314,7 @@ private:
     for (uint64_t i = 0; i < size; ++i)
     {
       source >> k >> v;
-      auto it = tracker_.insert(tracker_.end(), k);
-      cache_.emplace(std::move(k), {std::move(v), it});
+      insert(k, std::move(v));
     }
   }
 };
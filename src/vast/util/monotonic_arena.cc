@@ -0,0 +1,88 @@
+#include "vast/util/monotonic_arena.h"
+
+#include <algorithm>
+
+namespace vast {
+namespace util {
+
+namespace {
+
+// TODO: replace with thread_local once the compilers implement it.
+__thread monotonic_arena* current_arena = nullptr;
+
+} // namespace <anonymous>
+
+constexpr size_t monotonic_arena::alignment;
+
+monotonic_arena::monotonic_arena(size_t block_size)
+  : block_size_{std::max(block_size, alignment)}
+{
+}
+
+void* monotonic_arena::allocate(size_t n)
+{
+  n = (n + alignment - 1) & ~(alignment - 1);
+
+  // Large allocations get a block of their own so that they do not waste
+  // the rest of the current one.
+  if (n > block_size_ / 4)
+  {
+    blocks_.emplace_back(new char[n]);
+    used_ += n;
+    ref(this);
+    return blocks_.back().get();
+  }
+
+  if (static_cast<size_t>(end_ - ptr_) < n)
+  {
+    blocks_.emplace_back(new char[block_size_]);
+    ptr_ = blocks_.back().get();
+    end_ = ptr_ + block_size_;
+  }
+
+  auto p = ptr_;
+  ptr_ += n;
+  used_ += n;
+  ref(this);
+  return p;
+}
+
+void monotonic_arena::deallocate(void*) noexcept
+{
+  unref(this);
+}
+
+size_t monotonic_arena::used() const
+{
+  return used_;
+}
+
+size_t monotonic_arena::blocks() const
+{
+  return blocks_.size();
+}
+
+arena_scope::arena_scope(monotonic_arena& a)
+  : previous_{current_arena}
+{
+  current_arena = &a;
+}
+
+arena_scope::arena_scope(std::nullptr_t)
+  : previous_{current_arena}
+{
+  current_arena = nullptr;
+}
+
+arena_scope::~arena_scope()
+{
+  current_arena = previous_;
+}
+
+monotonic_arena* arena_scope::current()
+{
+  return current_arena;
+}
+
+} // namespace util
+} // namespace vast
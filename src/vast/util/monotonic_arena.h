@@ -0,0 +1,90 @@
+#ifndef VAST_UTIL_MONOTONIC_ARENA_H
+#define VAST_UTIL_MONOTONIC_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "vast/util/intrusive.h"
+
+namespace vast {
+namespace util {
+
+/// A growable arena that hands out memory by bumping a pointer through a
+/// chain of blocks. Unlike ::arena, it never reuses freed memory: it releases
+/// all of its blocks at once when it goes away.
+///
+/// Every allocation holds a reference to the arena, in addition to the
+/// references of its owners. Hence, the arena lives exactly as long as its
+/// last allocation or owner, no matter which thread releases it. Only one
+/// thread may allocate at a time, whereas any thread may deallocate.
+class monotonic_arena : public intrusive_base<monotonic_arena>
+{
+  monotonic_arena(monotonic_arena const&) = delete;
+  monotonic_arena& operator=(monotonic_arena const&) = delete;
+
+public:
+  /// The alignment of all allocations.
+  static constexpr size_t alignment = 16;
+
+  /// Constructs an arena.
+  /// @param block_size The number of bytes to allocate at once.
+  monotonic_arena(size_t block_size = 64 << 10);
+
+  /// Allocates memory from the current block, or from a new one if the
+  /// current block has not enough space left.
+  /// @param n The number of bytes to allocate.
+  /// @returns A pointer to *n* bytes aligned at ::alignment.
+  void* allocate(size_t n);
+
+  /// Releases the reference an allocation holds to the arena.
+  /// @param p The memory returned from allocate().
+  void deallocate(void* p) noexcept;
+
+  /// Retrieves the number of bytes handed out.
+  /// @returns The number of allocated bytes.
+  size_t used() const;
+
+  /// Retrieves the number of blocks the arena allocated.
+  /// @returns The number of blocks.
+  size_t blocks() const;
+
+private:
+  size_t block_size_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* ptr_ = nullptr;
+  char* end_ = nullptr;
+  size_t used_ = 0;
+};
+
+/// Makes an arena the one that the calling thread allocates from for the
+/// lifetime of the scope. Scopes nest.
+class arena_scope
+{
+  arena_scope(arena_scope const&) = delete;
+  arena_scope& operator=(arena_scope const&) = delete;
+
+public:
+  /// Enters a scope.
+  /// @param a The arena to allocate from.
+  arena_scope(monotonic_arena& a);
+
+  /// Enters a scope without an arena, in which the calling thread allocates
+  /// from the heap again. Objects outliving the arena of the enclosing scope,
+  /// such as parser state, must come into existence in such a scope.
+  arena_scope(std::nullptr_t);
+
+  /// Restores the arena of the enclosing scope.
+  ~arena_scope();
+
+  /// Retrieves the arena of the innermost scope on the calling thread.
+  /// @returns The current arena or `nullptr` if the thread has no scope.
+  static monotonic_arena* current();
+
+private:
+  monotonic_arena* previous_;
+};
+
+} // namespace util
+} // namespace vast
+
+#endif
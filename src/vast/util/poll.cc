@@ -2,6 +2,7 @@
 
 #include <cerrno>
 #include <stdexcept>
+#include <poll.h>
 #include <sys/select.h>
 
 namespace vast {
@@ -29,5 +30,27 @@ bool poll(int fd, int usec)
   return FD_ISSET(fd, &rdset);
 }
 
+bool poll(std::vector<int> const& fds, std::vector<int>& ready, int usec)
+{
+  ready.clear();
+  std::vector<pollfd> pfds(fds.size());
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    pfds[i].fd = fds[i];
+    pfds[i].events = POLLIN;
+    pfds[i].revents = 0;
+  }
+
+  auto rc = ::poll(pfds.data(), pfds.size(), usec / 1000);
+  if (rc < 0)
+    return errno == EINTR;
+
+  for (auto& pfd : pfds)
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+      ready.push_back(pfd.fd);
+
+  return true;
+}
+
 } // namespace util
 } // namespace vast
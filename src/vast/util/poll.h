@@ -1,6 +1,8 @@
 #ifndef VAST_UTIL_POLL_H
 #define VAST_UTIL_POLL_H
 
+#include <vector>
+
 namespace vast {
 namespace util {
 
@@ -10,6 +12,19 @@ namespace util {
 /// @returns `true` if *fd* has ready events for reading.
 bool poll(int fd, int usec = 100000);
 
+/// Polls multiple file descriptors for ready read events.
+///
+/// @param fds The file descriptors to poll.
+///
+/// @param ready A result parameter that receives the descriptors from *fds*
+/// which have ready events for reading, including hang-ups and errors.
+///
+/// @param usec The number of microseconds to wait.
+///
+/// @returns `false` if polling failed.
+bool poll(std::vector<int> const& fds, std::vector<int>& ready,
+          int usec = 100000);
+
 } // namespace util
 } // namespace vast
 
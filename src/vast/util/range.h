@@ -115,6 +115,8 @@ template <typename ForwardIterator>
 class iterator_range : public range<iterator_range<ForwardIterator>>
 {
 public:
+  iterator_range() = default;
+
   template <typename Iterator>
   iterator_range(Iterator begin, Iterator end)
     : begin_{begin}, end_{end}
@@ -132,8 +134,8 @@ public:
   }
 
 private:
-  ForwardIterator begin_;
-  ForwardIterator end_;
+  ForwardIterator begin_ = ForwardIterator();
+  ForwardIterator end_ = ForwardIterator();
 };
 
 } // namespace util
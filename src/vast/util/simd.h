@@ -0,0 +1,83 @@
+#ifndef VAST_UTIL_SIMD_H
+#define VAST_UTIL_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vast {
+namespace util {
+namespace simd {
+
+/// The number of bytes the vectorized kernels process at once, or 0 if the
+/// target has no supported vector instruction set.
+#if defined(__AVX2__)
+static size_t const width = 32;
+#elif defined(__SSE2__)
+static size_t const width = 16;
+#else
+static size_t const width = 0;
+#endif
+
+/// Compares a block of ::width bytes against a given byte.
+/// @param p The beginning of the block.
+/// @param c The byte to compare against.
+/// @returns A bitmask in which bit *i* is set *iff* `p[i] == c`.
+/// @pre `width > 0` and *[p, p + width)* is readable.
+inline uint32_t match(char const* p, char c)
+{
+#if defined(__AVX2__)
+  auto block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+  auto eq = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+#elif defined(__SSE2__)
+  auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+  auto eq = _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+  return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#else
+  (void)p;
+  (void)c;
+  return 0;
+#endif
+}
+
+} // namespace simd
+
+/// Finds the first occurrence of either of two bytes in a range.
+/// @param first The beginning of the range.
+/// @param last One past the end of the range.
+/// @param a The first byte to look for.
+/// @param b The second byte to look for.
+/// @returns A pointer to the first byte equal to *a* or *b*, or *last* if
+/// the range contains neither.
+inline char const* find_any(char const* first, char const* last,
+                            char a, char b)
+{
+#ifdef __SSE2__
+  auto const va = _mm_set1_epi8(a);
+  auto const vb = _mm_set1_epi8(b);
+  while (last - first >= 16)
+  {
+    auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+    auto eq = _mm_or_si128(_mm_cmpeq_epi8(block, va),
+                           _mm_cmpeq_epi8(block, vb));
+    auto mask = _mm_movemask_epi8(eq);
+    if (mask != 0)
+      return first + __builtin_ctz(mask);
+    first += 16;
+  }
+#endif
+  while (first != last && *first != a && *first != b)
+    ++first;
+  return first;
+}
+
+} // namespace util
+} // namespace vast
+
+#endif
@@ -0,0 +1,65 @@
+#include "vast/util/thread_pool.h"
+
+#include <cassert>
+
+namespace vast {
+namespace util {
+
+thread_pool::thread_pool(size_t threads)
+{
+  assert(threads > 0);
+  for (size_t i = 0; i < threads; ++i)
+    threads_.emplace_back([=] { run(); });
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+
+  cond_.notify_all();
+  for (auto& t : threads_)
+    t.join();
+}
+
+size_t thread_pool::size() const
+{
+  return threads_.size();
+}
+
+void thread_pool::enqueue(std::function<void()> f)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(! done_);
+    tasks_.push_back(std::move(f));
+  }
+
+  cond_.notify_one();
+}
+
+void thread_pool::run()
+{
+  while (true)
+  {
+    std::function<void()> f;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (tasks_.empty() && ! done_)
+        cond_.wait(lock);
+
+      if (tasks_.empty())
+        return;
+
+      f = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    f();
+  }
+}
+
+} // namespace util
+} // namespace vast
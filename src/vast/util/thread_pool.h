@@ -0,0 +1,66 @@
+#ifndef VAST_UTIL_THREAD_POOL_H
+#define VAST_UTIL_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vast {
+namespace util {
+
+/// A fixed set of threads executing tasks in the order of submission. The
+/// pool exists for CPU-bound work that would otherwise stall an actor, e.g.,
+/// compressing chunks, and can be shared among several actors.
+class thread_pool
+{
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool) = delete;
+
+public:
+  /// Constructs a pool and starts its threads.
+  /// @param threads The number of threads.
+  /// @pre `threads > 0`
+  explicit thread_pool(size_t threads);
+
+  /// Executes all remaining tasks and then joins the threads.
+  ~thread_pool();
+
+  /// Submits a task for execution.
+  /// @param f The function to execute on one of the threads.
+  /// @returns A future for the result of *f*.
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> submit(F f)
+  {
+    using result_type = typename std::result_of<F()>::type;
+    auto task = std::make_shared<std::packaged_task<result_type()>>(
+        std::move(f));
+    auto future = task->get_future();
+    enqueue([task] { (*task)(); });
+    return future;
+  }
+
+  /// Retrieves the number of threads.
+  /// @returns The number of threads in the pool.
+  size_t size() const;
+
+private:
+  void enqueue(std::function<void()> f);
+  void run();
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::function<void()>> tasks_;
+  bool done_ = false;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace util
+} // namespace vast
+
+#endif
@@ -190,26 +190,6 @@ value::value(table t)
   data_.engage();
 }
 
-value::operator bool() const
-{
-  return data_.engaged();
-}
-
-bool value::nil() const
-{
-  return which() != invalid_value && ! data_.engaged();
-}
-
-bool value::invalid() const
-{
-  return which() == invalid_value;
-}
-
-value_type value::which() const
-{
-  return data_.type();
-}
-
 void value::clear()
 {
   if (which() == invalid_value)
@@ -383,11 +363,6 @@ void value::data::construct(value_type t)
   }
 }
 
-value_type value::data::type() const
-{
-  return static_cast<value_type>(string_.tag() & 0x3f);
-}
-
 void value::data::type(value_type i)
 {
   string_.tag(i | (string_.tag() & 0x40));
@@ -398,11 +373,6 @@ void value::data::engage()
   string_.tag(string_.tag() | 0x40);
 }
 
-bool value::data::engaged() const
-{
-  return string_.tag() & 0x40;
-}
-
 void value::data::serialize(serializer& sink) const
 {
   sink << string_.tag();
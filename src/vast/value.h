@@ -521,6 +521,38 @@ inline T const& value::get() const
   return *value::visit(*this, detail::getter<T const>());
 }
 
+// Each visitation inspects the type information, so we define its accessors
+// inline.
+inline value::operator bool() const
+{
+  return data_.engaged();
+}
+
+inline bool value::nil() const
+{
+  return which() != invalid_value && ! data_.engaged();
+}
+
+inline bool value::invalid() const
+{
+  return which() == invalid_value;
+}
+
+inline value_type value::which() const
+{
+  return data_.type();
+}
+
+inline value_type value::data::type() const
+{
+  return static_cast<value_type>(string_.tag() & 0x3f);
+}
+
+inline bool value::data::engaged() const
+{
+  return string_.tag() & 0x40;
+}
+
 /// A vector of values with arbitrary value types.
 class record : public std::vector<value>,
                util::totally_ordered<record>,
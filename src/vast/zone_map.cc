@@ -0,0 +1,383 @@
+#include "vast/zone_map.h"
+
+#include <algorithm>
+#include <cassert>
+#include "vast/event.h"
+#include "vast/expression.h"
+#include "vast/serialization.h"
+
+namespace vast {
+
+namespace {
+
+// Checks whether the comparison operators of values coerce between two types.
+bool arithmetic(value_type t)
+{
+  return t == bool_value
+      || t == int_value
+      || t == uint_value
+      || t == double_value;
+}
+
+// Checks whether a zone tracks the range of values of a given type.
+bool ordered(value_type t)
+{
+  switch (t)
+  {
+    default:
+      return false;
+    case bool_value:
+    case int_value:
+    case uint_value:
+    case double_value:
+    case time_range_value:
+    case time_point_value:
+    case string_value:
+    case address_value:
+    case port_value:
+      return true;
+  }
+}
+
+// Checks whether a zone answers a predicate with a given operator.
+bool supported(relational_operator op)
+{
+  return op == equal
+      || op == less
+      || op == less_equal
+      || op == greater
+      || op == greater_equal;
+}
+
+// Turns `c op x` into `x op' c`.
+relational_operator flip(relational_operator op)
+{
+  switch (op)
+  {
+    default:
+      return op;
+    case less:
+      return greater;
+    case less_equal:
+      return greater_equal;
+    case greater:
+      return less;
+    case greater_equal:
+      return less_equal;
+  }
+}
+
+// Checks whether `x op c` may hold for some value *x* of type *t* within
+// *[min, max]*.
+bool overlaps(value_type t, value const& min, value const& max,
+              relational_operator op, value const& c)
+{
+  assert(supported(op));
+
+  // Values of different types compare false, unless both are arithmetic.
+  if (t != c.which())
+    return arithmetic(t) && arithmetic(c.which());
+
+  if (! min)
+    return true;
+
+  switch (op)
+  {
+    default:
+      return true;
+    case equal:
+      return ! (c < min) && ! (max < c);
+    case less:
+      return min < c;
+    case less_equal:
+      return min <= c;
+    case greater:
+      return max > c;
+    case greater_equal:
+      return max >= c;
+  }
+}
+
+// Widens the range of a zone to include a value of the same type. We update
+// the bounds in place rather than through the comparison operators of
+// ::value, which dispatch on both operands.
+class widener
+{
+public:
+  using result_type = void;
+
+  widener(value& min, value& max)
+    : min_{min},
+      max_{max}
+  {
+  }
+
+  // We only visit values of ::ordered types.
+  template <typename T>
+  void operator()(T const& x) const
+  {
+    auto& min = min_.get<T>();
+    auto& max = max_.get<T>();
+    if (x < min)
+      min = x;
+    else if (max < x)
+      max = x;
+  }
+
+private:
+  value& min_;
+  value& max_;
+};
+
+} // namespace <anonymous>
+
+// Evaluates an expression against a zone map, mirroring the evaluation of
+// expressions against events.
+class zone_map::checker : public expr::const_visitor
+{
+public:
+  checker(zone_map const& zm)
+    : zm_{zm}
+  {
+  }
+
+  bool result() const
+  {
+    return result_;
+  }
+
+  virtual void visit(expr::constant const& c)
+  {
+    constant_ = &c.val;
+  }
+
+  virtual void visit(expr::timestamp_extractor const&)
+  {
+    extractor_ = timestamp;
+  }
+
+  virtual void visit(expr::name_extractor const&)
+  {
+    extractor_ = other;
+  }
+
+  virtual void visit(expr::id_extractor const&)
+  {
+    extractor_ = other;
+  }
+
+  virtual void visit(expr::offset_extractor const& o)
+  {
+    // We only summarize top-level fields.
+    extractor_ = o.off.size() == 1 ? position : other;
+    if (extractor_ == position)
+      position_ = o.off[0];
+  }
+
+  virtual void visit(expr::type_extractor const& t)
+  {
+    extractor_ = type;
+    type_ = t.type;
+  }
+
+  virtual void visit(expr::predicate const& p)
+  {
+    constant_ = nullptr;
+    extractor_ = other;
+    p.lhs().accept(*this);
+    auto op = constant_ ? flip(p.op) : p.op;
+    p.rhs().accept(*this);
+    result_ = constant_ ? check(op, *constant_) : true;
+  }
+
+  virtual void visit(expr::conjunction const& c)
+  {
+    result_ = std::all_of(
+        c.operands.begin(),
+        c.operands.end(),
+        [&](std::unique_ptr<expr::node> const& operand) -> bool
+        {
+          operand->accept(*this);
+          return result_;
+        });
+  }
+
+  virtual void visit(expr::disjunction const& d)
+  {
+    result_ = std::any_of(
+        d.operands.begin(),
+        d.operands.end(),
+        [&](std::unique_ptr<expr::node> const& operand) -> bool
+        {
+          operand->accept(*this);
+          return result_;
+        });
+  }
+
+private:
+  enum extractor_kind
+  {
+    other,
+    timestamp,
+    position,
+    type
+  };
+
+  bool check(relational_operator op, value const& c) const
+  {
+    if (! supported(op) || c.nil())
+      return true;
+
+    switch (extractor_)
+    {
+      default:
+        return true;
+      case timestamp:
+        return zm_.events_ > 0
+            && overlaps(time_point_value, zm_.first_, zm_.last_, op, c);
+      case position:
+        {
+          // Out-of-bounds fields evaluate to invalid.
+          if (c.invalid())
+            return op == equal
+                && (position_ < zm_.fields_.size()
+                      ? zm_.fields_[position_].nulls > 0
+                      : zm_.events_ > 0);
+
+          if (position_ >= zm_.fields_.size())
+            return false;
+
+          for (auto& p : zm_.fields_[position_].zones)
+            if (overlaps(p.first, p.second.min, p.second.max, op, c))
+              return true;
+
+          return false;
+        }
+      case type:
+        {
+          // The type extractor evaluates to invalid if no value has the type.
+          if (c.invalid())
+            return true;
+
+          for (auto& f : zm_.fields_)
+          {
+            // The type extractor descends into records, which we do not
+            // summarize.
+            if (f.zones.count(record_value))
+              return true;
+
+            auto z = f.zones.find(type_);
+            if (z != f.zones.end()
+                && overlaps(type_, z->second.min, z->second.max, op, c))
+              return true;
+          }
+
+          return false;
+        }
+    }
+  }
+
+  zone_map const& zm_;
+  bool result_ = true;
+  value const* constant_ = nullptr;
+  extractor_kind extractor_ = other;
+  size_t position_ = 0;
+  value_type type_ = invalid_value;
+};
+
+void zone_map::add(event const& e)
+{
+  if (events_ == 0 || e.timestamp() < first_)
+    first_ = e.timestamp();
+
+  if (events_ == 0 || last_ < e.timestamp())
+    last_ = e.timestamp();
+
+  // A field which the previous events lacked was null in each of them.
+  if (e.size() > fields_.size())
+  {
+    auto n = fields_.size();
+    fields_.resize(e.size());
+    for (auto i = n; i < fields_.size(); ++i)
+      fields_[i].nulls = events_;
+  }
+
+  for (size_t i = 0; i < fields_.size(); ++i)
+  {
+    auto& f = fields_[i];
+    auto t = i < e.size() ? e[i].which() : invalid_value;
+    if (t == invalid_value || ! e[i])
+    {
+      ++f.nulls;
+      continue;
+    }
+
+    auto& v = e[i];
+    auto z = f.zones.find(t);
+    if (z == f.zones.end())
+      f.zones.emplace(t, ordered(t) ? zone{v, v} : zone{});
+    else if (ordered(t))
+      value::visit(v, widener{z->second.min, z->second.max});
+  }
+
+  ++events_;
+}
+
+bool zone_map::may_match(expr::ast const& ast) const
+{
+  if (! ast)
+    return true;
+
+  checker v{*this};
+  ast.accept(v);
+  return v.result();
+}
+
+uint64_t zone_map::events() const
+{
+  return events_;
+}
+
+void zone_map::serialize(serializer& sink) const
+{
+  sink << first_ << last_ << events_;
+  sink << static_cast<uint64_t>(fields_.size());
+  for (auto& f : fields_)
+  {
+    sink << f.nulls << static_cast<uint64_t>(f.zones.size());
+    for (auto& p : f.zones)
+      sink << p.first << p.second.min << p.second.max;
+  }
+}
+
+void zone_map::deserialize(deserializer& source)
+{
+  source >> first_ >> last_ >> events_;
+
+  uint64_t n;
+  source >> n;
+  fields_.resize(n);
+  for (auto& f : fields_)
+  {
+    uint64_t zones;
+    source >> f.nulls >> zones;
+    f.zones.clear();
+    for (uint64_t i = 0; i < zones; ++i)
+    {
+      value_type t;
+      zone z;
+      source >> t >> z.min >> z.max;
+      f.zones.emplace(t, std::move(z));
+    }
+  }
+}
+
+bool operator==(zone_map const& x, zone_map const& y)
+{
+  return x.first_ == y.first_
+      && x.last_ == y.last_
+      && x.events_ == y.events_
+      && x.fields_ == y.fields_;
+}
+
+} // namespace vast
@@ -0,0 +1,86 @@
+#ifndef VAST_ZONE_MAP_H
+#define VAST_ZONE_MAP_H
+
+#include <map>
+#include <vector>
+#include "vast/time.h"
+#include "vast/value.h"
+#include "vast/util/operators.h"
+
+namespace vast {
+
+class event;
+
+namespace expr { class ast; }
+
+/// Summarizes a sequence of events, such as those of a chunk, so that a
+/// query can rule out the sequence without looking at the events themselves.
+/// A zone map records the range of the event timestamps and, for each
+/// top-level field position, the number of null values and, per value type,
+/// the minimum and maximum value. It tracks the range only for types with a
+/// total order: booleans, numbers, time values, strings, addresses, and
+/// ports. For other types, it merely notes that they occur.
+class zone_map : util::equality_comparable<zone_map>
+{
+public:
+  /// Incorporates an event into the summary.
+  /// @param e The event to add.
+  void add(event const& e);
+
+  /// Checks whether an expression may hold for any of the summarized events.
+  /// The check is conservative: it considers only predicates comparing the
+  /// timestamp, a top-level field, or a type with a constant by means of
+  /// equality or ordering, and assumes any other predicate may hold.
+  ///
+  /// @param ast The expression to check.
+  ///
+  /// @returns `false` if *ast* holds for none of the summarized events.
+  bool may_match(expr::ast const& ast) const;
+
+  /// Retrieves the number of summarized events.
+  /// @returns The number of events passed to ::add.
+  uint64_t events() const;
+
+private:
+  // The value range of one type at a field position. Both bounds are invalid
+  // if the type has no total order.
+  struct zone
+  {
+    value min;
+    value max;
+
+    friend bool operator==(zone const& x, zone const& y)
+    {
+      return x.min == y.min && x.max == y.max;
+    }
+  };
+
+  struct field
+  {
+    uint64_t nulls = 0;
+    std::map<value_type, zone> zones;
+
+    friend bool operator==(field const& x, field const& y)
+    {
+      return x.nulls == y.nulls && x.zones == y.zones;
+    }
+  };
+
+  class checker;
+
+  time_point first_ = time_range{};
+  time_point last_ = time_range{};
+  uint64_t events_ = 0;
+  std::vector<field> fields_;
+
+private:
+  friend access;
+  void serialize(serializer& sink) const;
+  void deserialize(deserializer& source);
+
+  friend bool operator==(zone_map const& x, zone_map const& y);
+};
+
+} // namespace vast
+
+#endif
@@ -407,6 +407,29 @@ BOOST_AUTO_TEST_CASE(ewah_bitwise_iteration)
     cnt += 4;
     ++i;
   }
+
+  // Clean 1-blocks right before the last block.
+  ebs = {};
+  ebs.append(100, false);
+  ebs.append(1000, true);
+  cnt = 0;
+  for (auto j : ebs)
+    BOOST_CHECK_EQUAL(j, 100 + cnt++);
+  BOOST_CHECK_EQUAL(cnt, 1000);
+
+  // Clean 1-blocks followed by a dirty block which begins with a 1-bit.
+  ebs = {};
+  ebs.append(192, true);
+  ebs.push_back(true);
+  ebs.append(210, false);
+  ebs.push_back(true);
+  std::vector<ewah_bitstream::size_type> ones;
+  for (auto j : ebs)
+    ones.push_back(j);
+  BOOST_REQUIRE_EQUAL(ones.size(), 194);
+  BOOST_CHECK_EQUAL(ones[191], 191);
+  BOOST_CHECK_EQUAL(ones[192], 192);
+  BOOST_CHECK_EQUAL(ones[193], 403);
 }
 
 BOOST_AUTO_TEST_CASE(ewah_element_access)
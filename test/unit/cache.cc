@@ -1,4 +1,5 @@
 #include "test.h"
+#include <unordered_set>
 #include <vast/util/lru_cache.h>
 
 BOOST_AUTO_TEST_CASE(lru_cache)
@@ -29,3 +30,135 @@ BOOST_AUTO_TEST_CASE(lru_cache)
       v.begin(), v.end(),
       expected.begin(), expected.end());
 }
+
+BOOST_AUTO_TEST_CASE(lru_cache_weighted)
+{
+  using lru_cache = vast::util::lru_cache<std::string, size_t>;
+  lru_cache c{
+    8,
+    [](std::string const& str) { return str.length(); },
+    [](size_t n) { return n; }};
+
+  c.retrieve("foo");
+  c.retrieve("quux");
+  BOOST_CHECK_EQUAL(c.weight(), 7);
+  BOOST_CHECK_EQUAL(c.retrieve("foo"), 3);
+
+  // Makes room by evicting "quux", the least recently used entry.
+  c.retrieve("corge");
+  BOOST_CHECK_EQUAL(c.size(), 2);
+  BOOST_CHECK_EQUAL(c.weight(), 8);
+
+  // An entry larger than the capacity displaces all others.
+  c.retrieve("0123456789");
+  BOOST_CHECK_EQUAL(c.size(), 1);
+  BOOST_CHECK_EQUAL(c.weight(), 10);
+
+  BOOST_CHECK_EQUAL(c.stats().hits, 1);
+  BOOST_CHECK_EQUAL(c.stats().misses, 4);
+  BOOST_CHECK_EQUAL(c.stats().evictions, 3);
+
+  c.clear();
+  BOOST_CHECK_EQUAL(c.weight(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_admission)
+{
+  using lru_cache = vast::util::lru_cache<std::string, size_t>;
+  lru_cache c{2, [](std::string const& str) { return str.length(); }};
+  c.admission([](std::string const&, size_t n) { return n < 4; });
+
+  BOOST_CHECK_EQUAL(c.retrieve("foo"), 3);
+  BOOST_CHECK_EQUAL(c.retrieve("quux"), 4);
+  BOOST_CHECK_EQUAL(c.retrieve("quux"), 4);
+  BOOST_CHECK_EQUAL(c.size(), 1);
+  BOOST_CHECK_EQUAL(c.stats().misses, 3);
+  BOOST_CHECK_EQUAL(c.stats().rejections, 2);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_deferred_miss)
+{
+  using lru_cache = vast::util::lru_cache<std::string, size_t>;
+  lru_cache c{2, [](std::string const&) -> size_t { throw 42; }};
+  c.admission([](std::string const&, size_t n) { return n < 4; });
+
+  // A miss leaves the retrieval of the value to the caller.
+  BOOST_CHECK(c.find("foo") == nullptr);
+  BOOST_CHECK_EQUAL(c.admit("foo", 3), 3);
+  BOOST_REQUIRE(c.find("foo") != nullptr);
+  BOOST_CHECK_EQUAL(*c.find("foo"), 3);
+
+  // Admitting a resident key keeps the existing value.
+  BOOST_CHECK_EQUAL(c.admit("foo", 42), 3);
+
+  BOOST_CHECK_EQUAL(c.admit("quux", 4), 4);
+  BOOST_CHECK(c.find("quux") == nullptr);
+  BOOST_CHECK_EQUAL(c.size(), 1);
+  BOOST_CHECK_EQUAL(c.stats().hits, 2);
+  BOOST_CHECK_EQUAL(c.stats().misses, 2);
+  BOOST_CHECK_EQUAL(c.stats().rejections, 1);
+
+  // Erasing leaves no trace in the replacement policy.
+  BOOST_CHECK(c.erase("foo"));
+  BOOST_CHECK(! c.erase("foo"));
+  BOOST_CHECK(c.empty());
+  BOOST_CHECK_EQUAL(c.weight(), 0);
+  BOOST_CHECK_EQUAL(c.admit("bar", 3), 3);
+  BOOST_CHECK_EQUAL(c.admit("baz", 3), 3);
+  BOOST_CHECK_EQUAL(c.admit("qux", 3), 3);
+  BOOST_CHECK_EQUAL(c.size(), 2);
+  BOOST_CHECK_EQUAL(c.stats().evictions, 1);
+}
+
+BOOST_AUTO_TEST_CASE(cache_policies_scan_resistance)
+{
+  using vast::util::cache_policy;
+  using lru_cache = vast::util::lru_cache<size_t, size_t>;
+
+  // Each round accesses a hot set of 5 keys and then 8 keys never seen
+  // before. With room for 10 keys, LRU evicts the hot set in every round.
+  auto hot_hit_rate = [](cache_policy p, bool doorkeeper) -> double
+  {
+    lru_cache c{10, [](size_t k) { return k; }, {}, p};
+
+    // Admits only keys which missed before.
+    std::unordered_set<size_t> seen;
+    if (doorkeeper)
+      c.admission(
+          [&](size_t k, size_t) { return ! seen.insert(k).second; });
+
+    size_t next = 100;
+    uint64_t hits = 0;
+    uint64_t accesses = 0;
+    for (size_t round = 0; round < 1000; ++round)
+    {
+      for (size_t k = 0; k < 5; ++k)
+      {
+        auto before = c.stats().hits;
+        c.retrieve(k);
+        if (round >= 10)
+        {
+          hits += c.stats().hits - before;
+          ++accesses;
+        }
+      }
+
+      for (size_t i = 0; i < 8; ++i)
+        c.retrieve(next++);
+
+      BOOST_REQUIRE_LE(c.size(), 10);
+    }
+
+    return static_cast<double>(hits) / accesses;
+  };
+
+  BOOST_CHECK_EQUAL(hot_hit_rate(cache_policy::lru, false), 0.0);
+  BOOST_CHECK_EQUAL(hot_hit_rate(cache_policy::clock, false), 0.0);
+  BOOST_CHECK_GT(hot_hit_rate(cache_policy::two_queue, false), 0.99);
+  BOOST_CHECK_GT(hot_hit_rate(cache_policy::arc, false), 0.99);
+
+  // Keeping one-time keys out of the cache protects the hot set regardless
+  // of the policy.
+  BOOST_CHECK_GT(hot_hit_rate(cache_policy::lru, true), 0.99);
+  BOOST_CHECK_GT(hot_hit_rate(cache_policy::clock, true), 0.99);
+}
@@ -2,6 +2,7 @@
 
 #include "vast/chunk.h"
 #include "vast/event.h"
+#include "vast/io/serialization.h"
 
 using namespace vast;
 
@@ -29,3 +30,158 @@ BOOST_AUTO_TEST_CASE(chunking)
   chunk copy(chk);
   BOOST_CHECK(chk == copy);
 }
+
+BOOST_AUTO_TEST_CASE(chunk_offset_table)
+{
+  chunk chk;
+  {
+    chunk::writer w(chk, 100);
+    for (size_t i = 0; i < 1e3; ++i)
+      BOOST_CHECK(w.write(event{i}));
+  }
+
+  // Seeking lands on the last table entry before the target.
+  chunk::reader r(chk);
+  BOOST_CHECK_EQUAL(r.seek(742), 700);
+  BOOST_CHECK_EQUAL(r.available(), 300);
+  event e;
+  BOOST_REQUIRE(r.read(e));
+  BOOST_CHECK(e == event{700u});
+
+  // Within the reach of the current position, the reader stays put.
+  BOOST_CHECK_EQUAL(r.seek(742), 701);
+
+  // Going backwards requires a jump to an earlier entry.
+  BOOST_CHECK_EQUAL(r.seek(42), 0);
+  BOOST_REQUIRE(r.read(e));
+  BOOST_CHECK(e == event{0u});
+
+  BOOST_CHECK_EQUAL(r.seek(999), 900);
+  for (size_t i = 900; i < 1e3; ++i)
+  {
+    BOOST_REQUIRE(r.read(e));
+    BOOST_CHECK(e == event{i});
+  }
+
+  BOOST_CHECK(! r.read(e));
+}
+
+BOOST_AUTO_TEST_CASE(chunk_decompression)
+{
+  chunk chk;
+  {
+    chunk::writer w(chk, 100);
+    for (size_t i = 0; i < 1e3; ++i)
+      BOOST_CHECK(w.write(event{i}));
+  }
+
+  auto plain = chk.decompress();
+  BOOST_CHECK_EQUAL(plain.compression(), io::null);
+  BOOST_CHECK_EQUAL(plain.elements(), chk.elements());
+  BOOST_CHECK_GT(plain.compressed_bytes(), chk.compressed_bytes());
+
+  chunk::reader r(plain);
+  BOOST_CHECK_EQUAL(r.seek(742), 700);
+  for (size_t i = 700; i < 1e3; ++i)
+  {
+    event e;
+    BOOST_REQUIRE(r.read(e));
+    BOOST_CHECK(e == event{i});
+  }
+}
+
+BOOST_AUTO_TEST_CASE(chunk_automatic_compression)
+{
+  // Repetitive data compresses, and the offset table survives the selection
+  // of the method.
+  chunk compressible{io::automatic, io::fastest};
+  {
+    chunk::writer w(compressible, 100);
+    for (size_t i = 0; i < 1e3; ++i)
+      BOOST_CHECK(w.write(event{i % 10, "foo"}));
+  }
+
+  BOOST_CHECK(compressible.compression() != io::automatic);
+  BOOST_CHECK(compressible.compression() != io::null);
+  BOOST_CHECK_LT(compressible.compressed_bytes(),
+                 compressible.uncompressed_bytes());
+
+  chunk::reader r(compressible);
+  BOOST_CHECK_EQUAL(r.seek(742), 700);
+  event e;
+  BOOST_REQUIRE(r.read(e));
+  BOOST_CHECK(e == (event{700u % 10, "foo"}));
+
+  // Random data does not compress, so we store it as is.
+  chunk incompressible{io::automatic};
+  uint64_t x = 42;
+  {
+    chunk::writer w(incompressible);
+    for (size_t i = 0; i < 1e4; ++i)
+    {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      BOOST_CHECK(w.write(x));
+    }
+  }
+
+  BOOST_CHECK(incompressible.compression() == io::null);
+  chunk::reader s(incompressible);
+  x = 42;
+  for (size_t i = 0; i < 1e4; ++i)
+  {
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+    uint64_t y;
+    BOOST_REQUIRE(s.read(y));
+    BOOST_CHECK_EQUAL(x, y);
+  }
+}
+
+#ifdef VAST_HAVE_ZSTD
+BOOST_AUTO_TEST_CASE(chunk_zstd_dictionary)
+{
+  std::vector<event> events;
+  for (size_t i = 0; i < 1e4; ++i)
+    events.push_back(event{i % 13, "conn-" + std::to_string(i % 100),
+                           "tcp", "SF", i * 3});
+
+  // Train on the serialized events, as segment::writer does.
+  std::vector<std::vector<uint8_t>> samples;
+  for (size_t i = 0; i < 2000; ++i)
+  {
+    samples.emplace_back();
+    io::archive(samples.back(), events[i]);
+  }
+
+  auto dict = io::zstd_registry::train(samples, 4 << 10);
+  BOOST_REQUIRE(dict);
+  auto id = io::zstd_registry::instance()->add(*dict);
+  BOOST_REQUIRE(id);
+  BOOST_CHECK(io::zstd_registry::instance()->find(*id) != nullptr);
+  io::zstd_registry::instance()->assign("conn", *id);
+  BOOST_CHECK_EQUAL(io::zstd_registry::instance()->lookup("conn"), *id);
+  BOOST_CHECK_EQUAL(io::zstd_registry::instance()->lookup("dns"), 0);
+
+  // Dictionaries pay off for small chunks.
+  chunk plain{io::zstd};
+  chunk trained{io::zstd};
+  {
+    chunk::writer w1{plain};
+    chunk::writer w2{trained, 0, *id};
+    for (size_t i = 5000; i < 5010; ++i)
+    {
+      BOOST_CHECK(w1.write(events[i]));
+      BOOST_CHECK(w2.write(events[i]));
+    }
+  }
+
+  BOOST_CHECK_LT(trained.compressed_bytes(), plain.compressed_bytes());
+
+  chunk::reader r{trained};
+  for (size_t i = 5000; i < 5010; ++i)
+  {
+    event e;
+    BOOST_REQUIRE(r.read(e));
+    BOOST_CHECK(e == events[i]);
+  }
+}
+#endif // VAST_HAVE_ZSTD
@@ -0,0 +1,62 @@
+#include "test.h"
+
+#include "vast/address.h"
+#include "vast/columnar.h"
+#include "vast/port.h"
+
+using namespace vast;
+
+BOOST_AUTO_TEST_CASE(columnar_chunk)
+{
+  std::vector<event> events;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    event e{
+      time_point{time_range::seconds(1000 + i)},
+      "s" + std::to_string(i % 7),
+      address{"192.168.0.1"},
+      port{static_cast<port::number_type>(i), port::tcp},
+      static_cast<int>(i) - 500,
+      i,
+      4.2,
+      value{string_value}};
+
+    e.name(i % 3 == 0 ? "foo" : "bar");
+    e.timestamp(time_point{time_range::seconds(i)});
+
+    // Events of type "bar" have a varying number of fields.
+    if (i % 3 != 0 && i % 10 == 0)
+      e.emplace_back(true);
+
+    events.push_back(std::move(e));
+  }
+
+  chunk chk;
+  BOOST_REQUIRE(write_columns(events, chk));
+  BOOST_CHECK_EQUAL(chk.elements(), 1000);
+
+  // Two columns for types and timestamps, one for the "bar" events, and one
+  // per field of the "foo" events.
+  BOOST_CHECK_EQUAL(chk.columns().size(), 11);
+
+  column_reader r{chk};
+  BOOST_REQUIRE_EQUAL(r.size(), 1000);
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    auto e = r.read(i);
+    BOOST_REQUIRE(e);
+    BOOST_CHECK_EQUAL(*e, events[i]);
+  }
+
+  // Materialize a single field only.
+  std::vector<size_t> fields{3};
+  auto e = r.read(6, &fields);
+  BOOST_REQUIRE(e);
+  BOOST_CHECK_EQUAL(e->name(), "foo");
+  BOOST_REQUIRE_EQUAL(e->size(), 8);
+  BOOST_CHECK_EQUAL((*e)[3], (port{6, port::tcp}));
+  BOOST_CHECK((*e)[0].invalid());
+  BOOST_CHECK((*e)[2].invalid());
+
+  BOOST_CHECK(! r.read(1000));
+}
@@ -1,5 +1,8 @@
 #include "test.h"
+#include <thread>
 #include "vast/event.h"
+#include "vast/event_type_registry.h"
+#include "vast/io/serialization.h"
 
 using namespace vast;
 
@@ -34,6 +37,67 @@ BOOST_AUTO_TEST_CASE(event_construction)
   BOOST_CHECK_EQUAL(event{42}[0].which(), int_value);
 }
 
+BOOST_AUTO_TEST_CASE(event_types)
+{
+  auto registry = event_type_registry::instance();
+  BOOST_CHECK_EQUAL(*registry->name(unnamed_event_type), "");
+  BOOST_CHECK(! registry->lookup("event-types-test"));
+
+  auto t = registry->intern("event-types-test");
+  BOOST_CHECK_NE(t, unnamed_event_type);
+  BOOST_CHECK_EQUAL(registry->intern("event-types-test"), t);
+  BOOST_CHECK_EQUAL(*registry->lookup("event-types-test"), t);
+  BOOST_CHECK_EQUAL(*registry->name(t), "event-types-test");
+  BOOST_CHECK(registry->name(registry->size()) == nullptr);
+
+  event e0{42};
+  BOOST_CHECK_EQUAL(e0.type(), unnamed_event_type);
+  e0.name("event-types-test");
+  BOOST_CHECK_EQUAL(e0.type(), t);
+
+  event e1{42};
+  e1.type(t);
+  BOOST_CHECK_EQUAL(e1.name(), "event-types-test");
+  BOOST_CHECK_EQUAL(e0, e1);
+
+  // Serialized events carry their name rather than their type.
+  event e2;
+  std::vector<uint8_t> buf;
+  io::archive(buf, e0);
+  io::unarchive(buf, e2);
+  BOOST_CHECK_EQUAL(e2.type(), t);
+  BOOST_CHECK_EQUAL(e0, e2);
+}
+
+BOOST_AUTO_TEST_CASE(event_types_concurrent)
+{
+  // Readers look up names while a writer interns enough of them to allocate
+  // new blocks.
+  auto registry = event_type_registry::instance();
+  auto first = registry->size();
+  std::thread writer{[=]
+  {
+    for (size_t i = 0; i < 3000; ++i)
+      registry->intern("concurrent-" + std::to_string(i));
+  }};
+
+  auto valid = true;
+  while (registry->size() < first + 3000)
+  {
+    auto t = registry->size() - 1;
+    auto name = registry->name(t);
+    if (name == nullptr)
+      valid = false;
+    else if (t >= first)
+      valid = valid &&
+        *name == string{"concurrent-" + std::to_string(t - first)};
+  }
+
+  writer.join();
+  BOOST_CHECK(valid);
+  BOOST_CHECK_EQUAL(*registry->name(first + 1500), "concurrent-1500");
+}
+
 BOOST_AUTO_TEST_CASE(quantifiers)
 {
   event e{
@@ -78,3 +78,55 @@ BOOST_AUTO_TEST_CASE(basic_filesystem_tests)
   BOOST_CHECK(rm(p.parent()));
   BOOST_CHECK(! p.parent().is_directory());
 }
+
+BOOST_AUTO_TEST_CASE(globbing)
+{
+  using std::to_string;
+  path dir = "/tmp/vast-unit-test-glob";
+  dir /= string(to_string(getpid()));
+  BOOST_REQUIRE(mkdir(dir));
+  for (auto name : {"b.log", "a.log", "c.txt"})
+  {
+    file f{dir / name};
+    BOOST_REQUIRE(f.open(file::write_only));
+    BOOST_REQUIRE(f.write("foo", 3));
+  }
+
+  auto paths = glob((dir / "*.log").str().data());
+  BOOST_REQUIRE_EQUAL(paths.size(), 2);
+  BOOST_CHECK_EQUAL(paths[0], dir / "a.log");
+  BOOST_CHECK_EQUAL(paths[1], dir / "b.log");
+  BOOST_CHECK(glob((dir / "*.gz").str().data()).empty());
+
+  auto size = file_size(paths[0]);
+  BOOST_REQUIRE(size);
+  BOOST_CHECK_EQUAL(*size, 3);
+  BOOST_CHECK(! file_size(dir / "d.log"));
+
+  BOOST_CHECK(rm(dir));
+  BOOST_CHECK(rm(dir.parent()));
+}
+
+BOOST_AUTO_TEST_CASE(durable_rename)
+{
+  using std::to_string;
+  path dir = "/tmp/vast-unit-test-sync";
+  dir /= string(to_string(getpid()));
+  BOOST_REQUIRE(mkdir(dir));
+
+  {
+    file f{dir / "foo.tmp"};
+    BOOST_REQUIRE(f.open(file::write_only));
+    BOOST_REQUIRE(f.write("foo", 3));
+    BOOST_CHECK(f.sync(false));
+  }
+
+  BOOST_REQUIRE(mv(dir / "foo.tmp", dir / "foo"));
+  BOOST_CHECK(sync_directory(dir));
+  BOOST_CHECK(! exists(dir / "foo.tmp"));
+  BOOST_CHECK_EQUAL(*file_size(dir / "foo"), 3);
+  BOOST_CHECK(! sync_directory(dir / "bar"));
+
+  BOOST_CHECK(rm(dir));
+  BOOST_CHECK(rm(dir.parent()));
+}
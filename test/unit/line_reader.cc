@@ -0,0 +1,222 @@
+#include "test.h"
+#include <unistd.h>
+#include "vast/file_system.h"
+#include "vast/io/line_reader.h"
+#include "lz4/lz4.h"
+
+#ifdef VAST_HAVE_ZLIB
+#  include <zlib.h>
+#endif // VAST_HAVE_ZLIB
+
+#ifdef VAST_HAVE_BZIP2
+#  include <bzlib.h>
+#endif // VAST_HAVE_BZIP2
+
+using namespace vast;
+
+namespace {
+
+void check_lines(io::line_reader& reader)
+{
+  char const* data;
+  size_t size;
+  std::vector<std::string> lines;
+  while (reader.next(&data, &size))
+    lines.emplace_back(data, size);
+
+  std::vector<std::string> expected{
+    "", "1st", "line", "n3", "line4", "line5", "", "line6"};
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(lines.begin(), lines.end(),
+                                expected.begin(), expected.end());
+}
+
+// Feeds compressed input through a pipe and a regular file.
+void check_compressed(std::vector<char> const& input,
+                      io::file_compression format)
+{
+  int fds[2];
+  BOOST_REQUIRE(::pipe(fds) == 0);
+  BOOST_REQUIRE(::write(fds[1], input.data(), input.size()) > 0);
+  ::close(fds[1]);
+  {
+    file f{path{"pipe"}, fds[0]};
+    io::line_reader reader{f, 7};
+    BOOST_CHECK(reader.compression() == format);
+    check_lines(reader);
+    BOOST_CHECK(reader.failure().msg().empty());
+  }
+
+  path p{"/tmp/vast-unit-test-line-reader-compressed"};
+  {
+    file f{p};
+    BOOST_REQUIRE(f.open(file::write_only));
+    BOOST_REQUIRE(f.write(input.data(), input.size()));
+  }
+
+  file f{p};
+  BOOST_REQUIRE(f.open(file::read_only));
+  io::line_reader reader{f};
+  BOOST_CHECK(! reader.mapped());
+  BOOST_CHECK(reader.compression() == format);
+  check_lines(reader);
+  BOOST_CHECK(rm(p));
+}
+
+} // namespace <anonymous>
+
+BOOST_AUTO_TEST_CASE(line_reader_mapped)
+{
+  auto str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  path p{"/tmp/vast-unit-test-line-reader"};
+  {
+    file f{p};
+    BOOST_REQUIRE(f.open(file::write_only));
+    BOOST_REQUIRE(f.write(str, std::strlen(str)));
+  }
+
+  file f{p};
+  BOOST_REQUIRE(f.open(file::read_only));
+  io::line_reader reader{f};
+  BOOST_CHECK(reader.mapped());
+  check_lines(reader);
+  BOOST_CHECK(rm(p));
+}
+
+BOOST_AUTO_TEST_CASE(line_reader_buffered)
+{
+  auto str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  for (size_t i = 1; i < 10; ++i)
+  {
+    int fds[2];
+    BOOST_REQUIRE(::pipe(fds) == 0);
+    BOOST_REQUIRE(::write(fds[1], str, std::strlen(str)) > 0);
+    ::close(fds[1]);
+
+    file f{path{"pipe"}, fds[0]};
+    io::line_reader reader{f, i};
+    BOOST_CHECK(! reader.mapped());
+    check_lines(reader);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(line_reader_lz4)
+{
+  // The legacy lz4 format: a magic number followed by blocks, each prefixed
+  // with its compressed size.
+  std::string str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  std::vector<char> input{0x02, 0x21, 0x4c, 0x18};
+  auto split = str.size() / 2;
+  for (auto part : {str.substr(0, split), str.substr(split)})
+  {
+    std::vector<char> block(LZ4_compressBound(part.size()));
+    auto n = LZ4_compress(part.data(), block.data(), part.size());
+    BOOST_REQUIRE(n > 0);
+    for (auto i = 0; i < 4; ++i)
+      input.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+    input.insert(input.end(), block.begin(), block.begin() + n);
+  }
+
+  check_compressed(input, io::file_compression::lz4);
+
+  input.resize(input.size() - 1);
+  int fds[2];
+  BOOST_REQUIRE(::pipe(fds) == 0);
+  BOOST_REQUIRE(::write(fds[1], input.data(), input.size()) > 0);
+  ::close(fds[1]);
+  file f{path{"pipe"}, fds[0]};
+  io::line_reader reader{f};
+  char const* data;
+  size_t size;
+  while (reader.next(&data, &size))
+    ;
+  BOOST_CHECK(! reader.failure().msg().empty());
+}
+
+BOOST_AUTO_TEST_CASE(line_reader_lz4_frame)
+{
+  // An lz4 frame with independent blocks and without checksums: the magic
+  // number, the frame descriptor, blocks prefixed with their compressed size,
+  // and the end mark. We store the second block uncompressed.
+  std::string str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  std::vector<char> input{0x04, 0x22, 0x4d, 0x18, 0x60, 0x40, char(0x82)};
+  auto append_le32 = [&](uint32_t x)
+  {
+    for (auto i = 0; i < 4; ++i)
+      input.push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+  };
+
+  auto split = str.size() / 2;
+  auto first = str.substr(0, split);
+  std::vector<char> block(LZ4_compressBound(first.size()));
+  auto n = LZ4_compress(first.data(), block.data(), first.size());
+  BOOST_REQUIRE(n > 0);
+  append_le32(n);
+  input.insert(input.end(), block.begin(), block.begin() + n);
+  auto second = str.substr(split);
+  append_le32(second.size() | 0x80000000);
+  input.insert(input.end(), second.begin(), second.end());
+  append_le32(0);
+  check_compressed(input, io::file_compression::lz4);
+
+  // The same lines compressed by the lz4 command line tool, once with the
+  // default settings and once with linked blocks and the content size, both
+  // with a content checksum. A skippable frame follows the second one.
+  std::vector<uint8_t> const lz4_default{
+    0x04, 0x22, 0x4d, 0x18, 0x64, 0x40, 0xa7, 0x1d, 0x00, 0x00, 0x00, 0xd1,
+    0x0a, 0x31, 0x73, 0x74, 0x0a, 0x6c, 0x69, 0x6e, 0x65, 0x0d, 0x6e, 0x33,
+    0x0d, 0x09, 0x00, 0x11, 0x34, 0x06, 0x00, 0x80, 0x35, 0x0a, 0x0a, 0x6c,
+    0x69, 0x6e, 0x65, 0x36, 0x00, 0x00, 0x00, 0x00, 0xb2, 0xfa, 0x56, 0x64};
+  check_compressed({lz4_default.begin(), lz4_default.end()},
+                   io::file_compression::lz4);
+
+  std::vector<uint8_t> const lz4_linked{
+    0x04, 0x22, 0x4d, 0x18, 0x6c, 0x40, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xc6, 0x1d, 0x00, 0x00, 0x00, 0xd1, 0x0a, 0x31, 0x73, 0x74,
+    0x0a, 0x6c, 0x69, 0x6e, 0x65, 0x0d, 0x6e, 0x33, 0x0d, 0x09, 0x00, 0x11,
+    0x34, 0x06, 0x00, 0x80, 0x35, 0x0a, 0x0a, 0x6c, 0x69, 0x6e, 0x65, 0x36,
+    0x00, 0x00, 0x00, 0x00, 0xb2, 0xfa, 0x56, 0x64,
+    0x50, 0x2a, 0x4d, 0x18, 0x02, 0x00, 0x00, 0x00, 0x2a, 0x2a};
+  check_compressed({lz4_linked.begin(), lz4_linked.end()},
+                   io::file_compression::lz4);
+}
+
+#ifdef VAST_HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(line_reader_gzip)
+{
+  // Two concatenated gzip members, as produced by appending to a .gz file.
+  std::string str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  std::vector<char> input;
+  auto split = str.size() / 2;
+  for (auto part : {str.substr(0, split), str.substr(split)})
+  {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    BOOST_REQUIRE(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+                               8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::vector<char> member(deflateBound(&zs, part.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(&part[0]);
+    zs.avail_in = part.size();
+    zs.next_out = reinterpret_cast<Bytef*>(member.data());
+    zs.avail_out = member.size();
+    BOOST_REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    input.insert(input.end(), member.begin(), member.begin() + zs.total_out);
+    deflateEnd(&zs);
+  }
+
+  check_compressed(input, io::file_compression::gzip);
+}
+#endif // VAST_HAVE_ZLIB
+
+#ifdef VAST_HAVE_BZIP2
+BOOST_AUTO_TEST_CASE(line_reader_bzip2)
+{
+  std::string str = "\n1st\nline\rn3\r\nline4\nline5\n\nline6";
+  std::vector<char> input(1024);
+  auto n = static_cast<unsigned>(input.size());
+  BOOST_REQUIRE(BZ2_bzBuffToBuffCompress(input.data(), &n, &str[0],
+                                         str.size(), 9, 0, 0) == BZ_OK);
+  input.resize(n);
+  check_compressed(input, io::file_compression::bzip2);
+}
+#endif // VAST_HAVE_BZIP2
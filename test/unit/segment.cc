@@ -1,7 +1,17 @@
 #include "test.h"
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <thread>
+#include "vast/archive.h"
 #include "vast/bitstream.h"
+#include "vast/catalog.h"
 #include "vast/event.h"
+#include "vast/file_system.h"
 #include "vast/segment.h"
+#include "vast/io/serialization.h"
+#include "vast/util/thread_pool.h"
 
 using namespace vast;
 
@@ -162,3 +172,536 @@ BOOST_AUTO_TEST_CASE(segment_event_extraction)
     ++mi;
   }
 }
+
+BOOST_AUTO_TEST_CASE(segment_event_types)
+{
+  segment s;
+  {
+    segment::writer w(&s);
+    for (size_t i = 0; i < 100; ++i)
+    {
+      event e{i};
+      e.name(i % 3 == 0 ? "foo" : "bar");
+      BOOST_CHECK(w.write(e));
+    }
+  }
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, s);
+  segment t;
+  io::unarchive(buf, t);
+
+  segment::reader r{&t};
+  size_t n = 0;
+  while (auto e = r.read())
+  {
+    BOOST_CHECK_EQUAL(e->name(), n % 3 == 0 ? "foo" : "bar");
+    BOOST_CHECK_EQUAL((*e)[0], n);
+    ++n;
+  }
+
+  BOOST_CHECK_EQUAL(n, 100);
+}
+
+BOOST_AUTO_TEST_CASE(segment_columnar_layout)
+{
+  segment s;
+  s.base(1000);
+  {
+    segment::writer w{&s, 256, segment::columnar};
+    for (size_t i = 0; i < 1024; ++i)
+    {
+      event e{i, "x" + std::to_string(i % 7)};
+      e.name(i % 2 == 0 ? "foo" : "bar");
+      BOOST_CHECK(w.write(e));
+    }
+  }
+
+  BOOST_REQUIRE_EQUAL(s.events(), 1024);
+
+  segment::reader r{&s};
+  BOOST_CHECK(r.columnar());
+  BOOST_CHECK(r.seek(1720));
+  auto e = r.read();
+  BOOST_REQUIRE(e);
+  BOOST_CHECK_EQUAL(e->id(), 1720);
+  BOOST_CHECK_EQUAL(e->name(), "foo");
+  BOOST_CHECK_EQUAL((*e)[0], 720u);
+  BOOST_CHECK_EQUAL((*e)[1], "x6");
+
+  std::vector<size_t> fields{1};
+  e = r.read(1003, &fields);
+  BOOST_REQUIRE(e);
+  BOOST_CHECK_EQUAL(e->name(), "bar");
+  BOOST_CHECK(! (*e)[0]);
+  BOOST_CHECK_EQUAL((*e)[1], "x3");
+}
+
+BOOST_AUTO_TEST_CASE(segment_compression_pool)
+{
+  auto pool = std::make_shared<util::thread_pool>(2);
+  for (auto l : {segment::row, segment::columnar})
+  {
+    segment s;
+    segment::writer w{&s, 100, l, io::balanced, pool};
+    for (size_t i = 0; i < 1050; ++i)
+      BOOST_CHECK(w.write(event{i}));
+
+    BOOST_CHECK(w.flush());
+    BOOST_REQUIRE_EQUAL(s.events(), 1050);
+
+    segment::reader r{&s};
+    size_t n = 0;
+    while (auto e = r.read())
+      BOOST_CHECK_EQUAL(*e, (event{n++}));
+    BOOST_CHECK_EQUAL(n, 1050);
+  }
+
+  // When a segment becomes full, the writer rejects the next event and
+  // keeps all events it took for the next segments.
+  std::deque<segment> segments;
+  segments.emplace_back(uuid::nil(), 4096);
+  segment::writer w{&segments.back(), 100, segment::row, io::balanced, pool};
+  for (size_t i = 0; i < 10000; ++i)
+    if (! w.write(event{i}))
+    {
+      do
+      {
+        segments.emplace_back(uuid::nil(), 4096);
+        w.attach_to(&segments.back());
+      }
+      while (! w.flush());
+
+      BOOST_REQUIRE(w.write(event{i}));
+    }
+
+  while (! w.flush())
+  {
+    segments.emplace_back(uuid::nil(), 4096);
+    w.attach_to(&segments.back());
+  }
+
+  BOOST_CHECK_GT(segments.size(), 1);
+
+  size_t n = 0;
+  for (auto& s : segments)
+  {
+    segment::reader r{&s};
+    while (auto e = r.read())
+      BOOST_CHECK_EQUAL(*e, (event{n++}));
+  }
+
+  BOOST_CHECK_EQUAL(n, 10000);
+}
+
+BOOST_AUTO_TEST_CASE(segment_compression_backlog)
+{
+  // We stall the only thread of the pool, so that the writer accumulates
+  // two sealed chunks plus the current one.
+  auto pool = std::make_shared<util::thread_pool>(1);
+  std::promise<void> stalled;
+  auto resume = stalled.get_future().share();
+  pool->submit([resume] { resume.wait(); });
+
+  // Each segment takes only a single chunk, so the writer needs three
+  // segments for its backlog.
+  std::deque<segment> segments;
+  segments.emplace_back(uuid::nil(), 1);
+  segment::writer w{&segments.back(), 100, segment::row, io::balanced, pool};
+  for (size_t i = 0; i < 250; ++i)
+    BOOST_REQUIRE(w.write(event{i}));
+
+  stalled.set_value();
+  while (! w.flush())
+  {
+    segments.emplace_back(uuid::nil(), 1);
+    w.attach_to(&segments.back());
+  }
+
+  BOOST_REQUIRE_EQUAL(segments.size(), 3);
+  BOOST_CHECK_EQUAL(segments[0].events(), 100);
+  BOOST_CHECK_EQUAL(segments[1].events(), 100);
+  BOOST_CHECK_EQUAL(segments[2].events(), 50);
+
+  size_t n = 0;
+  for (auto& s : segments)
+  {
+    segment::reader r{&s};
+    while (auto e = r.read())
+      BOOST_CHECK_EQUAL(*e, (event{n++}));
+  }
+
+  BOOST_CHECK_EQUAL(n, 250);
+}
+
+BOOST_AUTO_TEST_CASE(segment_writer_discards_pending_chunks)
+{
+  // The third chunk waits behind the second stall while the writer gets
+  // destroyed, so the writer must not free the chunk before the pool
+  // compressed it.
+  auto pool = std::make_shared<util::thread_pool>(1);
+  std::promise<void> first;
+  std::promise<void> second;
+  auto resume_first = first.get_future().share();
+  auto resume_second = second.get_future().share();
+  pool->submit([resume_first] { resume_first.wait(); });
+
+  std::atomic<bool> resumed{false};
+  std::thread resumer;
+  segment s{uuid::nil(), 1};
+  {
+    segment::writer w{&s, 100, segment::row, io::balanced, pool};
+    for (size_t i = 0; i < 200; ++i)
+      BOOST_REQUIRE(w.write(event{i}));
+
+    pool->submit([resume_second] { resume_second.wait(); });
+    for (size_t i = 0; i < 50; ++i)
+      BOOST_REQUIRE(w.write(event{i}));
+
+    first.set_value();
+    resumer = std::thread{[&]
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      resumed = true;
+      second.set_value();
+    }};
+  }
+
+  BOOST_CHECK(resumed);
+  resumer.join();
+  BOOST_CHECK_EQUAL(s.events(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(segment_read_ahead)
+{
+  for (auto l : {segment::row, segment::columnar})
+  {
+    segment s;
+    s.base(1000);
+    {
+      segment::writer w{&s, 100, l};
+      for (size_t i = 0; i < 2048; ++i)
+        BOOST_CHECK(w.write(event{i, "x" + std::to_string(i % 7)}));
+    }
+
+    segment::reader r{&s};
+    r.read_ahead(std::make_shared<util::thread_pool>(2), 4);
+    size_t n = 0;
+    while (auto e = r.read())
+    {
+      BOOST_CHECK_EQUAL(e->id(), 1000 + n);
+      BOOST_CHECK_EQUAL((*e)[0], n);
+      ++n;
+    }
+
+    BOOST_CHECK_EQUAL(n, 2048);
+
+    // Seeking within and across the window.
+    for (event_id id : {1050, 1720, 1010, 2047, 1000})
+    {
+      BOOST_REQUIRE(r.seek(id));
+      auto e = r.read();
+      BOOST_REQUIRE(e);
+      BOOST_CHECK_EQUAL((*e)[0], id - 1000);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(segment_mapping)
+{
+  path const filename = "/tmp/vast-unit-test-segment";
+  for (auto l : {segment::row, segment::columnar})
+  {
+    segment s{uuid::random()};
+    s.base(1000);
+    {
+      segment::writer w{&s, 100, l};
+      for (size_t i = 0; i < 1024; ++i)
+      {
+        event e{i, "x" + std::to_string(i % 7)};
+        e.name(i % 2 == 0 ? "foo" : "bar");
+        BOOST_CHECK(w.write(e));
+      }
+    }
+
+    BOOST_REQUIRE(s.save(filename));
+
+    // Archives read only the header of segment files.
+    segment::header h;
+    BOOST_REQUIRE(io::unarchive(filename, h));
+    BOOST_CHECK_EQUAL(h.id, s.id());
+    BOOST_CHECK_EQUAL(h.n, 1024);
+
+    // A copy of a mapped segment keeps the mapping alive.
+    segment copy;
+    {
+      segment m;
+      BOOST_REQUIRE(m.map(filename));
+      BOOST_CHECK(m == s);
+      BOOST_CHECK_EQUAL(m.bytes(), s.bytes());
+      copy = m;
+
+      // Files whose size does not match their outline do not map, and leave
+      // the segment as it was.
+      path const damaged = "/tmp/vast-unit-test-segment-damaged";
+      std::ifstream in{to_string(filename), std::ios::binary};
+      std::string contents{std::istreambuf_iterator<char>{in},
+                           std::istreambuf_iterator<char>{}};
+      auto garbage = contents + "xx";
+      for (auto size : {contents.size() - 1, contents.size() / 2,
+                        garbage.size()})
+      {
+        std::ofstream out{to_string(damaged), std::ios::binary};
+        out.write(garbage.data(), size);
+        out.close();
+        BOOST_CHECK(! m.map(damaged));
+      }
+
+      BOOST_CHECK(rm(damaged));
+
+      BOOST_CHECK(m == s);
+      BOOST_CHECK_EQUAL(m.events(), 1024);
+      segment::reader r{&m};
+      auto e = r.read();
+      BOOST_REQUIRE(e);
+      BOOST_CHECK_EQUAL((*e)[1], "x0");
+    }
+
+    BOOST_CHECK(rm(filename));
+
+    segment::reader r1{&s};
+    segment::reader r2{&copy};
+    BOOST_REQUIRE(r2.seek(1720));
+    auto e = r2.read();
+    BOOST_REQUIRE(e);
+    BOOST_CHECK_EQUAL(e->name(), "foo");
+    BOOST_CHECK_EQUAL((*e)[1], "x6");
+
+    BOOST_REQUIRE(r2.seek(1000));
+    size_t n = 0;
+    while (auto e2 = r2.read())
+    {
+      auto e1 = r1.read();
+      BOOST_REQUIRE(e1);
+      BOOST_CHECK_EQUAL(*e1, *e2);
+      ++n;
+    }
+
+    BOOST_CHECK_EQUAL(n, 1024);
+  }
+
+  segment s;
+  BOOST_CHECK(! s.map(filename));
+}
+
+BOOST_AUTO_TEST_CASE(segment_catalog)
+{
+  path const dir = "/tmp/vast-unit-test-catalog";
+  if (exists(dir))
+    BOOST_REQUIRE(rm(dir));
+
+  std::vector<segment::header> headers(3);
+  for (size_t i = 0; i < headers.size(); ++i)
+  {
+    headers[i].id = uuid::random();
+    headers[i].base = 1 + i * 100;
+    headers[i].n = 100;
+    headers[i].occupied_bytes = 4096 * (i + 1);
+  }
+
+  catalog c{dir / "catalog"};
+  BOOST_CHECK(! c.load());
+  BOOST_CHECK(c.sync());
+  BOOST_REQUIRE(c.add(headers[0]));
+  BOOST_REQUIRE(c.add(headers[1]));
+  BOOST_REQUIRE(c.sync());
+  BOOST_CHECK(c.dirty());
+
+  // Records are in the file right after adding them.
+  {
+    catalog d{dir / "catalog"};
+    BOOST_REQUIRE(d.load());
+    BOOST_REQUIRE_EQUAL(d.segments().size(), 2);
+    BOOST_CHECK(d.segments()[0] == headers[0]);
+    BOOST_CHECK(d.segments()[1] == headers[1]);
+  }
+
+  // Appending continues after a checkpoint replaced the file.
+  BOOST_REQUIRE(c.checkpoint());
+  BOOST_CHECK(! c.dirty());
+  BOOST_REQUIRE(c.add(headers[2]));
+  BOOST_REQUIRE(c.sync());
+  auto size = file_size(dir / "catalog");
+  BOOST_REQUIRE(size);
+
+  {
+    catalog d{dir / "catalog"};
+    BOOST_REQUIRE(d.load());
+    BOOST_CHECK(d.segments() == headers);
+  }
+
+  // A torn record invalidates the catalog.
+  {
+    file f{dir / "catalog"};
+    BOOST_REQUIRE(f.open(file::write_only, true));
+    BOOST_REQUIRE(f.write("\x2a\0\0\0\0", 5));
+  }
+
+  catalog d{dir / "catalog"};
+  BOOST_CHECK(! d.load());
+  d.reset(headers);
+  BOOST_REQUIRE(d.checkpoint());
+  BOOST_CHECK_EQUAL(*file_size(dir / "catalog"), *size);
+  BOOST_REQUIRE(d.load());
+  BOOST_CHECK(d.segments() == headers);
+
+  BOOST_CHECK(rm(dir));
+}
+
+BOOST_AUTO_TEST_CASE(archive_compaction_recovery)
+{
+  path const dir = "/tmp/vast-unit-test-archive";
+  if (exists(dir))
+    BOOST_REQUIRE(rm(dir));
+
+  BOOST_REQUIRE(mkdir(dir));
+  auto make = [&](event_id base, size_t n) -> segment
+  {
+    segment s{uuid::random()};
+    s.base(base);
+    segment::writer w{&s, 10};
+    for (size_t i = 0; i < n; ++i)
+      BOOST_REQUIRE(w.write(event{i}));
+
+    BOOST_REQUIRE(w.flush());
+    BOOST_REQUIRE(s.save(dir / path{to_string(s.id())}));
+    return s;
+  };
+
+  auto has = [&](segment const& s)
+  {
+    return exists(dir / path{to_string(s.id())});
+  };
+
+  auto x = make(1, 10);
+  auto y = make(11, 10);
+  auto merged = make(1, 20);
+
+  // A crash before the checkpoint with the merged segment leaves the catalog
+  // referring to the original segments.
+  {
+    archive a{dir};
+    BOOST_REQUIRE(a.store(x));
+    BOOST_REQUIRE(a.commit(x.id()));
+    BOOST_REQUIRE(a.store(y));
+    BOOST_REQUIRE(a.commit(y.id()));
+    BOOST_REQUIRE(a.sync());
+    BOOST_REQUIRE(a.prepare(merged.id(), {x.id(), y.id()}));
+  }
+
+  {
+    archive a{dir};
+    a.load();
+    BOOST_CHECK(has(x));
+    BOOST_CHECK(has(y));
+    BOOST_CHECK(! has(merged));
+    BOOST_CHECK(*get<0>(a.lookup(15)) == y.id());
+  }
+
+  // Without a usable catalog, the scan prefers the merged segment over the
+  // segments it covers.
+  merged = make(1, 20);
+  {
+    archive a{dir};
+    BOOST_REQUIRE(a.prepare(merged.id(), {x.id(), y.id()}));
+    std::ofstream out{to_string(dir / "catalog"), std::ios::app};
+    out << "garbage";
+  }
+
+  {
+    archive a{dir};
+    a.load();
+    BOOST_CHECK(! has(x));
+    BOOST_CHECK(! has(y));
+    BOOST_CHECK(has(merged));
+    BOOST_CHECK(*get<0>(a.lookup(15)) == merged.id());
+  }
+
+  // A merged segment which did not reach its file entirely gets discarded.
+  x = make(1, 10);
+  y = make(11, 10);
+  auto torn = make(1, 20);
+  {
+    archive a{dir};
+    BOOST_REQUIRE(a.prepare(torn.id(), {x.id(), y.id()}));
+    std::ofstream out{to_string(dir / path{to_string(torn.id())}),
+                      std::ios::binary | std::ios::trunc};
+    out << "torn";
+  }
+
+  // The scan skips segments of an older format.
+  auto const old = dir / path{to_string(uuid::random())};
+  BOOST_REQUIRE(io::archive(old, segment::header::magic, uint32_t{3}));
+  BOOST_REQUIRE(rm(dir / "catalog"));
+  BOOST_REQUIRE(rm(dir / path{to_string(merged.id())}));
+  {
+    archive a{dir};
+    a.load();
+    BOOST_CHECK(has(x));
+    BOOST_CHECK(has(y));
+    BOOST_CHECK(! has(torn));
+    BOOST_CHECK(exists(old));
+    BOOST_CHECK(*get<0>(a.lookup(15)) == y.id());
+    BOOST_CHECK_EQUAL(a.compaction_candidates(1 << 30).size(), 1);
+  }
+
+  BOOST_REQUIRE(rm(old));
+
+  // After a failed scan, a checkpoint would drop the segments in conflict.
+  BOOST_REQUIRE(rm(dir / "catalog"));
+  auto overlapping = make(5, 10);
+  archive a{dir};
+  BOOST_CHECK(! a.scan());
+  BOOST_CHECK(! a.checkpoint());
+  BOOST_CHECK(! exists(dir / "catalog"));
+  BOOST_CHECK(has(x));
+  BOOST_CHECK(has(overlapping));
+
+  BOOST_CHECK(rm(dir));
+}
+
+#ifdef VAST_HAVE_ZSTD
+BOOST_AUTO_TEST_CASE(segment_zstd_dictionary)
+{
+  // Enough events for the writer to train a dictionary for their type
+  // midway through.
+  segment s{uuid::random(), 0, io::zstd};
+  {
+    segment::writer w{&s, 1000};
+    for (size_t i = 0; i < 1e5; ++i)
+    {
+      event e{i, "C" + std::to_string(i * 7919 % 100003), "tcp"};
+      e.name("conn");
+      BOOST_CHECK(w.write(e));
+    }
+  }
+
+  BOOST_CHECK(io::zstd_registry::instance()->lookup("conn") != 0);
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, s);
+  segment t;
+  io::unarchive(buf, t);
+
+  segment::reader r{&t};
+  size_t n = 0;
+  while (auto e = r.read())
+  {
+    BOOST_CHECK_EQUAL(e->name(), "conn");
+    BOOST_CHECK_EQUAL((*e)[0], n);
+    ++n;
+  }
+
+  BOOST_CHECK_EQUAL(n, 1e5);
+}
+#endif // VAST_HAVE_ZSTD
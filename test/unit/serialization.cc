@@ -105,6 +105,9 @@ BOOST_AUTO_TEST_CASE(io_serialization_interface)
 #ifdef VAST_HAVE_SNAPPY
   methods.push_back(io::snappy);
 #endif // VAST_HAVE_SNAPPY
+#ifdef VAST_HAVE_ZSTD
+  methods.push_back(io::zstd);
+#endif // VAST_HAVE_ZSTD
   for (auto method : methods)
   {
     std::vector<int> input(1u << 10), output;
@@ -1,6 +1,9 @@
 #include "test.h"
 
 #include <forward_list>
+#include "vast/event_type_registry.h"
+#include "vast/string.h"
+#include "vast/util/monotonic_arena.h"
 #include "vast/util/short_alloc.h"
 
 using namespace vast;
@@ -25,3 +28,70 @@ BOOST_AUTO_TEST_CASE(test_short_alloc)
   list.push_front(84);
   list.push_front(168);
 }
+
+BOOST_AUTO_TEST_CASE(test_monotonic_arena)
+{
+  auto arena = make_intrusive<util::monotonic_arena>(1024);
+  BOOST_CHECK(util::arena_scope::current() == nullptr);
+
+  auto p = arena->allocate(10);
+  auto q = arena->allocate(10);
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(p) % 16, 0);
+  BOOST_CHECK_EQUAL(static_cast<char*>(q) - static_cast<char*>(p), 16);
+  BOOST_CHECK_EQUAL(arena->used(), 32);
+  BOOST_CHECK_EQUAL(arena->blocks(), 1);
+  BOOST_CHECK_EQUAL(arena->ref_count(), 3);
+
+  // Large allocations get their own block.
+  auto r = arena->allocate(512);
+  BOOST_CHECK_EQUAL(arena->blocks(), 2);
+  auto s = arena->allocate(1);
+  BOOST_CHECK(s == static_cast<char*>(q) + 16);
+
+  arena->deallocate(p);
+  arena->deallocate(q);
+  arena->deallocate(r);
+  arena->deallocate(s);
+  BOOST_CHECK_EQUAL(arena->ref_count(), 1);
+
+  std::string const str(100, 'x');
+  string in_arena;
+  string on_heap;
+  {
+    util::arena_scope scope{*arena};
+    BOOST_CHECK(util::arena_scope::current() == arena.get());
+    in_arena = str;
+    string short_str{"foo"};
+    BOOST_CHECK_EQUAL(arena->ref_count(), 2);
+  }
+
+  BOOST_CHECK(util::arena_scope::current() == nullptr);
+
+  // A scope without an arena allocates from the heap again.
+  {
+    util::arena_scope scope{*arena};
+    util::arena_scope heap{nullptr};
+    BOOST_CHECK(util::arena_scope::current() == nullptr);
+    string long_str{str};
+    BOOST_CHECK_EQUAL(arena->ref_count(), 2);
+  }
+
+  // The event type registry never holds on to the arena.
+  {
+    util::arena_scope scope{*arena};
+    event_type_registry::instance()->intern(string{"arena::" + str});
+    BOOST_CHECK_EQUAL(arena->ref_count(), 2);
+  }
+
+  on_heap = in_arena;
+  BOOST_CHECK_EQUAL(arena->ref_count(), 2);
+  BOOST_CHECK_EQUAL(on_heap, str);
+
+  // The string keeps the arena alive after its owner has gone.
+  auto raw = arena.get();
+  arena.reset();
+  BOOST_CHECK_EQUAL(raw->ref_count(), 1);
+  string moved{std::move(in_arena)};
+  BOOST_CHECK_EQUAL(moved, str);
+  BOOST_CHECK_EQUAL(raw->ref_count(), 1);
+}
@@ -0,0 +1,149 @@
+#include "test.h"
+#include <cstring>
+#include <limits>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cppa/cppa.hpp>
+#include "vast/actor.h"
+#include "vast/event.h"
+#include "vast/source/bro2_parser.h"
+#include "vast/source/stream.h"
+
+using namespace cppa;
+using namespace vast;
+
+namespace {
+
+std::string const conn_log =
+  "#separator \\x09\n"
+  "#set_separator\t,\n"
+  "#empty_field\t(empty)\n"
+  "#unset_field\t-\n"
+  "#path\tconn\n"
+  "#open\t2014-05-01-00-00-00\n"
+  "#fields\tts\tuid\tid.orig_h\tid.orig_p\n"
+  "#types\ttime\tstring\taddr\tport\n"
+  "1258531221.486539\tPii6cUUq1v4\t192.168.1.102\t68\n"
+  "1258531680.237254\tnkCxlvNN8pi\t-\t137\r\n"
+  "#close\t2014-05-01-00-00-01\n";
+
+std::string const limits_log =
+  "#separator \\x09\n"
+  "#set_separator\t,\n"
+  "#empty_field\t(empty)\n"
+  "#unset_field\t-\n"
+  "#path\tlimits\n"
+  "#open\t2014-05-01-00-00-00\n"
+  "#fields\ti\tc\td\n"
+  "#types\tint\tcount\tinterval\n"
+  "-9223372036854775808\t18446744073709551615\t-9223372036.854775808\n"
+  "9223372036854775807\t0\t9223372036.854775807\n";
+
+// Parses each line of a log and collects the resulting events.
+std::vector<event> parse_lines(source::bro2_parser& parser,
+                               std::string const& log)
+{
+  std::vector<event> events;
+  auto first = log.data();
+  auto last = first + log.size();
+  while (first != last)
+  {
+    auto nl = static_cast<char const*>(std::memchr(first, '\n', last - first));
+    auto end = nl != first && *(nl - 1) == '\r' ? nl - 1 : nl;
+    auto r = parser.parse(first, end);
+    BOOST_REQUIRE(! r.failed());
+    if (r)
+      events.push_back(std::move(*r));
+
+    first = nl + 1;
+  }
+
+  return events;
+}
+
+} // namespace <anonymous>
+
+BOOST_AUTO_TEST_CASE(bro2_parser_lines)
+{
+  source::bro2_parser parser;
+  auto events = parse_lines(parser, conn_log);
+  BOOST_CHECK(parser.ready());
+  BOOST_REQUIRE_EQUAL(events.size(), 2);
+  BOOST_CHECK_EQUAL(events[0].name(), "bro::conn");
+  BOOST_REQUIRE_EQUAL(events[0].size(), 4);
+  BOOST_CHECK_EQUAL(events[0][1], "Pii6cUUq1v4");
+  BOOST_CHECK_EQUAL(events[0][2], address{"192.168.1.102"});
+  BOOST_CHECK_EQUAL(events[0][3], port{68});
+  BOOST_CHECK(events[1][2].nil());
+
+  auto bad = std::string{"1258531680.237254\tfoo"};
+  BOOST_CHECK(parser.parse(bad.data(), bad.data() + bad.size()).failed());
+}
+
+BOOST_AUTO_TEST_CASE(bro2_parser_numeric_limits)
+{
+  source::bro2_parser parser;
+  auto events = parse_lines(parser, limits_log);
+  BOOST_REQUIRE_EQUAL(events.size(), 2);
+  BOOST_CHECK_EQUAL(events[0][0], std::numeric_limits<int64_t>::min());
+  BOOST_CHECK_EQUAL(events[0][1], std::numeric_limits<uint64_t>::max());
+  auto min = time_range::nanoseconds(std::numeric_limits<int64_t>::min());
+  BOOST_CHECK_EQUAL(events[0][2], value{min});
+  BOOST_CHECK_EQUAL(events[1][0], std::numeric_limits<int64_t>::max());
+  auto max = time_range::nanoseconds(std::numeric_limits<int64_t>::max());
+  BOOST_CHECK_EQUAL(events[1][2], value{max});
+}
+
+BOOST_AUTO_TEST_CASE(bro2_stream_unix_socket)
+{
+  auto const socket_path = "/tmp/vast-unit-test-stream.sock";
+  auto src = spawn<source::bro2_stream, detached>(self, socket_path, -1);
+  send(src, atom("batch size"), size_t{1000});
+  send(src, atom("credit"), uint64_t{1000});
+  send(src, atom("run"));
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, socket_path);
+
+  // Each connection streams the whole log, so we expect both events twice.
+  for (auto i = 0; i < 2; ++i)
+  {
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    BOOST_REQUIRE(fd != -1);
+
+    // The source may not yet listen.
+    auto connected = false;
+    for (auto j = 0; j < 100 && ! connected; ++j)
+    {
+      connected = ::connect(fd, reinterpret_cast<sockaddr*>(&addr),
+                            sizeof(addr)) == 0;
+      if (! connected)
+        ::usleep(10000);
+    }
+
+    BOOST_REQUIRE(connected);
+    BOOST_REQUIRE_EQUAL(::write(fd, conn_log.data(), conn_log.size()),
+                        static_cast<ssize_t>(conn_log.size()));
+    ::close(fd);
+  }
+
+  size_t n = 0;
+  while (n < 4)
+    receive(
+        on_arg_match >> [&](std::vector<event> const& v)
+        {
+          for (auto& e : v)
+            BOOST_CHECK_EQUAL(e.name(), "bro::conn");
+          n += v.size();
+        },
+        after(std::chrono::seconds(5)) >> [&]
+        {
+          BOOST_FAIL("source did not relay events in time");
+        });
+
+  BOOST_CHECK_EQUAL(n, 4);
+  send_exit(src, exit::done);
+}
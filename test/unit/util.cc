@@ -1,6 +1,9 @@
 #include "test.h"
+#include <atomic>
+#include "vast/util/field_splitter.h"
 #include "vast/util/trial.h"
 #include "vast/util/result.h"
+#include "vast/util/thread_pool.h"
 
 using namespace vast;
 
@@ -45,3 +48,55 @@ BOOST_AUTO_TEST_CASE(results)
 
   BOOST_CHECK_EQUAL(t.failure().msg(), "whoops");
 }
+
+BOOST_AUTO_TEST_CASE(field_splitting)
+{
+  // Long enough to exercise both the vectorized and the scalar part.
+  std::string str = "1258531221.486539\tGs4lSlT2Ms7\t192.168.1.102\t68\t"
+                    "192.168.1.1\t67\tudp\t-\t\t301\t(empty)";
+  std::vector<std::string> expected{
+    "1258531221.486539", "Gs4lSlT2Ms7", "192.168.1.102", "68",
+    "192.168.1.1", "67", "udp", "-", "", "301", "(empty)"};
+
+  util::field_splitter<char const*> fs{"\t", 1};
+  fs.split(str.data(), str.data() + str.size());
+  BOOST_REQUIRE_EQUAL(fs.fields(), expected.size());
+  for (size_t i = 0; i < fs.fields(); ++i)
+    BOOST_CHECK_EQUAL(std::string(fs.start(i), fs.end(i)), expected[i]);
+
+  fs.split(str.data(), str.data() + str.size(), 3);
+  BOOST_REQUIRE_EQUAL(fs.fields(), 3);
+  BOOST_CHECK(fs.equals(1, "Gs4lSlT2Ms7"));
+  BOOST_CHECK_EQUAL(std::string(fs.start(2), fs.end(2)),
+                    str.substr(str.find("192.168.1.102")));
+
+  // Multi-byte separators take the scalar path.
+  std::string multi = "foo::bar::baz";
+  util::field_splitter<std::string::const_iterator> ms{"::", 2};
+  ms.split(multi.begin(), multi.end());
+  BOOST_REQUIRE_EQUAL(ms.fields(), 3);
+  BOOST_CHECK(ms.equals(0, "foo"));
+  BOOST_CHECK(ms.equals(2, "baz"));
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool)
+{
+  std::atomic<size_t> n{0};
+  std::vector<std::future<size_t>> results;
+  {
+    util::thread_pool pool{4};
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+    for (size_t i = 0; i < 100; ++i)
+      results.push_back(pool.submit([&n, i] { ++n; return i * i; }));
+
+    BOOST_CHECK_EQUAL(results[10].get(), 100);
+
+    // The pool finishes all tasks before it goes away.
+    for (size_t i = 0; i < 100; ++i)
+      pool.submit([&n] { ++n; });
+  }
+
+  BOOST_CHECK_EQUAL(n, 200);
+  for (size_t i = 11; i < results.size(); ++i)
+    BOOST_CHECK_EQUAL(results[i].get(), i * i);
+}
@@ -0,0 +1,99 @@
+#include "test.h"
+
+#include "vast/bitstream.h"
+#include "vast/event.h"
+#include "vast/expression.h"
+#include "vast/port.h"
+#include "vast/segment.h"
+#include "vast/zone_map.h"
+#include "vast/io/serialization.h"
+
+using namespace vast;
+
+BOOST_AUTO_TEST_CASE(zone_map_pruning)
+{
+  zone_map zm;
+  for (size_t i = 0; i < 100; ++i)
+  {
+    event e{100 + i, "s" + std::to_string(i % 10),
+            port{static_cast<port::number_type>(i), port::tcp}};
+
+    e.timestamp(time_point{time_range::seconds(1000 + i)});
+
+    // Every other event lacks its last field.
+    if (i % 2 == 0)
+      e.pop_back();
+
+    zm.add(e);
+  }
+
+  BOOST_CHECK_EQUAL(zm.events(), 100);
+
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 == 142"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@0 == 42"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@0 < 100"}));
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 <= 100"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@0 > 199"}));
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 >= 199"}));
+
+  // Comparisons across arithmetic types remain possible.
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 == +42"}));
+
+  // Values of other types never compare equal.
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@0 == \"foo\""}));
+
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@1 == \"s7\""}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@1 == \"t\""}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@2 > 99/tcp"}));
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@2 >= 99/tcp"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@3 == 42"}));
+
+  BOOST_CHECK(zm.may_match(expr::ast{":port > 98/tcp"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{":port > 99/tcp"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{":string == \"foo\""}));
+
+  BOOST_CHECK(zm.may_match(expr::ast{"&time >= 1970-01-01+00:16:40"}));
+  BOOST_CHECK(! zm.may_match(expr::ast{"&time < 1970-01-01+00:16:40"}));
+
+  BOOST_CHECK(! zm.may_match(expr::ast{"foo@0 == 42 && foo@1 == \"s7\""}));
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 == 42 || foo@1 == \"s7\""}));
+
+  // Operators without a zone check never rule out any events.
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@0 != 142"}));
+  BOOST_CHECK(zm.may_match(expr::ast{"foo@1 ~ /x/"}));
+
+  std::vector<uint8_t> buf;
+  zone_map zm2;
+  io::archive(buf, zm);
+  io::unarchive(buf, zm2);
+  BOOST_CHECK(zm == zm2);
+}
+
+BOOST_AUTO_TEST_CASE(segment_zone_maps)
+{
+  segment s1;
+  s1.base(1);
+  segment::writer w{&s1, 100};
+  for (size_t i = 0; i < 1000; ++i)
+    BOOST_REQUIRE(w.write(event{i}));
+
+  BOOST_REQUIRE(w.flush());
+
+  std::vector<uint8_t> buf;
+  segment s2;
+  io::archive(buf, s1);
+  io::unarchive(buf, s2);
+
+  for (auto s : {&s1, &s2})
+  {
+    // The predicate can only hold for the events of the third and fourth
+    // chunk, with IDs in [201, 401).
+    auto excluded = s->excluded(expr::ast{"foo@0 >= 250 && foo@0 < 350"});
+    BOOST_CHECK_EQUAL(excluded.size(), 1001);
+    BOOST_CHECK_EQUAL(excluded.count(), 800);
+    BOOST_CHECK_EQUAL(excluded.find_first(), 1);
+    BOOST_CHECK(! excluded[201]);
+    BOOST_CHECK(! excluded[400]);
+    BOOST_CHECK(excluded[401]);
+  }
+}